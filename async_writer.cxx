@@ -0,0 +1,202 @@
+//* async writer
+/*
+ * @remarks writes buffers to a file descriptor on a background thread (see async_writer.h)
+ */
+#include <ctime>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/uio.h>
+#include "gen/gendefs.h"
+#include "gen/queue.h"
+#include "gen/async_writer.h"
+
+namespace {
+  //nanoseconds on the monotonic clock
+  unsigned long long now_ns(void) {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return(static_cast<unsigned long long>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec);
+  }
+#ifdef IOV_MAX
+  const size_t MAX_IOV = IOV_MAX;
+#else
+  const size_t MAX_IOV = 16;
+#endif
+};//anonymous namespace
+
+
+//* re_gen namespace
+/**
+ * @brief this namespace is for items that are of general interest.
+ */
+namespace re_gen {
+
+//* Async_Writer::Async_Writer
+/*
+ * @param depth - the number of filled buffers that can wait to be written (at least 1)
+ */
+Async_Writer::Async_Writer(int _fd, size_t _depth) :
+  fd(_fd), depth(std::max(_depth, static_cast<size_t>(1))), pending(), spares(), writing(false), closing(false), write_stats() {
+  pthread_mutex_init(&mutex, 0);
+  pthread_cond_init(&work_cond, 0);
+  pthread_cond_init(&done_cond, 0);
+  if (pthread_create(&thread, 0, run, this) != 0) {
+    pthread_cond_destroy(&done_cond);
+    pthread_cond_destroy(&work_cond);
+    pthread_mutex_destroy(&mutex);
+    throw Gen_Err("Async_Writer::Async_Writer - can't start the writer thread");
+  }
+}
+
+//* Async_Writer::~Async_Writer
+/*
+ * @brief writes whatever is still waiting, and stops the writer thread
+ */
+Async_Writer::~Async_Writer(void) {
+  {
+    re_queue_helpers::lock l(mutex);
+    closing = true;
+    pthread_cond_signal(&work_cond);
+  }
+  pthread_join(thread, 0);
+  pthread_cond_destroy(&done_cond);
+  pthread_cond_destroy(&work_cond);
+  pthread_mutex_destroy(&mutex);
+}
+
+//* Async_Writer::write
+/*
+ * @brief hand buffer over to be written; it's replaced with an empty one
+ */
+void Async_Writer::write(std::string *const buffer) {
+  if (buffer->empty())
+    return;
+  re_queue_helpers::lock l(mutex);
+  if (pending.size() >= depth) {
+    const unsigned long long start = now_ns();
+    while (pending.size() >= depth)
+      pthread_cond_wait(&done_cond, &mutex);
+    ++write_stats.stalls;
+    write_stats.stalled_ns += now_ns() - start;
+  }
+  write_stats.bytes_in_flight += buffer->size();
+  pending.push_back(std::string());
+  pending.back().swap(*buffer);
+  if (!spares.empty()) {
+    buffer->swap(spares.back());
+    spares.pop_back();
+  }
+  pthread_cond_signal(&work_cond);
+}
+
+//* Async_Writer::drain
+/*
+ * @brief wait until everything handed over so far has been written
+ */
+void Async_Writer::drain(void) {
+  re_queue_helpers::lock l(mutex);
+  while (!pending.empty() || writing)
+    pthread_cond_wait(&done_cond, &mutex);
+}
+
+void Async_Writer::set_fd(int _fd) {
+  drain();
+  re_queue_helpers::lock l(mutex);
+  fd = _fd;
+}
+
+Async_Write_Stats Async_Writer::stats(void) const {
+  re_queue_helpers::lock l(mutex);
+  return(write_stats);
+}
+
+void *Async_Writer::run(void *instance) {
+  static_cast<Async_Writer *>(instance)->loop();
+  return(0);
+}
+
+//* Async_Writer::loop
+/*
+ * @brief take all the waiting buffers, write them (without the lock), and give them back as spares
+ */
+void Async_Writer::loop(void) {
+  std::vector<std::string> batch;
+  re_queue_helpers::lock l(mutex);
+  for (;;) {
+    while (pending.empty() && !closing)
+      pthread_cond_wait(&work_cond, &mutex);
+    if (pending.empty())
+      break;
+    for (std::deque<std::string>::iterator it = pending.begin(); it != pending.end(); ++it) {
+      batch.push_back(std::string());
+      batch.back().swap(*it);
+    }
+    pending.clear();
+    writing = true;
+    const int batch_fd = fd;
+    pthread_mutex_unlock(&mutex);
+    write_batch(batch_fd, &batch);
+    pthread_mutex_lock(&mutex);
+    writing = false;
+    for (size_t i = 0; i < batch.size(); ++i) {
+      if (spares.size() < depth) {
+	batch[i].clear();
+	spares.push_back(std::string());
+	spares.back().swap(batch[i]);
+      }
+    }
+    batch.clear();
+    pthread_cond_broadcast(&done_cond);
+  }
+}
+
+//* Async_Writer::write_batch
+/*
+ * @brief writev the batch, carrying on after short writes
+ * @remarks called without the lock; only the stats are updated under it.
+ */
+void Async_Writer::write_batch(int batch_fd, std::vector<std::string> *const batch) {
+  std::vector<iovec> iov(batch->size());
+  unsigned long long total = 0;
+  for (size_t i = 0; i < batch->size(); ++i) {
+    iov[i].iov_base = &(*batch)[i][0];
+    iov[i].iov_len = (*batch)[i].size();
+    total += iov[i].iov_len;
+  }
+  unsigned long long written = 0, writes = 0, write_ns = 0, max_write_ns = 0, errors = 0;
+  size_t first = 0;
+  while (first < iov.size()) {
+    const unsigned long long start = now_ns();
+    ssize_t n = ::writev(batch_fd, &iov[first], static_cast<int>(std::min(iov.size() - first, MAX_IOV)));
+    const unsigned long long elapsed = now_ns() - start;
+    ++writes;
+    write_ns += elapsed;
+    max_write_ns = std::max(max_write_ns, elapsed);
+    if (n < 0) {
+      if (errno == EINTR)
+	continue;
+      ++errors;
+      break;
+    }
+    written += n;
+    //skip what was written, and trim the first buffer that was only partly written
+    size_t left = n;
+    while (first < iov.size() && left >= iov[first].iov_len)
+      left -= iov[first++].iov_len;
+    if (left != 0) {
+      iov[first].iov_base = static_cast<char *>(iov[first].iov_base) + left;
+      iov[first].iov_len -= left;
+    }
+  }
+  re_queue_helpers::lock l(mutex);
+  write_stats.writes += writes;
+  write_stats.bytes_written += written;
+  write_stats.bytes_in_flight -= total;
+  write_stats.total_write_ns += write_ns;
+  write_stats.max_write_ns = std::max(write_stats.max_write_ns, max_write_ns);
+  write_stats.errors += errors;
+}
+};//namespace re_gen
@@ -0,0 +1,80 @@
+//* async_writer.h - header file for the Async_Writer class
+/*
+ * @brief this header file defines the Async_Writer class, which writes buffers to a file descriptor on a thread of its own, so
+ * that the thread that fills them doesn't wait on the disk (or on whatever is reading the pipe).
+ */
+#ifndef __IF_ASYNC_WRITER__
+#define __IF_ASYNC_WRITER__
+#include <string>
+#include <vector>
+#include <deque>
+#include <pthread.h>
+#include <gen/gendefs.h>
+
+//* re_gen namespace
+/**
+ * @brief this namespace is for items that are of general interest.
+ */
+namespace re_gen {
+
+//* Async_Write_Stats struct
+/*
+ * @brief what an Async_Writer has done so far; times are in nanoseconds
+ */
+struct Async_Write_Stats {
+  unsigned long long writes;           //writev calls
+  unsigned long long bytes_written;
+  unsigned long long bytes_in_flight;  //handed over, but not yet written
+  unsigned long long total_write_ns;   //time spent in writev
+  unsigned long long max_write_ns;     //the longest single writev
+  unsigned long long stalls;           //times write had to wait for a free buffer
+  unsigned long long stalled_ns;       //and how long it waited, in all
+  unsigned long long errors;           //failed writes (the data is dropped)
+};
+
+//* Async_Writer class
+/*
+ * @brief writes buffers to a file descriptor on a background thread
+ *
+ * @remarks write hands a filled buffer to the writer thread, and gets an empty one back in exchange (the one that was written
+ * last time, so its capacity is reused) - ie. the buffers are double buffered, and the caller fills the next while the writer
+ * thread writes the last. up to depth buffers can be waiting to be written; when they are all taken, write waits for the writer
+ * (and counts the stall). when the writer thread wakes up it writes all the waiting buffers with one writev.
+ *
+ * @note the file descriptor is not owned: it's the caller's to close, after drain (or after the Async_Writer is destroyed). to
+ * switch to another descriptor (eg. when rotating a log file), call set_fd, which drains first.
+ *
+ * @note io_uring would save the writer thread's system calls, but not the caller's, which is what matters here; plain writev is
+ * used everywhere.
+ *
+ * @throw Gen_Err from the constructor if the thread can't be started.
+ */
+class Async_Writer {
+ public:
+  Async_Writer(int fd, size_t depth = 2);
+  ~Async_Writer(void);
+  void write(std::string *const buffer);
+  void drain(void);
+  void set_fd(int fd);
+  Async_Write_Stats stats(void) const;
+
+ private:
+  static void *run(void *instance);
+  void loop(void);
+  void write_batch(int fd, std::vector<std::string> *const batch);
+  int fd;
+  size_t depth;
+  std::deque<std::string> pending;
+  std::vector<std::string> spares;
+  bool writing;
+  bool closing;
+  Async_Write_Stats write_stats;
+  mutable pthread_mutex_t mutex;
+  pthread_cond_t work_cond;            //the writer thread waits on this for buffers
+  pthread_cond_t done_cond;            //write and drain wait on this for the writer thread
+  pthread_t thread;
+  Async_Writer(const Async_Writer &);
+  Async_Writer& operator=(const Async_Writer &);
+};//class Async_Writer
+};//namespace re_gen
+#endif //__IF_ASYNC_WRITER__
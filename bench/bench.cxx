@@ -0,0 +1,313 @@
+//* benchmark and stress suite
+/*
+ * @remarks the command line, the JSON report, and the helpers the suites share (see bench.h)
+ */
+#include <ctime>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <unistd.h>
+#include "gen/gendefs.h"
+#include "bench.h"
+
+namespace {
+  struct Suite {
+    const char *name;
+    void (*run)(re_bench::Report *const report);
+  };
+  const Suite suites[] = {
+    {"queue", re_bench::queue_suite},
+    {"processor", re_bench::processor_suite},
+    {"functional", re_bench::functional_suite},
+    {"pool", re_bench::pool_suite},
+    {"alloc", re_bench::alloc_suite},
+    {"stress", re_bench::stress_suite},
+  };
+  const size_t n_suites = sizeof(suites) / sizeof(suites[0]);
+
+  void usage(const char *prog) {
+    std::cerr << "usage: " << prog << " [options] [suite ...]\n"
+	      << "  runs the given suites (default: all but stress), and writes the results as JSON to stdout\n"
+	      << "  suites:";
+    for (size_t i = 0; i < n_suites; ++i)
+      std::cerr << " " << suites[i].name;
+    std::cerr << "\n"
+	      << "  --quick               small counts, for a smoke run\n"
+	      << "  --out FILE            write the JSON to FILE rather than stdout\n"
+	      << "  --producers N         queue suite: up to N producers (default 64)\n"
+	      << "  --consumers N         queue suite: up to N consumers (default: the online cpus)\n"
+	      << "  --queue-ops N         queue suite: objects per case\n"
+	      << "  --msgs N              processor suite: messages per case\n"
+	      << "  --elements N          functional suite: elements per case\n"
+	      << "  --reps N              functional and pool suites: timings per case\n"
+	      << "  --workers N           pool suite: up to N worker threads (default: the online cpus)\n"
+	      << "  --tasks N             pool suite: tasks per case\n"
+	      << "  --stress-threads N    stress suite: producer threads\n"
+	      << "  --stress-msgs N       stress suite: messages per thread per round\n"
+	      << "  --stress-rounds N     stress suite: Message_Processors to construct and destroy\n"
+	      << "  --file-sink FILE      the file the File_Sink cases write (and then delete)\n"
+	      << "  exits with 1 if a stress check failed, 2 for a bad command line\n";
+  }
+
+  //the value of an option that takes one, or exit
+  const char *option_value(int argc, char **argv, int *const i) {
+    if (*i + 1 >= argc) {
+      std::cerr << argv[*i] << " needs a value\n";
+      exit(2);
+    }
+    return(argv[++*i]);
+  }
+
+  size_t count_value(int argc, char **argv, int *const i) {
+    const char *name = argv[*i], *value = option_value(argc, argv, i);
+    char *end = 0;
+    const unsigned long long n = strtoull(value, &end, 10);
+    if (*value == '\0' || *end != '\0' || n == 0) {
+      std::cerr << name << " needs a positive count, not " << value << "\n";
+      exit(2);
+    }
+    return(static_cast<size_t>(n));
+  }
+};//anonymous namespace
+
+
+//* re_bench namespace
+/**
+ * @brief this namespace is for the benchmark and stress suite.
+ */
+namespace re_bench {
+
+Bench_Opts::Bench_Opts(void) :
+  quick(false), max_producers(64), max_consumers(online_cpus()), queue_ops(1000000), msgs(1000000), elements(4 * 1024 * 1024), reps(5),
+  max_workers(online_cpus()), tasks(200000), stress_threads(8), stress_msgs(50000), stress_rounds(4), file_sink("re_gen_bench.log") {
+}
+
+unsigned long long now_ns(void) {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return(static_cast<unsigned long long>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec);
+}
+
+size_t online_cpus(void) {
+  const long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  return(n_cpus > 0 ? static_cast<size_t>(n_cpus) : 1);
+}
+
+std::vector<size_t> doublings(size_t max) {
+  std::vector<size_t> ns;
+  for (size_t n = 1; n <= max; n *= 2)
+    ns.push_back(n);
+  if (ns.back() != max)
+    ns.push_back(max);
+  return(ns);
+}
+
+Json_Object &Json_Object::add(const std::string &key, int value) {
+  return(add(key, static_cast<long>(value)));
+}
+
+Json_Object &Json_Object::add(const std::string &key, long value) {
+  std::ostringstream oss;
+  oss << value;
+  return(add_raw(key, oss.str()));
+}
+
+Json_Object &Json_Object::add(const std::string &key, unsigned long value) {
+  return(add(key, static_cast<unsigned long long>(value)));
+}
+
+Json_Object &Json_Object::add(const std::string &key, unsigned long long value) {
+  std::ostringstream oss;
+  oss << value;
+  return(add_raw(key, oss.str()));
+}
+
+Json_Object &Json_Object::add(const std::string &key, double value) {
+  if (!std::isfinite(value))
+    return(add_raw(key, "null"));
+  char text[32];
+  snprintf(text, sizeof(text), "%.6g", value);
+  return(add_raw(key, text));
+}
+
+Json_Object &Json_Object::add(const std::string &key, bool value) {
+  return(add_raw(key, value ? "true" : "false"));
+}
+
+Json_Object &Json_Object::add(const std::string &key, const char *value) {
+  return(add_raw(key, quote(value)));
+}
+
+Json_Object &Json_Object::add(const std::string &key, const std::string &value) {
+  return(add_raw(key, quote(value)));
+}
+
+Json_Object &Json_Object::add(const std::string &key, const Json_Object &value) {
+  return(add_raw(key, value.str()));
+}
+
+Json_Object &Json_Object::add_raw(const std::string &key, const std::string &json) {
+  if (!text.empty())
+    text += ",";
+  text += quote(key) + ":" + json;
+  return(*this);
+}
+
+std::string Json_Object::quote(const std::string &value) {
+  std::string quoted("\"");
+  for (std::string::const_iterator it = value.begin(); it != value.end(); ++it) {
+    const unsigned char c = *it;
+    if (c == '"' || c == '\\') {
+      quoted += '\\';
+      quoted += c;
+    }
+    else if (c < 0x20) {
+      char escape[8];
+      snprintf(escape, sizeof(escape), "\\u%04x", c);
+      quoted += escape;
+    }
+    else
+      quoted += c;
+  }
+  return(quoted + "\"");
+}
+
+Json_Object Latencies::percentiles(void) const {
+  Json_Object summary;
+  summary.add("count", static_cast<unsigned long long>(ns.size()));
+  if (ns.empty())
+    return(summary);
+  std::vector<unsigned long long> sorted(ns);
+  std::sort(sorted.begin(), sorted.end());
+  static const struct { const char *name; double fraction; } points[] = {
+    {"p50_ns", 0.5}, {"p90_ns", 0.9}, {"p99_ns", 0.99}, {"p999_ns", 0.999}
+  };
+  summary.add("min_ns", sorted.front());
+  for (size_t i = 0; i < sizeof(points) / sizeof(points[0]); ++i) {
+    const size_t rank = static_cast<size_t>(std::ceil(points[i].fraction * sorted.size()));
+    summary.add(points[i].name, sorted[std::min(std::max(rank, static_cast<size_t>(1)), sorted.size()) - 1]);
+  }
+  summary.add("max_ns", sorted.back());
+  return(summary);
+}
+
+Report::Report(const Bench_Opts &_opts) : opts(_opts), started(static_cast<long>(time(0))), results(), failures(0) {
+}
+
+void Report::add(const std::string &suite, const std::string &case_name, const Json_Object &params, const Json_Object &metrics) {
+  Json_Object result;
+  result.add("suite", suite).add("case", case_name).add("params", params).add("metrics", metrics);
+  results.push_back(result.str());
+  std::cerr << suite << " / " << case_name << " " << params.str() << "\n";
+}
+
+std::string Report::str(void) const {
+  std::string list("[");
+  for (size_t i = 0; i < results.size(); ++i)
+    list += (i == 0 ? "\n  " : ",\n  ") + results[i];
+  list += "\n]";
+  Json_Object doc;
+  doc.add("schema", 1).add("started", started).add("cpus", static_cast<unsigned long long>(online_cpus())).add("quick", opts.quick)
+    .add_raw("results", list).add("failures", failures);
+  return(doc.str() + "\n");
+}
+};//namespace re_bench
+
+int main(int argc, char **argv) {
+  re_bench::Bench_Opts opts;
+  std::string out_file;
+  std::vector<const Suite *> chosen;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg(argv[i]);
+    if (arg == "--quick") {
+      opts.quick = true;
+      opts.max_producers = std::min(opts.max_producers, static_cast<size_t>(8));
+      opts.max_consumers = std::min(opts.max_consumers, static_cast<size_t>(2));
+      opts.queue_ops = 20000;
+      opts.msgs = 20000;
+      opts.elements = 256 * 1024;
+      opts.reps = 2;
+      opts.max_workers = std::min(opts.max_workers, static_cast<size_t>(2));
+      opts.tasks = 20000;
+      opts.stress_threads = 4;
+      opts.stress_msgs = 5000;
+      opts.stress_rounds = 2;
+    }
+    else if (arg == "--out")
+      out_file = option_value(argc, argv, &i);
+    else if (arg == "--producers")
+      opts.max_producers = count_value(argc, argv, &i);
+    else if (arg == "--consumers")
+      opts.max_consumers = count_value(argc, argv, &i);
+    else if (arg == "--queue-ops")
+      opts.queue_ops = count_value(argc, argv, &i);
+    else if (arg == "--msgs")
+      opts.msgs = count_value(argc, argv, &i);
+    else if (arg == "--elements")
+      opts.elements = count_value(argc, argv, &i);
+    else if (arg == "--reps")
+      opts.reps = static_cast<int>(count_value(argc, argv, &i));
+    else if (arg == "--workers")
+      opts.max_workers = count_value(argc, argv, &i);
+    else if (arg == "--tasks")
+      opts.tasks = count_value(argc, argv, &i);
+    else if (arg == "--stress-threads")
+      opts.stress_threads = count_value(argc, argv, &i);
+    else if (arg == "--stress-msgs")
+      opts.stress_msgs = count_value(argc, argv, &i);
+    else if (arg == "--stress-rounds")
+      opts.stress_rounds = static_cast<int>(count_value(argc, argv, &i));
+    else if (arg == "--file-sink")
+      opts.file_sink = option_value(argc, argv, &i);
+    else if (arg == "-h" || arg == "--help") {
+      usage(argv[0]);
+      return(0);
+    }
+    else {
+      const Suite *suite = 0;
+      for (size_t s = 0; s < n_suites && suite == 0; ++s) {
+	if (arg == suites[s].name)
+	  suite = &suites[s];
+      }
+      if (suite == 0) {
+	usage(argv[0]);
+	return(2);
+      }
+      chosen.push_back(suite);
+    }
+  }
+  if (chosen.empty()) {
+    for (size_t s = 0; s < n_suites; ++s) {
+      if (strcmp(suites[s].name, "stress") != 0)
+	chosen.push_back(&suites[s]);
+    }
+  }
+  re_bench::Report report(opts);
+  try {
+    for (size_t s = 0; s < chosen.size(); ++s)
+      chosen[s]->run(&report);
+  } catch (const re_gen::Gen_Err &err) {
+    std::cerr << "bench - " << err.what() << "\n";
+    return(1);
+  } catch (const std::exception &err) {
+    std::cerr << "bench - " << err.what() << "\n";
+    return(1);
+  }
+  const std::string json = report.str();
+  if (out_file.empty())
+    std::cout << json << std::flush;
+  else {
+    std::ofstream out(out_file.c_str());
+    out << json;
+    if (!out) {
+      std::cerr << "bench - can't write " << out_file << "\n";
+      return(1);
+    }
+  }
+  return(report.failed() != 0 ? 1 : 0);
+}
@@ -0,0 +1,118 @@
+//* bench.h - header file for the benchmark and stress suite
+/*
+ * @brief this header file defines what the suites share: the command line options, the clock, latency percentiles, and the
+ * JSON report that every suite adds its results to.
+ */
+#ifndef __IF_BENCH__
+#define __IF_BENCH__
+#include <string>
+#include <vector>
+#include <gen/gendefs.h>
+
+//* re_bench namespace
+/**
+ * @brief this namespace is for the benchmark and stress suite.
+ */
+namespace re_bench {
+
+//* Bench_Opts struct
+/*
+ * @brief the command line options (see usage in bench.cxx)
+ */
+struct Bench_Opts {
+  bool quick;                     //a smoke run: small counts, fewer cases
+  size_t max_producers;           //the queue suite runs 1, 2, 4 ... max_producers producers
+  size_t max_consumers;           //and 1, 2, 4 ... max_consumers consumers
+  size_t queue_ops;               //objects pushed in each queue case, over all producers
+  size_t msgs;                    //messages issued in each processor case, over all producers
+  size_t elements;                //elements filtered in each functional case
+  int reps;                       //each functional and pool case is timed this many times; the best and the median are reported
+  size_t max_workers;             //the pool suite runs 1, 2, 4 ... max_workers worker threads
+  size_t tasks;                   //tasks run in each pool case
+  size_t stress_threads;
+  size_t stress_msgs;             //per thread, per round
+  int stress_rounds;              //Message_Processors constructed and destroyed
+  std::string file_sink;          //the file written by the File_Sink cases (deleted afterwards)
+  Bench_Opts(void);
+};
+
+//nanoseconds on the monotonic clock
+unsigned long long now_ns(void);
+size_t online_cpus(void);
+//1, 2, 4 ... up to max (and max itself, if it's not a power of 2)
+std::vector<size_t> doublings(size_t max);
+
+//* Json_Object class
+/*
+ * @brief builds the text of a JSON object, one member at a time
+ * @remarks doubles that aren't finite are written as null.
+ */
+class Json_Object {
+ public:
+  Json_Object(void) : text() {}
+  Json_Object &add(const std::string &key, int value);
+  Json_Object &add(const std::string &key, long value);
+  Json_Object &add(const std::string &key, unsigned long value);
+  Json_Object &add(const std::string &key, unsigned long long value);
+  Json_Object &add(const std::string &key, double value);
+  Json_Object &add(const std::string &key, bool value);
+  Json_Object &add(const std::string &key, const char *value);
+  Json_Object &add(const std::string &key, const std::string &value);
+  Json_Object &add(const std::string &key, const Json_Object &value);
+  Json_Object &add_raw(const std::string &key, const std::string &json);
+  std::string str(void) const { return("{" + text + "}"); }
+  static std::string quote(const std::string &value);
+ private:
+  std::string text;
+};
+
+//* Latencies class
+/*
+ * @brief a sample of latencies, in nS, summarized as percentiles
+ */
+class Latencies {
+ public:
+  Latencies(void) : ns() {}
+  void add(unsigned long long latency_ns) { ns.push_back(latency_ns); }
+  void add(const Latencies &other) { ns.insert(ns.end(), other.ns.begin(), other.ns.end()); }
+  void reserve(size_t n) { ns.reserve(n); }
+  size_t size(void) const { return(ns.size()); }
+  //count, min, p50, p90, p99, p999 and max
+  Json_Object percentiles(void) const;
+ private:
+  std::vector<unsigned long long> ns;
+};
+
+//* Report class
+/*
+ * @brief the results of a run, written as one JSON document:
+ *  {"schema": 1, "started": <unix time>, "cpus": n, "quick": bool, "results": [{"suite", "case", "params", "metrics"} ...],
+ *   "failures": n}
+ * @remarks a stress check that fails is a result like any other, with "ok": false in its metrics, and counted in failures, so
+ * that the exit status can say so.
+ */
+class Report {
+ public:
+  Report(const Bench_Opts &_opts);
+  void add(const std::string &suite, const std::string &case_name, const Json_Object &params, const Json_Object &metrics);
+  void fail(void) { ++failures; }
+  int failed(void) const { return(failures); }
+  std::string str(void) const;
+  const Bench_Opts &opts;
+ private:
+  long started;
+  std::vector<std::string> results;
+  int failures;
+  Report(const Report &);
+  Report& operator=(const Report &);
+};
+
+//the suites; each adds its results to report
+void queue_suite(Report *const report);
+void processor_suite(Report *const report);
+void functional_suite(Report *const report);
+void pool_suite(Report *const report);
+void alloc_suite(Report *const report);
+void stress_suite(Report *const report);
+};//namespace re_bench
+#endif //__IF_BENCH__
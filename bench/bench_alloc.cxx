@@ -0,0 +1,183 @@
+//* alloc suite
+/*
+ * @remarks heap allocations per message: on the thread that issues it, and on the Message_Processor thread that writes it. the
+ * global operator new is replaced here, for the whole executable, with one that counts - but only while a case is counting.
+ */
+#include <string>
+#include <vector>
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include <sched.h>
+#include "gen/gendefs.h"
+#include "gen/queue.h"
+#include "gen/message_processor.h"
+#include "gen/message_sink.h"
+#include "bench.h"
+
+namespace {
+  std::atomic<bool> counting(false);
+  std::atomic<unsigned long long> total_allocs(0), total_bytes(0);
+  //the calling thread's share of the totals
+  thread_local unsigned long long thread_allocs = 0, thread_bytes = 0;
+};//anonymous namespace
+
+//not inlined into this file's callers, where the compiler would see new's pointer passed to free, and warn
+#define BENCH_NOINLINE __attribute__((noinline))
+
+BENCH_NOINLINE void *operator new(size_t size) {
+  if (counting.load(std::memory_order_relaxed)) {
+    total_allocs.fetch_add(1, std::memory_order_relaxed);
+    total_bytes.fetch_add(size, std::memory_order_relaxed);
+    ++thread_allocs;
+    thread_bytes += size;
+  }
+  void *mem = malloc(size != 0 ? size : 1);
+  if (mem == 0)
+    throw std::bad_alloc();
+  return(mem);
+}
+
+BENCH_NOINLINE void operator delete(void *mem) noexcept {
+  free(mem);
+}
+
+BENCH_NOINLINE void operator delete(void *mem, size_t) noexcept {
+  free(mem);
+}
+
+namespace {
+  const size_t MSGS = 10000, WARM_UP = 2000;
+  const size_t text_sizes[] = {100, 2000};
+  enum Msg_Kind { MSG_LVALUE, MSG_RVALUE, MSG_C_STRING, MSG_FMT };
+  const char *const kind_names[] = {"lvalue", "rvalue", "c_string", "fmt"};
+
+  //what a case allocated, between start and stop
+  class Alloc_Count {
+  public:
+    Alloc_Count(void) : allocs(0), bytes(0), here_allocs(0), here_bytes(0) {}
+    void start(void) {
+      allocs = total_allocs.load();
+      bytes = total_bytes.load();
+      here_allocs = thread_allocs;
+      here_bytes = thread_bytes;
+      counting.store(true);
+    }
+    void stop(void) {
+      counting.store(false);
+      allocs = total_allocs.load() - allocs;
+      bytes = total_bytes.load() - bytes;
+      here_allocs = thread_allocs - here_allocs;
+      here_bytes = thread_bytes - here_bytes;
+    }
+    //allocs and bytes are every thread's; here_allocs and here_bytes, the calling thread's
+    unsigned long long allocs, bytes, here_allocs, here_bytes;
+  };
+
+  void issue(re_gen::Message_Processor *mp, int src, Msg_Kind kind, const std::string &text, std::vector<std::string> *texts,
+             size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      switch (kind) {
+      case MSG_LVALUE:
+	mp->process_msg(src, re_gen::VERBOSITY_MINOR_STEPS, text);
+	break;
+      case MSG_RVALUE:
+	mp->process_msg(src, re_gen::VERBOSITY_MINOR_STEPS, std::move((*texts)[i]));
+	break;
+      case MSG_C_STRING:
+	mp->process_msg(src, re_gen::VERBOSITY_MINOR_STEPS, text.c_str());
+	break;
+      case MSG_FMT:
+	mp->process_msg_fmt(src, re_gen::VERBOSITY_MINOR_STEPS, "%s %lu", text.c_str(), static_cast<unsigned long>(i));
+	break;
+      }
+    }
+  }
+
+  void wait_written(const re_gen::Null_Sink *sink, unsigned long long n) {
+    while (sink->messages() < n)
+      sched_yield();
+  }
+
+  void add_result(re_bench::Report *const report, const std::string &case_name, size_t text_size, size_t n,
+                  const Alloc_Count &count, unsigned long long producer_allocs, unsigned long long producer_bytes) {
+    re_bench::Json_Object params, metrics;
+    params.add("text_bytes", static_cast<unsigned long long>(text_size)).add("msgs", static_cast<unsigned long long>(n));
+    metrics.add("producer_allocs_per_msg", static_cast<double>(producer_allocs) / n)
+      .add("producer_bytes_per_msg", static_cast<double>(producer_bytes) / n)
+      .add("consumer_allocs_per_msg", static_cast<double>(count.allocs - producer_allocs) / n)
+      .add("consumer_bytes_per_msg", static_cast<double>(count.bytes - producer_bytes) / n)
+      .add("allocs", count.allocs);
+    report->add("alloc", case_name, params, metrics);
+  }
+
+  //each message through a Message_Processor, into a Null_Sink that still makes its text
+  void run_processor_case(re_bench::Report *const report, Msg_Kind kind, size_t text_size, size_t n) {
+    const std::string text(text_size, 'x');
+    std::vector<std::string> texts;
+    Alloc_Count count;
+    {
+      re_gen::Message_Processor mp(re_gen::VERBOSITY_MINOR_STEPS, re_gen::OVERFLOW_BLOCK);
+      re_gen::Null_Sink *sink = new re_gen::Null_Sink(true);
+      mp.set_sink(sink);
+      const int src = mp.register_msg_src(re_gen::VERBOSITY_EVERYTHING, "bench");
+      //the first messages fill the pools, and size the Message_Processor's buffers
+      texts.assign(WARM_UP, text);
+      issue(&mp, src, kind, text, &texts, WARM_UP);
+      wait_written(sink, WARM_UP);
+      //the rvalue strings are made before we count: they're the caller's allocations, not the Message_Processor's
+      texts.assign(n, text);
+      count.start();
+      issue(&mp, src, kind, text, &texts, n);
+      const unsigned long long producer_allocs = thread_allocs - count.here_allocs, producer_bytes = thread_bytes - count.here_bytes;
+      wait_written(sink, WARM_UP + n);
+      count.stop();
+      add_result(report, std::string("process_msg/") + kind_names[kind], text_size, n, count, producer_allocs, producer_bytes);
+    }
+  }
+
+  //the same strings through a Queue, copied in and moved out, and then moved in and out: what the queues cost before and after
+  //they moved their objects
+  void run_queue_case(re_bench::Report *const report, bool move, size_t text_size, size_t n) {
+    const std::string text(text_size, 'x');
+    std::vector<std::string> texts(n, text);
+    re_gen::Queue<std::string> queue;
+    Alloc_Count count;
+    count.start();
+    for (size_t i = 0; i < n; ++i) {
+      if (move)
+	queue.push(std::move(texts[i]));
+      else
+	queue.push(texts[i]);
+      const std::string popped = queue.pop();
+    }
+    count.stop();
+    add_result(report, move ? "queue/move" : "queue/copy", text_size, n, count, count.here_allocs, count.here_bytes);
+  }
+};//anonymous namespace
+
+
+//* re_bench namespace
+/**
+ * @brief this namespace is for the benchmark and stress suite.
+ */
+namespace re_bench {
+
+//* alloc_suite function
+/*
+ * @brief heap allocations per message, for each process_msg overload and process_msg_fmt, at each text size
+ * @remarks a case issues MSGS messages from the main thread (a tenth as many with --quick), after WARM_UP that aren't counted,
+ * and waits for the Message_Processor to write them all. the producer figures are the main thread's allocations while it issued
+ * them; the consumer figures are everybody else's until the last was written - ie. the Message_Processor thread's. the queue
+ * cases are single threaded, so their allocations are all the producer's.
+ */
+void alloc_suite(Report *const report) {
+  const size_t n = report->opts.quick ? MSGS / 10 : MSGS;
+  for (size_t s = 0; s < sizeof(text_sizes) / sizeof(text_sizes[0]); ++s) {
+    for (int kind = MSG_LVALUE; kind <= MSG_FMT; ++kind)
+      run_processor_case(report, static_cast<Msg_Kind>(kind), text_sizes[s], n);
+    run_queue_case(report, false, text_sizes[s], n);
+    run_queue_case(report, true, text_sizes[s], n);
+  }
+}
+};//namespace re_bench
@@ -0,0 +1,190 @@
+//* functional suite
+/*
+ * @remarks element throughput of copy_if, split_if and cast_if (see functional.h), sequential, vectorized and parallel, for
+ * predicates that pass from 1% to 99% of the elements
+ */
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include "gen/gendefs.h"
+#include "gen/functional_parallel.h"
+#include "gen/functional_simd.h"
+#include "gen/type_tag.h"
+#include "bench.h"
+
+namespace {
+  const int KEY_RANGE = 1 << 20;
+  //cast_if runs over objects rather than ints, so over at most this many
+  const size_t MAX_OBJECTS = 1024 * 1024;
+  const double selectivities[] = {0.01, 0.1, 0.5, 0.9, 0.99};
+
+  class Tagged_Base {
+    TYPE_TAG_ROOT(Tagged_Base)
+  public:
+    Tagged_Base(int _key) : key(_key) {}
+    virtual ~Tagged_Base(void) {}
+    int key;
+  };
+
+  class Tagged_Derived : public Tagged_Base {
+    TYPE_TAG(Tagged_Derived, Tagged_Base)
+  public:
+    Tagged_Derived(int _key) : Tagged_Base(_key) {}
+  };
+
+  class Plain_Base {
+  public:
+    Plain_Base(int _key) : key(_key) {}
+    virtual ~Plain_Base(void) {}
+    int key;
+  };
+
+  class Plain_Derived : public Plain_Base {
+  public:
+    Plain_Derived(int _key) : Plain_Base(_key) {}
+  };
+
+  //the same keys every run
+  std::vector<int> make_keys(size_t n) {
+    std::vector<int> keys(n);
+    uint32_t state = 12345;
+    for (size_t i = 0; i < n; ++i) {
+      state = state * 1664525u + 1013904223u;
+      keys[i] = static_cast<int>((state >> 8) % KEY_RANGE);
+    }
+    return(keys);
+  }
+
+  //a predicate that isn't a re_gen::compare, so the plain loop is used
+  struct Key_Below {
+    int bound;
+    explicit Key_Below(int _bound) : bound(_bound) {}
+    bool operator()(int key) const { return(key < bound); }
+    template <typename Object_T>
+    bool operator()(const Object_T *object) const { return(object->key < bound); }
+  };
+
+  //time fn() reps times; fn returns the number of elements it selected
+  template <typename Fn>
+  re_bench::Json_Object time_reps(int reps, size_t n, size_t expected, Fn fn, bool *const ok) {
+    std::vector<unsigned long long> times;
+    for (int rep = 0; rep < reps; ++rep) {
+      const unsigned long long start = re_bench::now_ns();
+      const size_t selected = fn();
+      times.push_back(re_bench::now_ns() - start);
+      if (selected != expected)
+	*ok = false;
+    }
+    std::sort(times.begin(), times.end());
+    const unsigned long long best = times.front(), median = times[times.size() / 2];
+    re_bench::Json_Object metrics;
+    metrics.add("best_ns", best).add("median_ns", median).add("elements_per_sec", n * 1e9 / best)
+      .add("median_elements_per_sec", n * 1e9 / median).add("selected", static_cast<unsigned long long>(expected));
+    return(metrics);
+  }
+
+  void add_result(re_bench::Report *const report, const std::string &case_name, double selectivity, size_t n,
+		  re_bench::Json_Object metrics, bool ok) {
+    re_bench::Json_Object params;
+    params.add("selectivity", selectivity).add("elements", static_cast<unsigned long long>(n));
+    metrics.add("ok", ok);
+    if (!ok)
+      report->fail();
+    report->add("functional", case_name, params, metrics);
+  }
+
+  template <typename Base_T, typename Derived_T>
+  void run_cast_cases(re_bench::Report *const report, const std::string &kind, const std::vector<int> &keys, double selectivity) {
+    const size_t n = std::min(keys.size(), MAX_OBJECTS);
+    const int bound = static_cast<int>(selectivity * KEY_RANGE);
+    std::vector<Base_T *> objects(n);
+    //every other object is a Derived_T; the rest cast to 0
+    for (size_t i = 0; i < n; ++i)
+      objects[i] = i % 2 == 0 ? new Derived_T(keys[i]) : new Base_T(keys[i]);
+    const size_t expected = std::count_if(objects.begin(), objects.end(), Key_Below(bound));
+    std::vector<Derived_T *> out(n);
+    re_gen::Parallel parallel(re_bench::online_cpus());
+    const int reps = report->opts.reps;
+    bool ok = true;
+    re_bench::Json_Object metrics = time_reps(reps, n, expected, [&]() {
+	return(re_gen::cast_if<Derived_T *>()(objects.begin(), objects.end(), out.begin(), Key_Below(bound)) - out.begin());
+      }, &ok);
+    add_result(report, "cast_if/" + kind, selectivity, n, metrics, ok);
+    ok = true;
+    metrics = time_reps(reps, n, expected, [&]() {
+	return(re_gen::cast_if<Derived_T *>()(parallel, objects.begin(), objects.end(), out.begin(), Key_Below(bound)) - out.begin());
+      }, &ok);
+    add_result(report, "cast_if/" + kind + "/parallel", selectivity, n, metrics, ok);
+    for (size_t i = 0; i < n; ++i)
+      delete objects[i];
+  }
+};//anonymous namespace
+
+
+//* re_bench namespace
+/**
+ * @brief this namespace is for the benchmark and stress suite.
+ */
+namespace re_bench {
+
+//* functional_suite function
+/*
+ * @brief each algorithm, each way it can run, at each selectivity
+ * @remarks the input is elements ints, spread evenly over [0, KEY_RANGE), and the predicate is key < selectivity * KEY_RANGE:
+ * a functor for the plain loop ("lambda"), less_than<int> for the vectorized one ("compare"), and the functor on the shared
+ * pool of one thread per cpu ("parallel"). cast_if runs over up to MAX_OBJECTS objects, half of them of the derived class, with
+ * tagged classes (tag_cast) and with untagged ones (dynamic_cast). each case is timed reps times; elements_per_sec is from the
+ * best time. a case that selects the wrong number of elements fails.
+ */
+void functional_suite(Report *const report) {
+  const size_t n = report->opts.elements;
+  const int reps = report->opts.reps;
+  const std::vector<int> keys = make_keys(n);
+  std::vector<int> out1(n), out2(n);
+  re_gen::Parallel parallel(online_cpus());
+  for (size_t s = 0; s < sizeof(selectivities) / sizeof(selectivities[0]); ++s) {
+    const double selectivity = selectivities[s];
+    const int bound = static_cast<int>(selectivity * KEY_RANGE);
+    const Key_Below functor(bound);
+    const re_gen::less_than<int> compare(bound);
+    const size_t expected = std::count_if(keys.begin(), keys.end(), functor);
+    bool ok = true;
+    Json_Object metrics = time_reps(reps, n, expected, [&]() {
+	return(re_gen::copy_if(keys.begin(), keys.end(), out1.begin(), functor) - out1.begin());
+      }, &ok);
+    add_result(report, "copy_if/lambda", selectivity, n, metrics, ok);
+    ok = true;
+    metrics = time_reps(reps, n, expected, [&]() {
+	return(re_gen::copy_if(keys.begin(), keys.end(), out1.begin(), compare) - out1.begin());
+      }, &ok);
+    add_result(report, "copy_if/compare", selectivity, n, metrics, ok);
+    ok = true;
+    metrics = time_reps(reps, n, expected, [&]() {
+	return(re_gen::copy_if(parallel, keys.begin(), keys.end(), out1.begin(), functor) - out1.begin());
+      }, &ok);
+    add_result(report, "copy_if/parallel", selectivity, n, metrics, ok);
+    ok = true;
+    metrics = time_reps(reps, n, expected, [&]() {
+	return(re_gen::split_if(keys.begin(), keys.end(), out1.begin(), out2.begin(), functor) - out1.begin());
+      }, &ok);
+    add_result(report, "split_if/lambda", selectivity, n, metrics, ok);
+    ok = true;
+    metrics = time_reps(reps, n, expected, [&]() {
+	return(re_gen::split_if(keys.begin(), keys.end(), out1.begin(), out2.begin(), compare) - out1.begin());
+      }, &ok);
+    add_result(report, "split_if/compare", selectivity, n, metrics, ok);
+    ok = true;
+    metrics = time_reps(reps, n, expected, [&]() {
+	return(re_gen::split_if(parallel, keys.begin(), keys.end(), out1.begin(), out2.begin(), functor) - out1.begin());
+      }, &ok);
+    add_result(report, "split_if/parallel", selectivity, n, metrics, ok);
+    run_cast_cases<Tagged_Base, Tagged_Derived>(report, "tagged", keys, selectivity);
+    run_cast_cases<Plain_Base, Plain_Derived>(report, "dynamic", keys, selectivity);
+  }
+  Json_Object params, metrics;
+  metrics.add("simd_level", re_gen::simd_level() == re_gen::SIMD_AVX512 ? "avx512" : re_gen::simd_level() == re_gen::SIMD_AVX2 ? "avx2" :
+	      "scalar");
+  report->add("functional", "simd_level", params, metrics);
+}
+};//namespace re_bench
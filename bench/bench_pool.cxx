@@ -0,0 +1,191 @@
+//* pool suite
+/*
+ * @remarks task throughput of re_gen::Thread_Pool (per-worker deques and work stealing) against the model that queue.h
+ * describes: a group of threads that pop tasks from one shared re_gen::Queue
+ */
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+#include <sched.h>
+#include "gen/gendefs.h"
+#include "gen/queue.h"
+#include "gen/thread_pool.h"
+#include "bench.h"
+
+namespace {
+  //the work in a task: this many steps of an LCG - some tens of nanoseconds, so the cost of handing out tasks shows
+  const unsigned WORK_STEPS = 64;
+  //the nested case: each root task submits this many children
+  const size_t FAN_OUT = 64;
+  //the parallel_for case: indexes per chunk
+  const size_t GRAIN = 256;
+  enum Work { WORK_EXTERNAL, WORK_NESTED, WORK_PARALLEL_FOR };
+  const char *const work_names[] = {"external", "nested", "parallel_for"};
+
+  //* Shared_Queue_Pool class
+  /*
+   * @brief a fixed number of threads that pop tasks from one shared re_gen::Queue, and run them
+   * @remarks an empty task stops a worker. wait is Thread_Pool::drain's counterpart: it returns once every task executed so
+   * far, and every task they executed, has finished.
+   */
+  class Shared_Queue_Pool {
+  public:
+    typedef std::function<void(void)> Task;
+    Shared_Queue_Pool(size_t n_workers) : tasks(), unfinished(0), threads() {
+      for (size_t i = 0; i < n_workers; ++i)
+	threads.push_back(std::thread(&Shared_Queue_Pool::loop, this));
+    }
+    ~Shared_Queue_Pool(void) {
+      for (size_t i = 0; i < threads.size(); ++i)
+	tasks.push(Task());
+      for (size_t i = 0; i < threads.size(); ++i)
+	threads[i].join();
+    }
+    void execute(Task task) {
+      unfinished.fetch_add(1, std::memory_order_relaxed);
+      tasks.push(std::move(task));
+    }
+    void wait(void) {
+      while (unfinished.load(std::memory_order_acquire) != 0)
+	sched_yield();
+    }
+  private:
+    void loop(void) {
+      for (;;) {
+	Task task = tasks.pop();
+	if (!task)
+	  return;
+	task();
+	unfinished.fetch_sub(1, std::memory_order_release);
+      }
+    }
+    re_gen::Queue<Task> tasks;
+    std::atomic<size_t> unfinished;
+    std::vector<std::thread> threads;
+    Shared_Queue_Pool(const Shared_Queue_Pool &);
+    Shared_Queue_Pool& operator=(const Shared_Queue_Pool &);
+  };
+
+  void wait_all(re_gen::Thread_Pool &pool) {
+    pool.drain();
+  }
+  void wait_all(Shared_Queue_Pool &pool) {
+    pool.wait();
+  }
+
+  //Thread_Pool's parallel_for has the calling thread run chunks too; with a shared queue the caller only hands them out
+  template <typename Fn>
+  void chunked_for(re_gen::Thread_Pool &pool, size_t n, Fn fn) {
+    pool.parallel_for(0, n, fn, GRAIN);
+  }
+  template <typename Fn>
+  void chunked_for(Shared_Queue_Pool &pool, size_t n, Fn fn) {
+    for (size_t begin = 0; begin < n; begin += GRAIN) {
+      const size_t end = std::min(n, begin + GRAIN);
+      pool.execute([=]() {
+	  for (size_t i = begin; i < end; ++i)
+	    fn(i);
+	});
+    }
+    pool.wait();
+  }
+
+  //each task leaves a nonzero result in its own slot, so the check is that every slot was filled
+  void work(unsigned long *const slot, size_t i) {
+    unsigned long x = i;
+    for (unsigned step = 0; step < WORK_STEPS; ++step)
+      x = x * 6364136223846793005UL + 1442695040888963407UL;
+    *slot = x | 1;
+  }
+
+  template <typename Pool_T>
+  void run_work(Pool_T &pool, Work kind, std::vector<unsigned long> &slots) {
+    unsigned long *const results = &slots[0];
+    const size_t n = slots.size();
+    switch (kind) {
+    case WORK_EXTERNAL:
+      for (size_t i = 0; i < n; ++i)
+	pool.execute([=]() { work(results + i, i); });
+      wait_all(pool);
+      break;
+    case WORK_NESTED:
+      //the children are submitted by a worker: Thread_Pool puts them on that worker's deque, for the others to steal
+      for (size_t root = 0; root < n / FAN_OUT; ++root) {
+	pool.execute([=, &pool]() {
+	    for (size_t i = root * FAN_OUT; i < (root + 1) * FAN_OUT; ++i)
+	      pool.execute([=]() { work(results + i, i); });
+	  });
+      }
+      wait_all(pool);
+      break;
+    case WORK_PARALLEL_FOR:
+      chunked_for(pool, n, [=](size_t i) { work(results + i, i); });
+      break;
+    }
+  }
+
+  template <typename Pool_T>
+  void run_case(re_bench::Report *const report, const char *pool_name, size_t n_workers, Work kind) {
+    //the nested case runs whole fans
+    const size_t n = kind == WORK_NESTED ? std::max(report->opts.tasks / FAN_OUT, static_cast<size_t>(1)) * FAN_OUT :
+      report->opts.tasks;
+    std::vector<unsigned long> slots(n);
+    std::vector<unsigned long long> times;
+    bool ok = true;
+    {
+      Pool_T pool(n_workers);
+      for (int rep = 0; rep < report->opts.reps; ++rep) {
+	std::fill(slots.begin(), slots.end(), 0);
+	const unsigned long long start = re_bench::now_ns();
+	run_work(pool, kind, slots);
+	times.push_back(re_bench::now_ns() - start);
+	if (std::count(slots.begin(), slots.end(), 0UL) != 0)
+	  ok = false;
+      }
+    }
+    std::sort(times.begin(), times.end());
+    const unsigned long long best = times.front(), median = times[times.size() / 2];
+    re_bench::Json_Object params, metrics;
+    params.add("workers", static_cast<unsigned long long>(n_workers)).add("tasks", static_cast<unsigned long long>(n))
+      .add("work_steps", static_cast<unsigned long long>(WORK_STEPS));
+    if (kind == WORK_NESTED)
+      params.add("fan_out", static_cast<unsigned long long>(FAN_OUT));
+    if (kind == WORK_PARALLEL_FOR)
+      params.add("grain", static_cast<unsigned long long>(GRAIN));
+    metrics.add("best_ns", best).add("median_ns", median).add("tasks_per_sec", n * 1e9 / best)
+      .add("median_tasks_per_sec", n * 1e9 / median).add("ok", ok);
+    if (!ok)
+      report->fail();
+    report->add("pool", std::string(pool_name) + "/" + work_names[kind], params, metrics);
+  }
+};//anonymous namespace
+
+
+//* re_bench namespace
+/**
+ * @brief this namespace is for the benchmark and stress suite.
+ */
+namespace re_bench {
+
+//* pool_suite function
+/*
+ * @brief Thread_Pool and a shared Queue, with each kind of work, for 1, 2, 4 ... max_workers workers
+ * @remarks each case runs tasks small tasks (of WORK_STEPS steps), reps times, on one pool:
+ * external - submitted one at a time from the main thread, which then waits for them all;
+ * nested - submitted, FAN_OUT at a time, by root tasks that run on the workers;
+ * parallel_for - GRAIN indexes per chunk, by Thread_Pool::parallel_for, or as one queued task per chunk.
+ * tasks_per_sec is from the best time. a case in which a task didn't run fails.
+ */
+void pool_suite(Report *const report) {
+  const std::vector<size_t> workers = doublings(report->opts.max_workers);
+  for (size_t w = 0; w < workers.size(); ++w) {
+    for (int kind = WORK_EXTERNAL; kind <= WORK_PARALLEL_FOR; ++kind) {
+      run_case<re_gen::Thread_Pool>(report, "thread_pool", workers[w], static_cast<Work>(kind));
+      run_case<Shared_Queue_Pool>(report, "shared_queue", workers[w], static_cast<Work>(kind));
+    }
+  }
+}
+};//namespace re_bench
@@ -0,0 +1,126 @@
+//* processor suite
+/*
+ * @remarks end to end cost of Message_Processor::process_msg: the time a call takes, the latency from issue to write, and the
+ * rate the Message_Processor can sustain, into a Null_Sink and a File_Sink
+ */
+#include <string>
+#include <vector>
+#include <thread>
+#include <cstdio>
+#include <algorithm>
+#include <unistd.h>
+#include "gen/gendefs.h"
+#include "gen/message_processor.h"
+#include "gen/message_sink.h"
+#include "bench.h"
+
+namespace {
+  //every SAMPLE'th call is timed
+  const size_t SAMPLE = 16;
+  const size_t LONG_TEXT = 2000, LONG_TEXT_SHARE = 32;
+  enum Msg_Kind { MSG_TEXT, MSG_FMT, MSG_LONG_TEXT };
+  enum Sink_Kind { SINK_NULL, SINK_NULL_FORMAT, SINK_FILE };
+  const char *const kind_names[] = {"text", "fmt", "long_text"};
+  const char *const sink_names[] = {"null", "null_format", "file"};
+
+  re_gen::Message_Sink *make_sink(Sink_Kind sink_kind, const std::string &file_name) {
+    switch (sink_kind) {
+    case SINK_NULL:
+      return(new re_gen::Null_Sink);
+    case SINK_NULL_FORMAT:
+      return(new re_gen::Null_Sink(true));
+    default:
+      return(new re_gen::File_Sink(file_name));
+    }
+  }
+
+  void issue(re_gen::Message_Processor *mp, int src, Msg_Kind kind, size_t n, re_bench::Latencies *call_latency) {
+    const std::string text(kind == MSG_LONG_TEXT ? LONG_TEXT : 48, 'x');
+    call_latency->reserve(n / SAMPLE + 1);
+    for (size_t i = 0; i < n; ++i) {
+      const unsigned long long start = i % SAMPLE == 0 ? re_bench::now_ns() : 0;
+      if (kind == MSG_FMT)
+	mp->process_msg_fmt(src, re_gen::VERBOSITY_MINOR_STEPS, "::issue - message %lu of %lu, from %s", i, n, "bench");
+      else
+	mp->process_msg(src, re_gen::VERBOSITY_MINOR_STEPS, text);
+      if (start != 0)
+	call_latency->add(re_bench::now_ns() - start);
+    }
+  }
+
+  void run_case(re_bench::Report *const report, Sink_Kind sink_kind, Msg_Kind kind, size_t n_producers) {
+    //long messages are fewer, so that the file stays a reasonable size
+    const size_t msgs = kind == MSG_LONG_TEXT ? std::max(report->opts.msgs / LONG_TEXT_SHARE, n_producers) : report->opts.msgs;
+    re_gen::Msg_Processor_Stats final_stats;
+    const unsigned long long start = re_bench::now_ns();
+    unsigned long long issued_at;
+    std::vector<re_bench::Latencies> call_latency(n_producers);
+    {
+      re_gen::Message_Processor mp(re_gen::VERBOSITY_MINOR_STEPS, re_gen::OVERFLOW_BLOCK);
+      mp.set_sink(make_sink(sink_kind, report->opts.file_sink));
+      mp.set_final_stats(&final_stats);
+      const int src = mp.register_msg_src(re_gen::VERBOSITY_EVERYTHING, "bench");
+      std::vector<std::thread> producers;
+      for (size_t p = 0; p < n_producers; ++p) {
+	const size_t n = msgs / n_producers + (p < msgs % n_producers ? 1 : 0);
+	producers.push_back(std::thread(issue, &mp, src, kind, n, &call_latency[p]));
+      }
+      for (size_t p = 0; p < n_producers; ++p)
+	producers[p].join();
+      issued_at = re_bench::now_ns();
+    }
+    //the destructor has written everything, and flushed the sink
+    const unsigned long long elapsed = re_bench::now_ns() - start;
+    if (sink_kind == SINK_FILE)
+      unlink(report->opts.file_sink.c_str());
+    re_bench::Latencies calls;
+    for (size_t p = 0; p < n_producers; ++p)
+      calls.add(call_latency[p]);
+    re_gen::Msg_Src_Stats bench_src = re_gen::Msg_Src_Stats();
+    for (size_t src = 0; src < final_stats.srcs.size(); ++src) {
+      if (final_stats.src_names[src] == "bench")
+	bench_src = final_stats.srcs[src];
+    }
+    std::string stats_json;
+    re_gen::format_stats_json(final_stats, &stats_json);
+    re_bench::Json_Object params, metrics;
+    params.add("sink", sink_names[sink_kind]).add("msg", kind_names[kind]).add("producers", static_cast<unsigned long long>(n_producers))
+      .add("msgs", static_cast<unsigned long long>(msgs)).add("overflow", "block");
+    metrics.add("issue_ns", issued_at - start).add("elapsed_ns", elapsed).add("issue_rate", msgs * 1e9 / (issued_at - start))
+      .add("sustained_rate", msgs * 1e9 / elapsed).add("call_latency", calls.percentiles())
+      .add("lost", static_cast<long>(bench_src.issued - bench_src.written - bench_src.coalesced))
+      .add_raw("stats", stats_json);
+    if (bench_src.issued != msgs || bench_src.written + bench_src.coalesced != bench_src.issued)
+      report->fail();
+    report->add("processor", std::string(sink_names[sink_kind]) + "/" + kind_names[kind], params, metrics);
+  }
+};//anonymous namespace
+
+
+//* re_bench namespace
+/**
+ * @brief this namespace is for the benchmark and stress suite.
+ */
+namespace re_bench {
+
+//* processor_suite function
+/*
+ * @brief each sink, with each kind of message, from 1 and from 4 threads
+ * @remarks the producers issue msgs messages between them (or, of LONG_TEXT bytes, 1 / LONG_TEXT_SHARE as many), as fast as
+ * they can, with OVERFLOW_BLOCK, so nothing is dropped. issue_rate is messages per second until the last call returned;
+ * sustained_rate is until the Message_Processor had written (and flushed) the last of them - ie. what it can keep up with.
+ * call_latency is the time a process_msg call takes (sampled, one in SAMPLE); stats is the Message_Processor's final stats (see format_stats_json), whose latency_ns is the time from issue to
+ * write. a message that was issued and not written counts as lost, and as a failure.
+ * @remarks null_format is a Null_Sink that still has each message's text made, so it's the Message_Processor's work short of
+ * output; file is a File_Sink, with its default buffer.
+ */
+void processor_suite(Report *const report) {
+  const size_t producers[] = {1, 4};
+  for (int sink = SINK_NULL; sink <= SINK_FILE; ++sink) {
+    for (int kind = MSG_TEXT; kind <= MSG_LONG_TEXT; ++kind) {
+      for (size_t p = 0; p < sizeof(producers) / sizeof(producers[0]); ++p)
+	run_case(report, static_cast<Sink_Kind>(sink), static_cast<Msg_Kind>(kind), producers[p]);
+    }
+  }
+}
+};//namespace re_bench
@@ -0,0 +1,157 @@
+//* queue suite
+/*
+ * @remarks push/pop throughput and latency of re_gen::Queue (mutex and condition variables) and re_gen::Bounded_Queue (lock-free),
+ * for 1 .. max_producers producers and 1 .. max_consumers consumers
+ */
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <stdint.h>
+#include <sched.h>
+#include "gen/gendefs.h"
+#include "gen/queue.h"
+#include "gen/bounded_queue.h"
+#include "bench.h"
+
+namespace {
+  const size_t CAPACITY = 4096;
+  //every SAMPLE'th object is timed: its push, and its time in the queue
+  const uint32_t SAMPLE = 16;
+
+  struct Item {
+    unsigned long long stamp;    //when it was pushed, for a sampled object; else 0
+    uint32_t producer;
+    uint32_t seq;
+  };
+
+  struct Locked {
+    typedef re_gen::Queue<Item> Type;
+    static Type *make(void) { return(new Type(CAPACITY, re_gen::OVERFLOW_BLOCK)); }
+    static const char *name(void) { return("queue"); }
+  };
+
+  struct Lock_Free {
+    typedef re_gen::Bounded_Queue<Item, CAPACITY> Type;
+    static Type *make(void) { return(new Type(re_gen::OVERFLOW_BLOCK)); }
+    static const char *name(void) { return("bounded_queue"); }
+  };
+
+  //what a consumer saw
+  struct Consumed {
+    size_t n;
+    bool in_order;               //each producer's objects came in the order they were pushed
+    re_bench::Latencies in_queue;
+    Consumed(void) : n(0), in_order(true), in_queue() {}
+  };
+
+  void wait_for(const std::atomic<bool> &go) {
+    while (!go.load(std::memory_order_acquire))
+      sched_yield();
+  }
+
+  template <typename Queue_T>
+  void produce(Queue_T *queue, const std::atomic<bool> *go, uint32_t producer, size_t n, re_bench::Latencies *push_latency) {
+    push_latency->reserve(n / SAMPLE + 1);
+    wait_for(*go);
+    for (uint32_t seq = 0; seq < n; ++seq) {
+      Item item = {0, producer, seq};
+      if (seq % SAMPLE != 0) {
+	queue->push(item);
+	continue;
+      }
+      item.stamp = re_bench::now_ns();
+      queue->push(item);
+      push_latency->add(re_bench::now_ns() - item.stamp);
+    }
+  }
+
+  template <typename Queue_T>
+  void consume(Queue_T *queue, const std::atomic<bool> *go, size_t n_producers, Consumed *consumed) {
+    std::vector<long long> last_seq(n_producers, -1);
+    Item item = Item();
+    wait_for(*go);
+    while (queue->pop_for(item, std::chrono::milliseconds(100)) != re_gen::QUEUE_CLOSED) {
+      if (item.stamp != 0)
+	consumed->in_queue.add(re_bench::now_ns() - item.stamp);
+      if (static_cast<long long>(item.seq) <= last_seq[item.producer])
+	consumed->in_order = false;
+      last_seq[item.producer] = item.seq;
+      ++consumed->n;
+    }
+  }
+
+  template <typename Kind>
+  void run_case(re_bench::Report *const report, size_t n_producers, size_t n_consumers) {
+    const size_t ops = report->opts.queue_ops;
+    typename Kind::Type *queue = Kind::make();
+    std::atomic<bool> go(false);
+    std::vector<re_bench::Latencies> push_latency(n_producers);
+    std::vector<Consumed> consumed(n_consumers);
+    std::vector<std::thread> producers, consumers;
+    for (size_t c = 0; c < n_consumers; ++c)
+      consumers.push_back(std::thread(consume<typename Kind::Type>, queue, &go, n_producers, &consumed[c]));
+    for (size_t p = 0; p < n_producers; ++p) {
+      const size_t n = ops / n_producers + (p < ops % n_producers ? 1 : 0);
+      producers.push_back(std::thread(produce<typename Kind::Type>, queue, &go, static_cast<uint32_t>(p), n, &push_latency[p]));
+    }
+    const unsigned long long start = re_bench::now_ns();
+    go.store(true, std::memory_order_release);
+    for (size_t p = 0; p < n_producers; ++p)
+      producers[p].join();
+    queue->close();
+    for (size_t c = 0; c < n_consumers; ++c)
+      consumers[c].join();
+    const unsigned long long elapsed = re_bench::now_ns() - start;
+    const re_gen::Queue_Stats stats = queue->stats();
+    delete queue;
+
+    re_bench::Latencies pushes, in_queue;
+    size_t popped = 0;
+    bool in_order = true;
+    for (size_t p = 0; p < n_producers; ++p)
+      pushes.add(push_latency[p]);
+    for (size_t c = 0; c < n_consumers; ++c) {
+      in_queue.add(consumed[c].in_queue);
+      popped += consumed[c].n;
+      in_order = in_order && consumed[c].in_order;
+    }
+    re_bench::Json_Object params, metrics;
+    params.add("producers", static_cast<unsigned long long>(n_producers)).add("consumers", static_cast<unsigned long long>(n_consumers))
+      .add("ops", static_cast<unsigned long long>(ops)).add("capacity", static_cast<unsigned long long>(CAPACITY));
+    metrics.add("elapsed_ns", elapsed).add("ops_per_sec", ops * 1e9 / elapsed).add("lost", static_cast<long>(ops - popped))
+      .add("fifo_per_producer", in_order).add("push_latency", pushes.percentiles()).add("queue_latency", in_queue.percentiles())
+      .add("high_water", static_cast<unsigned long long>(stats.high_water)).add("push_blocked_ns", stats.push_blocked_ns)
+      .add("pop_blocked_ns", stats.pop_blocked_ns);
+    if (popped != ops || !in_order)
+      report->fail();
+    report->add("queue", Kind::name(), params, metrics);
+  }
+};//anonymous namespace
+
+
+//* re_bench namespace
+/**
+ * @brief this namespace is for the benchmark and stress suite.
+ */
+namespace re_bench {
+
+//* queue_suite function
+/*
+ * @brief every combination of producers and consumers, for both queues
+ * @remarks the producers push ops objects between them, as fast as they can, into a queue of CAPACITY that blocks when it's full;
+ * the consumers pop until the queue is closed. ops_per_sec is the whole run, from the start signal to the last pop. push_latency
+ * is the time a push call takes (blocking included); queue_latency is the time from just before the push to just after the
+ * pop; both are sampled, one object in SAMPLE. fifo_per_producer checks that no consumer saw a producer's objects out of order;
+ * it, and lost, count as failures.
+ */
+void queue_suite(Report *const report) {
+  const std::vector<size_t> producers = doublings(report->opts.max_producers), consumers = doublings(report->opts.max_consumers);
+  for (size_t p = 0; p < producers.size(); ++p) {
+    for (size_t c = 0; c < consumers.size(); ++c) {
+      run_case<Locked>(report, producers[p], consumers[c]);
+      run_case<Lock_Free>(report, producers[p], consumers[c]);
+    }
+  }
+}
+};//namespace re_bench
@@ -0,0 +1,209 @@
+//* stress suite
+/*
+ * @remarks many threads issue numbered messages - text, long text, deferred, and errors - while another switches sinks and
+ * flushes; a checking sink verifies that each thread's messages arrive in order, with none missing, and the final stats that
+ * nothing was lost at shutdown. build it with -fsanitize=thread (make tsan) to have the races checked too.
+ */
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#include "gen/gendefs.h"
+#include "gen/message_processor.h"
+#include "gen/message_sink.h"
+#include "bench.h"
+
+namespace {
+  enum Lane { LANE_NORMAL, LANE_URGENT, N_LANES };
+  const size_t LONG_TEXT = 3000;
+  //a bound on a crash ring record, beyond the message's text
+  const size_t CRASH_RECORD_OVERHEAD = 128;
+
+  //what the checking sinks have seen; only touched by the Message_Processor thread, until it has been joined
+  struct Check_State {
+    int src;
+    std::vector<unsigned long> next_seq[N_LANES];   //indexed by producer
+    unsigned long received;
+    unsigned long out_of_order;
+    unsigned long wrong_lane;
+    unsigned long garbled;
+    std::string first_error;
+    Check_State(int _src, size_t n_producers) : src(_src), received(0), out_of_order(0), wrong_lane(0), garbled(0), first_error() {
+      for (int lane = 0; lane < N_LANES; ++lane)
+	next_seq[lane].assign(n_producers, 0);
+    }
+    void error(unsigned long *const count, const std::string &what) {
+      if (first_error.empty())
+	first_error = what;
+      ++*count;
+    }
+  };
+
+  //* Check_Sink class
+  /*
+   * @brief checks each stress message as it's written: "<producer> <lane> <seq>", and then (for a long message) padding
+   * @remarks the sinks are replaced while the stress runs; they all share one Check_State.
+   */
+  class Check_Sink : public re_gen::Message_Sink {
+  public:
+    Check_Sink(Check_State *_state) : state(_state) {}
+    void write(const re_gen::Sink_Msg &msg) {
+      if (msg.src != state->src)
+	return;
+      const std::string &text = msg.text();
+      unsigned long producer, lane, seq;
+      int end = 0;
+      if (sscanf(text.c_str(), "%lu %lu %lu%n", &producer, &lane, &seq, &end) != 3 || lane >= N_LANES ||
+	  producer >= state->next_seq[lane].size() || (text.size() != static_cast<size_t>(end) && text.size() != LONG_TEXT)) {
+	state->error(&state->garbled, "garbled: " + text.substr(0, 64));
+	return;
+      }
+      ++state->received;
+      if ((lane == LANE_URGENT) != (msg.severity == re_gen::VERBOSITY_ERRORS))
+	state->error(&state->wrong_lane, "wrong lane: " + text.substr(0, 64));
+      unsigned long &next = state->next_seq[lane][producer];
+      if (seq != next) {
+	char what[96];
+	snprintf(what, sizeof(what), "producer %lu lane %lu: got %lu, expected %lu", producer, lane, seq, next);
+	state->error(&state->out_of_order, what);
+      }
+      next = seq + 1;
+    }
+    void flush(void) {}
+  private:
+    Check_State *state;
+    Check_Sink(const Check_Sink &);
+    Check_Sink& operator=(const Check_Sink &);
+  };
+
+  //what one producer issued
+  struct Issued {
+    unsigned long lanes[N_LANES];
+  };
+
+  void produce(re_gen::Message_Processor *mp, int src, unsigned long producer, size_t n, Issued *issued) {
+    unsigned long seq[N_LANES] = {0, 0};
+    std::string text;
+    for (size_t i = 0; i < n; ++i) {
+      const Lane lane = i % 7 == 3 ? LANE_URGENT : LANE_NORMAL;
+      const re_gen::Verbosity_Level severity = lane == LANE_URGENT ? re_gen::VERBOSITY_ERRORS : re_gen::VERBOSITY_MINOR_STEPS;
+      const unsigned long lane_number = lane;
+      if (i % 5 == 0)
+	mp->process_msg_fmt(src, severity, "%lu %lu %lu", producer, lane_number, seq[lane]);
+      else {
+	char head[64];
+	snprintf(head, sizeof(head), "%lu %lu %lu", producer, lane_number, seq[lane]);
+	text = head;
+	if (i % 11 == 0)
+	  text.resize(LONG_TEXT, '.');
+	if (i % 2 == 0)
+	  mp->process_msg(src, severity, text);
+	else
+	  mp->process_msg(src, severity, text.c_str());
+      }
+      ++seq[lane];
+    }
+    for (int lane = 0; lane < N_LANES; ++lane)
+      issued->lanes[lane] = seq[lane];
+  }
+
+  //switch sinks, flush, and change the time stamp columns, until told to stop
+  void meddle(re_gen::Message_Processor *mp, Check_State *state, const std::atomic<bool> *stop) {
+    for (int i = 0; !stop->load(); ++i) {
+      if (i % 3 == 0)
+	mp->set_sink(new Check_Sink(state));
+      else if (i % 3 == 1)
+	mp->flush();
+      else
+	mp->set_timestamps(i % 2 == 0 ? re_gen::TIMESTAMP_NONE : re_gen::TIMESTAMP_LATENCY);
+      usleep(1000);
+    }
+  }
+
+  void run_round(re_bench::Report *const report, int round) {
+    const size_t n_producers = report->opts.stress_threads, n = report->opts.stress_msgs;
+    const std::string crash_log = report->opts.file_sink + ".crash";
+    re_gen::Msg_Processor_Stats final_stats;
+    std::vector<Issued> issued(n_producers);
+    Check_State *state = 0;
+    const unsigned long long start = re_bench::now_ns();
+    {
+      re_gen::Message_Processor mp(re_gen::VERBOSITY_MINOR_STEPS, re_gen::OVERFLOW_BLOCK);
+      const int src = mp.register_msg_src(re_gen::VERBOSITY_EVERYTHING, "stress");
+      state = new Check_State(src, n_producers);
+      mp.set_sink(new Check_Sink(state));
+      mp.set_final_stats(&final_stats);
+      //every other round, with a crash ring too, which producers write as they issue. it's big enough for every record of the
+      //round: a ring that laps has writers overwrite each other's records (which is the ring's documented best effort, and a
+      //race thread sanitizer rightly reports), and that isn't what this checks
+      if (round % 2 == 1) {
+	const size_t long_texts = n / 11 + 1;
+	mp.set_crash_log(crash_log, n_producers * (n * CRASH_RECORD_OVERHEAD + long_texts * LONG_TEXT));
+      }
+      std::atomic<bool> stop(false);
+      std::thread meddler(meddle, &mp, state, &stop);
+      std::vector<std::thread> producers;
+      for (size_t p = 0; p < n_producers; ++p)
+	producers.push_back(std::thread(produce, &mp, src, static_cast<unsigned long>(p), n, &issued[p]));
+      for (size_t p = 0; p < n_producers; ++p)
+	producers[p].join();
+      stop.store(true);
+      meddler.join();
+      //and straight into the destructor, with the backlog still queued
+    }
+    const unsigned long long elapsed = re_bench::now_ns() - start;
+    if (round % 2 == 1)
+      unlink(crash_log.c_str());
+
+    unsigned long total = 0, missing = 0;
+    for (size_t p = 0; p < n_producers; ++p) {
+      for (int lane = 0; lane < N_LANES; ++lane) {
+	total += issued[p].lanes[lane];
+	if (state->next_seq[lane][p] != issued[p].lanes[lane])
+	  missing += issued[p].lanes[lane] - std::min(state->next_seq[lane][p], issued[p].lanes[lane]);
+      }
+    }
+    re_gen::Msg_Src_Stats stress_src = re_gen::Msg_Src_Stats();
+    for (size_t src = 0; src < final_stats.srcs.size(); ++src) {
+      if (final_stats.src_names[src] == "stress")
+	stress_src = final_stats.srcs[src];
+    }
+    const bool ok = state->received == total && missing == 0 && state->out_of_order == 0 && state->wrong_lane == 0 &&
+      state->garbled == 0 && stress_src.issued == total && stress_src.written == total && stress_src.dropped == 0;
+    re_bench::Json_Object params, metrics;
+    params.add("round", round).add("producers", static_cast<unsigned long long>(n_producers))
+      .add("msgs_per_producer", static_cast<unsigned long long>(n)).add("crash_log", round % 2 == 1);
+    metrics.add("ok", ok).add("elapsed_ns", elapsed).add("issued", total).add("received", state->received).add("missing", missing)
+      .add("out_of_order", state->out_of_order).add("wrong_lane", state->wrong_lane).add("garbled", state->garbled)
+      .add("stats_issued", stress_src.issued).add("stats_written", stress_src.written).add("stats_dropped", stress_src.dropped)
+      .add("first_error", state->first_error);
+    delete state;
+    if (!ok)
+      report->fail();
+    report->add("stress", "ordering_and_shutdown", params, metrics);
+  }
+};//anonymous namespace
+
+
+//* re_bench namespace
+/**
+ * @brief this namespace is for the benchmark and stress suite.
+ */
+namespace re_bench {
+
+//* stress_suite function
+/*
+ * @brief stress_rounds rounds, each with a Message_Processor of its own that is destroyed with its backlog still queued
+ * @remarks each producer numbers its messages per lane - errors go in the urgent lane, and may overtake - so the check is that
+ * each producer's messages in each lane are written in order, with none missing; and the final stats must show every message
+ * issued as written, and none dropped (the queues block, rather than drop). a round fails if any check does.
+ */
+void stress_suite(Report *const report) {
+  for (int round = 0; round < report->opts.stress_rounds; ++round)
+    run_round(report, round);
+}
+};//namespace re_bench
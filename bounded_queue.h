@@ -0,0 +1,538 @@
+#ifndef _BOUNDED_QUEUE_H_
+#define _BOUNDED_QUEUE_H_
+
+// system includes
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+#include "gen/queue.h"
+
+namespace re_gen {
+
+/*
+ * the re_gen::Bounded_Queue class is a fixed-capacity, lock-free, multi-producer / multi-consumer variant of re_gen::Queue.
+ * objects are stored in a ring buffer of Capacity slots, each slot carrying a sequence number (Vyukov's algorithm), so a push
+ * or pop is a single compare-and-swap on the enqueue or dequeue position; there is no mutex on the fast path and no
+ * allocation after construction.
+ *
+ * threads that pop an empty queue (or push a full one) spin briefly, and only then park on a condition variable. the mutex
+ * that protects the condition variables is taken by the other side only when it sees that somebody is parked, so in steady
+ * state neither producers nor consumers ever touch it.
+ *
+ * @param Queue_Of_T - the type of object that is queued. unlike re_gen::Queue it does not need a default constructor.
+ * @param Capacity - the number of slots in the ring. it must be a power of two.
+ * @param policy - constructor parameter; what push does when the queue is full (see re_gen::Overflow_Policy).
+ *
+ * @note with OVERFLOW_BLOCK, push blocks when the queue is full. size your queue so that this only happens when the consumers
+ * really can't keep up.
+ * @note as with re_gen::Queue, push has copy and move overloads, emplace constructs the object directly in its ring slot, and
+ * objects are moved (not copied) out of the ring.
+ * @note pop_batch and drain_into block, like pop, until there is at least one object; then they keep taking objects without
+ * blocking until the queue is empty (or max_n objects have been taken), and wake waiting threads just once for the whole batch.
+ * try_pop_batch is the same, except that it never blocks; it returns 0 if the queue is empty.
+ * @note try_pop_batch_until is try_pop_batch for only the objects that were pushed before push_position() returned end_pos: a
+ * consumer that also takes objects from elsewhere can tell which of them were queued before it looked there. the push that
+ * moved the position past an object happens-before push_position's return, so whatever its thread did before the push is
+ * visible to the caller too.
+ * @note try_pop, pop_for and close behave as they do for re_gen::Queue: after a close, pushes fail, the objects that are already
+ * queued can still be popped, and then the pops report QUEUE_CLOSED (pop throws std::runtime_error).
+ * @note depth() is a snapshot; with concurrent pushers and poppers it is only approximate.
+ * @note stats() is a snapshot too. pushes and pops are the enqueue and dequeue positions, so counting them costs nothing; the
+ * high water mark is sampled by the poppers (and set to Capacity when a push finds the queue full), so producers never touch
+ * it; blocked times are only measured once a thread stops spinning and parks.
+ * @note as with re_gen::Queue, the destructor does not release threads that are waiting on the queue; close it first.
+ */
+template <typename Queue_Of_T, size_t Capacity>
+class Bounded_Queue {
+ public:
+    Bounded_Queue(Overflow_Policy policy = OVERFLOW_BLOCK);
+    ~Bounded_Queue(void);
+    bool push(const Queue_Of_T &obj);
+    bool push(Queue_Of_T &&obj);
+    bool push(const Queue_Of_T &obj, Overflow_Policy policy);
+    bool push(Queue_Of_T &&obj, Overflow_Policy policy);
+    bool try_push(const Queue_Of_T &obj);
+    bool try_push(Queue_Of_T &&obj);
+    template <typename... Args> bool emplace(Args&&... args);
+    Queue_Of_T pop(void);
+    Queue_Status try_pop(Queue_Of_T &obj);
+    template <typename Rep, typename Period> Queue_Status pop_for(Queue_Of_T &obj, const std::chrono::duration<Rep, Period> &timeout);
+    template <typename Output_It> size_t pop_batch(Output_It out, size_t max_n);
+    template <typename Output_It> size_t try_pop_batch(Output_It out, size_t max_n);
+    template <typename Output_It> size_t try_pop_batch_until(Output_It out, size_t end_pos);
+    size_t push_position(void) const { return(enqueue_pos.load(std::memory_order_acquire)); }
+    size_t drain_into(std::vector<Queue_Of_T> &objs);
+    void wait_empty(void);
+    void close(void);
+    bool is_closed(void) const { return(q_closed.load(std::memory_order_acquire)); }
+    size_t capacity(void) const { return(Capacity); }
+    size_t depth(void) const;
+    unsigned long dropped(void) const { return(q_dropped.load(std::memory_order_relaxed)); }
+    Queue_Stats stats(void) const;
+
+ private:
+    enum { SPIN_COUNT = 128, CACHE_LINE = 64 };
+    struct Cell {
+      std::atomic<size_t> sequence;
+      typename std::aligned_storage<sizeof(Queue_Of_T), std::alignment_of<Queue_Of_T>::value>::type storage;
+    };
+    template <typename... Args> bool try_enqueue(Args&&... args);
+    bool try_dequeue(Queue_Of_T *obj_storage, size_t end_pos = static_cast<size_t>(-1));
+    bool is_empty(void) const;
+    bool discard_oldest(void);
+    template <typename... Args> bool push_with(Overflow_Policy policy, Args&&... args);
+    template <typename... Args> bool block_until_pushed(Args&&... args);
+    Queue_Status block_until_popped(Queue_Of_T *obj_storage, const timespec *deadline = 0);
+    void popped(size_t n);
+    void raise_high_water(size_t n);
+    void wake(pthread_cond_t *cond, std::atomic<int> *waiters);
+
+    char pad0[CACHE_LINE];
+    std::atomic<size_t> enqueue_pos;
+    char pad1[CACHE_LINE - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> dequeue_pos;
+    char pad2[CACHE_LINE - sizeof(std::atomic<size_t>)];
+    std::atomic<int> push_waiters;
+    std::atomic<int> pop_waiters;
+    std::atomic<int> empty_waiters;
+    std::atomic<unsigned long> q_dropped;
+    std::atomic<size_t> high_water;
+    std::atomic<unsigned long long> push_blocked_ns;
+    std::atomic<unsigned long long> pop_blocked_ns;
+    std::atomic<unsigned long long> wait_empty_ns;
+    std::atomic<bool> q_closed;
+    Overflow_Policy q_policy;
+    pthread_mutex_t q_mutex;
+    pthread_cond_t q_push_cond;
+    pthread_cond_t q_pop_cond;
+    pthread_cond_t q_empty_cond;
+    Cell cells[Capacity];
+    // don't allow copy or assignement
+    Bounded_Queue(const Bounded_Queue&);
+    const Bounded_Queue& operator=(const Bounded_Queue&);
+};
+
+
+/* =================================================================
+ * Nothing to see beyond this point :-)
+ * =================================================================
+ */
+namespace re_queue_helpers {
+  inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#else
+    sched_yield();
+#endif
+  }
+}
+
+
+//####################################################################
+template <typename Queue_Of_T, size_t Capacity>
+Bounded_Queue<Queue_Of_T, Capacity>::Bounded_Queue(Overflow_Policy policy) :
+  enqueue_pos(0), dequeue_pos(0), push_waiters(0), pop_waiters(0), empty_waiters(0), q_dropped(0), high_water(0),
+  push_blocked_ns(0), pop_blocked_ns(0), wait_empty_ns(0), q_closed(false), q_policy(policy) {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Bounded_Queue capacity must be a power of two");
+    for (size_t i = 0; i < Capacity; ++i)
+      cells[i].sequence.store(i, std::memory_order_relaxed);
+    pthread_mutex_init(&q_mutex, 0);
+    re_queue_helpers::init_monotonic_cond(&q_push_cond);
+    pthread_cond_init(&q_pop_cond, 0);
+    pthread_cond_init(&q_empty_cond, 0);
+}
+//####################################################################
+template <typename Queue_Of_T, size_t Capacity>
+Bounded_Queue<Queue_Of_T, Capacity>::~Bounded_Queue(void) {
+    //destroy whatever is still queued
+    size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+    size_t end = enqueue_pos.load(std::memory_order_relaxed);
+    for (; pos != end; ++pos)
+      reinterpret_cast<Queue_Of_T *>(&cells[pos & (Capacity - 1)].storage)->~Queue_Of_T();
+    pthread_mutex_destroy(&q_mutex);
+    pthread_cond_destroy(&q_push_cond);
+    pthread_cond_destroy(&q_pop_cond);
+    pthread_cond_destroy(&q_empty_cond);
+}
+//####################################################################
+//the arguments are only consumed (moved from) when we return true
+template <typename Queue_Of_T, size_t Capacity>
+template <typename... Args>
+bool Bounded_Queue<Queue_Of_T, Capacity>::try_enqueue(Args&&... args) {
+  size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+  for (;;) {
+    Cell *cell = &cells[pos & (Capacity - 1)];
+    size_t seq = cell->sequence.load(std::memory_order_acquire);
+    std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+    if (diff == 0) {
+      //release, for push_position
+      if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_release, std::memory_order_relaxed)) {
+	new (&cell->storage) Queue_Of_T(std::forward<Args>(args)...);
+	cell->sequence.store(pos + 1, std::memory_order_release);
+	return(true);
+      }
+    } else if (diff < 0) {
+      //the slot still holds an object from the previous lap ==> full
+      return(false);
+    } else {
+      pos = enqueue_pos.load(std::memory_order_relaxed);
+    }
+  }
+}
+//####################################################################
+template <typename Queue_Of_T, size_t Capacity>
+bool Bounded_Queue<Queue_Of_T, Capacity>::try_dequeue(Queue_Of_T *obj_storage, size_t end_pos) {
+  size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+  for (;;) {
+    Cell *cell = &cells[pos & (Capacity - 1)];
+    size_t seq = cell->sequence.load(std::memory_order_acquire);
+    std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+    if (diff == 0) {
+      if (pos >= end_pos)
+	return(false);
+      if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+	Queue_Of_T *obj = reinterpret_cast<Queue_Of_T *>(&cell->storage);
+	new (obj_storage) Queue_Of_T(std::move(*obj));
+	obj->~Queue_Of_T();
+	cell->sequence.store(pos + Capacity, std::memory_order_release);
+	return(true);
+      }
+    } else if (diff < 0) {
+      //the slot hasn't been filled on this lap ==> empty
+      return(false);
+    } else {
+      pos = dequeue_pos.load(std::memory_order_relaxed);
+    }
+  }
+}
+//####################################################################
+template <typename Queue_Of_T, size_t Capacity>
+bool Bounded_Queue<Queue_Of_T, Capacity>::is_empty(void) const {
+  size_t pos = dequeue_pos.load(std::memory_order_acquire);
+  return(cells[pos & (Capacity - 1)].sequence.load(std::memory_order_acquire) != pos + 1);
+}
+//####################################################################
+template <typename Queue_Of_T, size_t Capacity>
+void Bounded_Queue<Queue_Of_T, Capacity>::wake(pthread_cond_t *cond, std::atomic<int> *waiters) {
+  //the fence orders our ring update before the waiter check; the parked side increments its waiter count before it
+  //re-checks the ring, so one of us is guaranteed to see the other.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (waiters->load(std::memory_order_relaxed) > 0) {
+    re_queue_helpers::lock l(q_mutex);
+    pthread_cond_broadcast(cond);
+  }
+}
+//####################################################################
+template <typename Queue_Of_T, size_t Capacity>
+size_t Bounded_Queue<Queue_Of_T, Capacity>::depth(void) const {
+  size_t head = dequeue_pos.load(std::memory_order_relaxed);
+  size_t tail = enqueue_pos.load(std::memory_order_relaxed);
+  return(tail > head ? tail - head : 0);
+}
+//####################################################################
+template <typename Queue_Of_T, size_t Capacity>
+void Bounded_Queue<Queue_Of_T, Capacity>::raise_high_water(size_t n) {
+  size_t seen = high_water.load(std::memory_order_relaxed);
+  while (n > seen && !high_water.compare_exchange_weak(seen, n, std::memory_order_relaxed))
+    ;
+}
+//####################################################################
+template <typename Queue_Of_T, size_t Capacity>
+Queue_Stats Bounded_Queue<Queue_Of_T, Capacity>::stats(void) const {
+  Queue_Stats snapshot = Queue_Stats();
+  snapshot.pops = dequeue_pos.load(std::memory_order_relaxed);
+  snapshot.pushes = enqueue_pos.load(std::memory_order_relaxed);
+  snapshot.depth = snapshot.pushes > snapshot.pops ? snapshot.pushes - snapshot.pops : 0;
+  snapshot.high_water = std::max(high_water.load(std::memory_order_relaxed), static_cast<size_t>(snapshot.depth));
+  snapshot.dropped = q_dropped.load(std::memory_order_relaxed);
+  snapshot.push_blocked_ns = push_blocked_ns.load(std::memory_order_relaxed);
+  snapshot.pop_blocked_ns = pop_blocked_ns.load(std::memory_order_relaxed);
+  snapshot.wait_empty_ns = wait_empty_ns.load(std::memory_order_relaxed);
+  return(snapshot);
+}
+//####################################################################
+template <typename Queue_Of_T, size_t Capacity>
+bool Bounded_Queue<Queue_Of_T, Capacity>::discard_oldest(void) {
+  typename std::aligned_storage<sizeof(Queue_Of_T), std::alignment_of<Queue_Of_T>::value>::type obj_storage;
+  Queue_Of_T *obj = reinterpret_cast<Queue_Of_T *>(&obj_storage);
+  if (!try_dequeue(obj))
+    return(false);
+  obj->~Queue_Of_T();
+  q_dropped.fetch_add(1, std::memory_order_relaxed);
+  return(true);
+}
+//####################################################################
+template <typename Queue_Of_T, size_t Capacity>
+bool Bounded_Queue<Queue_Of_T, Capacity>::push(const Queue_Of_T &obj) {
+  return(push_with(q_policy, obj));
+}
+//####################################################################
+template <typename Queue_Of_T, size_t Capacity>
+bool Bounded_Queue<Queue_Of_T, Capacity>::push(Queue_Of_T &&obj) {
+  return(push_with(q_policy, std::move(obj)));
+}
+//####################################################################
+template <typename Queue_Of_T, size_t Capacity>
+bool Bounded_Queue<Queue_Of_T, Capacity>::push(const Queue_Of_T &obj, Overflow_Policy policy) {
+  return(push_with(policy, obj));
+}
+//####################################################################
+template <typename Queue_Of_T, size_t Capacity>
+bool Bounded_Queue<Queue_Of_T, Capacity>::push(Queue_Of_T &&obj, Overflow_Policy policy) {
+  return(push_with(policy, std::move(obj)));
+}
+//####################################################################
+template <typename Queue_Of_T, size_t Capacity>
+bool Bounded_Queue<Queue_Of_T, Capacity>::try_push(const Queue_Of_T &obj) {
+  return(push_with(OVERFLOW_FAIL, obj));
+}
+//####################################################################
+template <typename Queue_Of_T, size_t Capacity>
+bool Bounded_Queue<Queue_Of_T, Capacity>::try_push(Queue_Of_T &&obj) {
+  return(push_with(OVERFLOW_FAIL, std::move(obj)));
+}
+//####################################################################
+template <typename Queue_Of_T, size_t Capacity>
+template <typename... Args>
+bool Bounded_Queue<Queue_Of_T, Capacity>::emplace(Args&&... args) {
+  return(push_with(q_policy, std::forward<Args>(args)...));
+}
+//####################################################################
+//try_enqueue only consumes the arguments when it succeeds, so it is safe to forward them on each retry
+template <typename Queue_Of_T, size_t Capacity>
+template <typename... Args>
+bool Bounded_Queue<Queue_Of_T, Capacity>::push_with(Overflow_Policy policy, Args&&... args) {
+  if (is_closed())
+    return(false);
+  while (!try_enqueue(std::forward<Args>(args)...)) {
+    high_water.store(Capacity, std::memory_order_relaxed);
+    if (policy == OVERFLOW_FAIL)
+      return(false);
+    if (policy == OVERFLOW_DROP_NEWEST || policy == OVERFLOW_DROP_AND_COUNT) {
+      q_dropped.fetch_add(1, std::memory_order_relaxed);
+      return(false);
+    }
+    if (policy == OVERFLOW_DROP_OLDEST) {
+      //somebody else may pop the slot before we can; either way we go round and try again
+      discard_oldest();
+      continue;
+    }
+    if (!block_until_pushed(std::forward<Args>(args)...))
+      return(false);
+    break;
+  }
+  wake(&q_push_cond, &pop_waiters);
+  return(true);
+}
+//####################################################################
+//returns false if the queue was closed before there was room
+template <typename Queue_Of_T, size_t Capacity>
+template <typename... Args>
+bool Bounded_Queue<Queue_Of_T, Capacity>::block_until_pushed(Args&&... args) {
+  unsigned long long parked = 0;
+  for (int spin = 0; !try_enqueue(std::forward<Args>(args)...); ++spin) {
+    if (spin < SPIN_COUNT) {
+      re_queue_helpers::cpu_relax();
+      continue;
+    }
+    if (parked == 0)
+      parked = re_queue_helpers::monotonic_ns();
+    push_waiters.fetch_add(1, std::memory_order_seq_cst);
+    {
+      re_queue_helpers::lock l(q_mutex);
+      //re-check with the mutex held, so that a pop (or a close) can't slip in between the check and the wait
+      if (try_enqueue(std::forward<Args>(args)...)) {
+	push_waiters.fetch_sub(1, std::memory_order_relaxed);
+	break;
+      }
+      if (is_closed()) {
+	push_waiters.fetch_sub(1, std::memory_order_relaxed);
+	push_blocked_ns.fetch_add(re_queue_helpers::monotonic_ns() - parked, std::memory_order_relaxed);
+	return(false);
+      }
+      pthread_cond_wait(&q_pop_cond, &q_mutex);
+    }
+    push_waiters.fetch_sub(1, std::memory_order_relaxed);
+    spin = 0;
+  }
+  if (parked != 0)
+    push_blocked_ns.fetch_add(re_queue_helpers::monotonic_ns() - parked, std::memory_order_relaxed);
+  return(true);
+}
+//####################################################################
+//wait (until the deadline, if there is one) for an object and move it into obj_storage
+template <typename Queue_Of_T, size_t Capacity>
+Queue_Status Bounded_Queue<Queue_Of_T, Capacity>::block_until_popped(Queue_Of_T *obj_storage, const timespec *deadline) {
+  Queue_Status status = QUEUE_OK;
+  unsigned long long parked = 0;
+  for (int spin = 0; !try_dequeue(obj_storage); ++spin) {
+    if (spin < SPIN_COUNT) {
+      re_queue_helpers::cpu_relax();
+      continue;
+    }
+    if (parked == 0)
+      parked = re_queue_helpers::monotonic_ns();
+    pop_waiters.fetch_add(1, std::memory_order_seq_cst);
+    {
+      re_queue_helpers::lock l(q_mutex);
+      //re-check with the mutex held, so that a push (or a close) can't slip in between the check and the wait
+      //QUEUE_EMPTY ==> we were woken up (or woke up spuriously); go round again
+      if (try_dequeue(obj_storage)) {
+	status = QUEUE_OK;
+      } else if (is_closed()) {
+	status = QUEUE_CLOSED;
+      } else if (deadline == 0) {
+	pthread_cond_wait(&q_push_cond, &q_mutex);
+	status = QUEUE_EMPTY;
+      } else if (pthread_cond_timedwait(&q_push_cond, &q_mutex, deadline) != ETIMEDOUT) {
+	status = QUEUE_EMPTY;
+      } else {
+	status = try_dequeue(obj_storage) ? QUEUE_OK : (is_closed() ? QUEUE_CLOSED : QUEUE_TIMEOUT);
+      }
+    }
+    pop_waiters.fetch_sub(1, std::memory_order_relaxed);
+    if (status != QUEUE_EMPTY)
+      break;
+    spin = 0;
+    status = QUEUE_OK;
+  }
+  if (parked != 0)
+    pop_blocked_ns.fetch_add(re_queue_helpers::monotonic_ns() - parked, std::memory_order_relaxed);
+  return(status);
+}
+//####################################################################
+//wake anybody waiting for room, or for the queue to empty; n objects were just taken, so there were at least depth() + n
+template <typename Queue_Of_T, size_t Capacity>
+void Bounded_Queue<Queue_Of_T, Capacity>::popped(size_t n) {
+  raise_high_water(depth() + n);
+  wake(&q_pop_cond, &push_waiters);
+  if (is_empty())
+    wake(&q_empty_cond, &empty_waiters);
+}
+//####################################################################
+template <typename Queue_Of_T, size_t Capacity>
+Queue_Of_T Bounded_Queue<Queue_Of_T, Capacity>::pop(void) {
+  typename std::aligned_storage<sizeof(Queue_Of_T), std::alignment_of<Queue_Of_T>::value>::type obj_storage;
+  Queue_Of_T *obj = reinterpret_cast<Queue_Of_T *>(&obj_storage);
+  if (block_until_popped(obj) != QUEUE_OK)
+    throw std::runtime_error("pop from closed queue");
+  popped(1);
+  Queue_Of_T ret(std::move(*obj));
+  obj->~Queue_Of_T();
+  return(ret);
+}
+//####################################################################
+template <typename Queue_Of_T, size_t Capacity>
+Queue_Status Bounded_Queue<Queue_Of_T, Capacity>::try_pop(Queue_Of_T &obj) {
+  typename std::aligned_storage<sizeof(Queue_Of_T), std::alignment_of<Queue_Of_T>::value>::type obj_storage;
+  Queue_Of_T *popped_obj = reinterpret_cast<Queue_Of_T *>(&obj_storage);
+  if (!try_dequeue(popped_obj))
+    return(is_closed() && is_empty() ? QUEUE_CLOSED : QUEUE_EMPTY);
+  popped(1);
+  obj = std::move(*popped_obj);
+  popped_obj->~Queue_Of_T();
+  return(QUEUE_OK);
+}
+//####################################################################
+template <typename Queue_Of_T, size_t Capacity>
+template <typename Rep, typename Period>
+Queue_Status Bounded_Queue<Queue_Of_T, Capacity>::pop_for(Queue_Of_T &obj, const std::chrono::duration<Rep, Period> &timeout) {
+  typename std::aligned_storage<sizeof(Queue_Of_T), std::alignment_of<Queue_Of_T>::value>::type obj_storage;
+  Queue_Of_T *popped_obj = reinterpret_cast<Queue_Of_T *>(&obj_storage);
+  timespec deadline = re_queue_helpers::deadline_after(timeout);
+  Queue_Status status = block_until_popped(popped_obj, &deadline);
+  if (status != QUEUE_OK)
+    return(status);
+  popped(1);
+  obj = std::move(*popped_obj);
+  popped_obj->~Queue_Of_T();
+  return(QUEUE_OK);
+}
+//####################################################################
+template <typename Queue_Of_T, size_t Capacity>
+template <typename Output_It>
+size_t Bounded_Queue<Queue_Of_T, Capacity>::pop_batch(Output_It out, size_t max_n) {
+  typename std::aligned_storage<sizeof(Queue_Of_T), std::alignment_of<Queue_Of_T>::value>::type obj_storage;
+  Queue_Of_T *obj = reinterpret_cast<Queue_Of_T *>(&obj_storage);
+  if (max_n == 0 || block_until_popped(obj) != QUEUE_OK)
+    return(0);
+  size_t n = 0;
+  do {
+    *out++ = std::move(*obj);
+    obj->~Queue_Of_T();
+  } while (++n < max_n && try_dequeue(obj));
+  popped(n);
+  return(n);
+}
+//####################################################################
+template <typename Queue_Of_T, size_t Capacity>
+template <typename Output_It>
+size_t Bounded_Queue<Queue_Of_T, Capacity>::try_pop_batch(Output_It out, size_t max_n) {
+  typename std::aligned_storage<sizeof(Queue_Of_T), std::alignment_of<Queue_Of_T>::value>::type obj_storage;
+  Queue_Of_T *obj = reinterpret_cast<Queue_Of_T *>(&obj_storage);
+  size_t n = 0;
+  for (; n < max_n && try_dequeue(obj); ++n) {
+    *out++ = std::move(*obj);
+    obj->~Queue_Of_T();
+  }
+  if (n != 0)
+    popped(n);
+  return(n);
+}
+//####################################################################
+template <typename Queue_Of_T, size_t Capacity>
+template <typename Output_It>
+size_t Bounded_Queue<Queue_Of_T, Capacity>::try_pop_batch_until(Output_It out, size_t end_pos) {
+  typename std::aligned_storage<sizeof(Queue_Of_T), std::alignment_of<Queue_Of_T>::value>::type obj_storage;
+  Queue_Of_T *obj = reinterpret_cast<Queue_Of_T *>(&obj_storage);
+  size_t n = 0;
+  for (; try_dequeue(obj, end_pos); ++n) {
+    *out++ = std::move(*obj);
+    obj->~Queue_Of_T();
+  }
+  if (n != 0)
+    popped(n);
+  return(n);
+}
+//####################################################################
+template <typename Queue_Of_T, size_t Capacity>
+size_t Bounded_Queue<Queue_Of_T, Capacity>::drain_into(std::vector<Queue_Of_T> &objs) {
+  size_t n = depth();
+  objs.reserve(objs.size() + (n != 0 ? n : 1));
+  return(pop_batch(std::back_inserter(objs), static_cast<size_t>(-1)));
+}
+//####################################################################
+template <typename Queue_Of_T, size_t Capacity>
+void Bounded_Queue<Queue_Of_T, Capacity>::wait_empty(void) {
+  if (is_empty())
+    return;
+  const unsigned long long start = re_queue_helpers::monotonic_ns();
+  empty_waiters.fetch_add(1, std::memory_order_seq_cst);
+  {
+    re_queue_helpers::lock l(q_mutex);
+    //loop to catch spurious wake ups
+    while (!is_empty())
+      pthread_cond_wait(&q_empty_cond, &q_mutex);
+  }
+  empty_waiters.fetch_sub(1, std::memory_order_relaxed);
+  wait_empty_ns.fetch_add(re_queue_helpers::monotonic_ns() - start, std::memory_order_relaxed);
+}
+//####################################################################
+template <typename Queue_Of_T, size_t Capacity>
+void Bounded_Queue<Queue_Of_T, Capacity>::close(void) {
+  q_closed.store(true, std::memory_order_seq_cst);
+  //waiters check q_closed with the mutex held, so taking it here means none of them can miss the broadcast
+  re_queue_helpers::lock l(q_mutex);
+  pthread_cond_broadcast(&q_push_cond);
+  pthread_cond_broadcast(&q_pop_cond);
+}
+}//re_gen
+#endif //_BOUNDED_QUEUE_H_
@@ -0,0 +1,179 @@
+//* crash ring
+/*
+ * @remarks a circular log in a memory-mapped file, which outlives the process that writes it (see crash_ring.h)
+ */
+#include <cerrno>
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "gen/gendefs.h"
+#include "gen/crash_ring.h"
+
+namespace {
+  const char CRASH_RING_MAGIC[8] = {'R', 'G', 'R', 'I', 'N', 'G', '0', '1'};
+  const uint32_t COMMIT_MAGIC = 0xc0117e7dU;
+
+  static_assert(sizeof(re_gen::Crash_Ring::Rec_Header) == re_gen::Crash_Ring::REC_ALIGN, "record header must be one alignment unit");
+  static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2, "the crash ring needs lock-free atomics in shared memory");
+
+  uint32_t commit_word(uint64_t pos) {
+    return(COMMIT_MAGIC ^ static_cast<uint32_t>(pos) ^ static_cast<uint32_t>(pos >> 32));
+  }
+  uint64_t rec_size(size_t len) {
+    return((sizeof(re_gen::Crash_Ring::Rec_Header) + len + re_gen::Crash_Ring::REC_ALIGN - 1) &
+           ~static_cast<uint64_t>(re_gen::Crash_Ring::REC_ALIGN - 1));
+  }
+  //copy into / out of the ring, wrapping at the end
+  void copy_in(char *ring, uint64_t capacity, uint64_t pos, const char *data, size_t len) {
+    size_t offset = pos % capacity;
+    size_t first = std::min(static_cast<size_t>(capacity - offset), len);
+    memcpy(ring + offset, data, first);
+    memcpy(ring, data + first, len - first);
+  }
+  void copy_out(const char *ring, uint64_t capacity, uint64_t pos, char *data, size_t len) {
+    size_t offset = pos % capacity;
+    size_t first = std::min(static_cast<size_t>(capacity - offset), len);
+    memcpy(data, ring + offset, first);
+    memcpy(data + first, ring, len - first);
+  }
+};//anonymous namespace
+
+
+//* re_gen namespace
+/**
+ * @brief this namespace is for items that are of general interest.
+ */
+namespace re_gen {
+
+//* Crash_Ring::Crash_Ring
+/*
+ * @param capacity - the size of the ring, in bytes; rounded up to a multiple of 4k.
+ * @throw Gen_Err if the file can't be created or mapped.
+ */
+Crash_Ring::Crash_Ring(const std::string &file_name, size_t capacity) :
+  ring_capacity((capacity + HEADER_SIZE - 1) & ~static_cast<size_t>(HEADER_SIZE - 1)), fd(-1), map(0), header(0), ring(0) {
+  if (ring_capacity == 0)
+    ring_capacity = HEADER_SIZE;
+  fd = ::open(file_name.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0)
+    throw Gen_Err("Crash_Ring::Crash_Ring - can't open " + file_name + ": " + strerror(errno));
+  struct stat st;
+  const off_t file_size = HEADER_SIZE + ring_capacity;
+  bool reuse = fstat(fd, &st) == 0 && st.st_size == file_size;
+  if (!reuse && ftruncate(fd, file_size) != 0) {
+    ::close(fd);
+    throw Gen_Err("Crash_Ring::Crash_Ring - can't size " + file_name + ": " + strerror(errno));
+  }
+  void *mem = mmap(0, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (mem == MAP_FAILED) {
+    ::close(fd);
+    throw Gen_Err("Crash_Ring::Crash_Ring - can't map " + file_name + ": " + strerror(errno));
+  }
+  map = static_cast<char *>(mem);
+  header = reinterpret_cast<Header *>(map);
+  ring = map + HEADER_SIZE;
+  if (!reuse || memcmp(header->magic, CRASH_RING_MAGIC, sizeof(CRASH_RING_MAGIC)) != 0 || header->capacity != ring_capacity) {
+    memset(map, 0, file_size);
+    header->capacity = ring_capacity;
+    header->head.store(0, std::memory_order_relaxed);
+    //the magic number goes in last, so a half-initialized file isn't mistaken for a ring
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(header->magic, CRASH_RING_MAGIC, sizeof(CRASH_RING_MAGIC));
+  }
+}
+
+Crash_Ring::~Crash_Ring(void) {
+  munmap(map, HEADER_SIZE + ring_capacity);
+  ::close(fd);
+}
+
+//* Crash_Ring::append
+/*
+ * @brief copy a record into the ring
+ * @return false if the record is too big for the ring (more than a quarter of it).
+ */
+bool Crash_Ring::append(const char *data, size_t len) {
+  const uint64_t size = rec_size(len);
+  if (size > ring_capacity / 4)
+    return(false);
+  const uint64_t pos = header->head.fetch_add(size, std::memory_order_relaxed);
+  Rec_Header *rec = reinterpret_cast<Rec_Header *>(ring + pos % ring_capacity);
+  //invalidate whatever record used to be here before we touch the rest of it
+  rec->commit.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  rec->pos = pos;
+  rec->len = static_cast<uint32_t>(len);
+  copy_in(ring, ring_capacity, pos + sizeof(Rec_Header), data, len);
+  rec->commit.store(commit_word(pos), std::memory_order_release);
+  return(true);
+}
+
+//* Crash_Ring::read_records
+/*
+ * @brief read the committed records in a ring file, oldest first
+ * @param n_skipped - set to the number of places where the scan found no committed record, and had to skip ahead to the next
+ * one: a record that was still being written, one that was partly overwritten (the oldest in a ring that has wrapped usually is),
+ * or two that a lapping writer garbled.
+ * @return false (with an explanation in err) if the file isn't a ring.
+ * @remarks this is meant for reading the file after the process that wrote it has died; if it is still running, records that are
+ * overwritten while we read them may be garbled.
+ */
+bool Crash_Ring::read_records(const std::string &file_name, std::vector<std::string> *const records, size_t *const n_skipped,
+                              std::string *const err) {
+  *n_skipped = 0;
+  int fd = ::open(file_name.c_str(), O_RDONLY);
+  if (fd < 0) {
+    *err = "can't open " + file_name + ": " + strerror(errno);
+    return(false);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < HEADER_SIZE) {
+    ::close(fd);
+    *err = file_name + " is not a crash ring";
+    return(false);
+  }
+  void *mem = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (mem == MAP_FAILED) {
+    *err = "can't map " + file_name + ": " + strerror(errno);
+    return(false);
+  }
+  const char *map = static_cast<const char *>(mem);
+  const Header *header = reinterpret_cast<const Header *>(map);
+  const uint64_t capacity = header->capacity;
+  if (memcmp(header->magic, CRASH_RING_MAGIC, sizeof(CRASH_RING_MAGIC)) != 0 || capacity == 0 || capacity % REC_ALIGN != 0 ||
+      static_cast<uint64_t>(st.st_size) != HEADER_SIZE + capacity) {
+    munmap(mem, st.st_size);
+    *err = file_name + " is not a crash ring";
+    return(false);
+  }
+  const char *ring = map + HEADER_SIZE;
+  const uint64_t head = header->head.load(std::memory_order_acquire);
+  //only the last lap of the ring can still be intact
+  uint64_t pos = head > capacity ? head - capacity : 0;
+  pos = (pos + REC_ALIGN - 1) & ~static_cast<uint64_t>(REC_ALIGN - 1);
+  bool skipping = false;
+  while (pos + sizeof(Rec_Header) <= head) {
+    const Rec_Header *rec = reinterpret_cast<const Rec_Header *>(ring + pos % capacity);
+    const uint64_t size = rec_size(rec->len);
+    if (rec->commit.load(std::memory_order_acquire) != commit_word(pos) || rec->pos != pos || size > capacity / 4 ||
+        pos + size > head) {
+      //not a committed record; resynchronize at the next boundary
+      if (!skipping)
+        ++*n_skipped;
+      skipping = true;
+      pos += REC_ALIGN;
+      continue;
+    }
+    skipping = false;
+    records->push_back(std::string(rec->len, '\0'));
+    copy_out(ring, capacity, pos + sizeof(Rec_Header), &records->back()[0], rec->len);
+    pos += size;
+  }
+  munmap(mem, st.st_size);
+  return(true);
+}
+};//namespace re_gen
@@ -0,0 +1,70 @@
+//* crash_ring.h - header file for the Crash_Ring class
+/*
+ * @brief this header file defines the Crash_Ring class, a circular log in a memory-mapped file, which outlives the process that
+ * writes it.
+ */
+#ifndef __IF_CRASH_RING__
+#define __IF_CRASH_RING__
+#include <string>
+#include <vector>
+#include <atomic>
+#include <stdint.h>
+#include <gen/gendefs.h>
+
+//* re_gen namespace
+/**
+ * @brief this namespace is for items that are of general interest.
+ */
+namespace re_gen {
+
+//* Crash_Ring class
+/*
+ * @brief a fixed-size circular buffer of records, in a file that is mapped into memory
+ *
+ * @remarks any number of threads can append records at once, without a lock and without a system call: a thread claims space with a
+ * fetch-add on the ring's head, copies its record in, and then commits it. the pages are shared with the kernel's page cache, so
+ * if the process dies - even by SIGKILL - the records that were committed are still in the file. (a power failure is another
+ * matter: nothing is synced to disk.)
+ *
+ * @note the file is laid out as a 4k header page, then the ring. each record starts on a 16 byte boundary, with a 16 byte header
+ * of its absolute position, its length, and a commit word (derived from the position) which is stored last. read_records finds
+ * the records by scanning the last lap of the ring for headers whose position matches and that are committed; so records that
+ * were being written when the process died, or that have been partly overwritten, are skipped (and counted).
+ * @note under heavy load a writer can lap a slow one, and the two then write over each other's record; neither record commits
+ * with a matching header, so the reader skips both. the ring is best effort: size it so that a lap takes much longer than a write.
+ *
+ * @note if the file already holds a ring of the same size it is appended to, so that a restart doesn't destroy the record of a
+ * crash; otherwise it is initialized.
+ */
+class Crash_Ring {
+ public:
+  Crash_Ring(const std::string &file_name, size_t capacity);
+  ~Crash_Ring(void);
+  bool append(const char *data, size_t len);
+  size_t capacity(void) const { return(ring_capacity); }
+  static bool read_records(const std::string &file_name, std::vector<std::string> *const records, size_t *const n_skipped,
+                           std::string *const err);
+
+  struct Header {
+    char magic[8];
+    uint64_t capacity;
+    std::atomic<uint64_t> head;  //bytes claimed since the ring was initialized
+  };
+  struct Rec_Header {
+    uint64_t pos;                //absolute position of the record
+    uint32_t len;                //payload length
+    std::atomic<uint32_t> commit;
+  };
+  enum { HEADER_SIZE = 4096, REC_ALIGN = 16 };
+
+ private:
+  size_t ring_capacity;
+  int fd;
+  char *map;
+  Header *header;
+  char *ring;
+  Crash_Ring(const Crash_Ring &);
+  Crash_Ring& operator=(const Crash_Ring &);
+};//class Crash_Ring
+};//namespace re_gen
+#endif //__IF_CRASH_RING__
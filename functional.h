@@ -5,12 +5,52 @@
 #ifndef __IF_FUNCTIONAL__
 #define __IF_FUNCTIONAL__
 #include <functional>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <gen/type_tag.h>
 
 /*
  * @brief this namespace is for items that are of general interest.
  */
 namespace re_gen {
 
+namespace re_functional_helpers {
+  //runs the overloads of cast_if, and the pipelines, that take an execution policy; it's specialized for each policy - the
+  //pipelines' Sequential below, and Parallel in functional_parallel.h
+  template <typename Policy>
+  struct Policy_Runner;
+
+  //the loops behind copy_if and split_if; specialized for the predicates that can be run faster - the compare predicates, in
+  //functional_simd.h
+  template <typename Condition>
+  struct Filter {
+    template <typename In_T, typename Out_T>
+    static Out_T copy_if(In_T in, In_T in_end, Out_T out, Condition &condition) {
+      while (in != in_end) {
+	if (condition(*in))
+	  *out++ = *in;
+	++in;
+      }
+      return(out);
+    }
+    template <typename In_T, typename Out_T1, typename Out_T2>
+    static Out_T1 split_if(In_T in, In_T in_end, Out_T1 out1, Out_T2 out2, Condition &condition) {
+      while (in != in_end) {
+	if (condition(*in))
+	  *out1++ = *in;
+	else
+	  *out2++ = *in;
+	++in;
+      }
+      return(out1);
+    }
+  };
+}
+
 //* copy_if function
 /*
  * @brief copy_if function
@@ -31,17 +71,14 @@ namespace re_gen {
  * @note the predicate is a function or object with a suitable override pf the ()
  * operator. the function (or overridden () operator) must take a single source container
  * element parameter and return a bool.
+ * @note there's a parallel overload, which takes a Parallel policy first; see functional_parallel.h. with a compare
+ * predicate, it's vectorized; see functional_simd.h.
  * @note this function really ought to be part of the stl. i figured at least we'd
  * implement it in our own general library.
  */
 template <typename In_T, typename Out_T, typename Condition>
   Out_T copy_if(In_T in, In_T in_end, Out_T out, Condition condition) {
-  while (in != in_end) {
-    if (condition(*in))
-      *out++ = *in;
-    ++in;
-  }
-  return(out);
+  return(re_functional_helpers::Filter<Condition>::copy_if(in, in_end, out, condition));
 }
 
 //* cast function
@@ -55,6 +92,7 @@ template <typename In_T, typename Out_T, typename Condition>
  * @returns iterator one past last element copied in destination container.
  * @remarks this function copies container elements from one container to another,
  * performing a dynamic cast during the copy.
+ * @note the cast is a tag_cast (see type_tag.h): a static_cast for an upcast, and an is_a check for a class with a type tag.
  * @example:
  *  class a { ... };
  *  class b : a { ... };
@@ -70,7 +108,7 @@ public:
   template <typename In_T, typename Out_T>
   Out_T operator()(In_T in, In_T in_end, Out_T out) {
     while (in != in_end) {
-      *out++ = dynamic_cast<Cast_T>(*in);
+      *out++ = tag_cast<Cast_T>(*in);
       ++in;
     }
     return(out);
@@ -99,6 +137,8 @@ public:
  * @note the predicate is a function or object with a suitable override pf the ()
  * operator. the function (or overridden () operator) must take a single source container
  * element parameter and return a bool.
+ * @note there's a parallel overload, which takes a Parallel policy first; see functional_parallel.h.
+ * @note the cast is a tag_cast, as for cast.
  * @see cast, copy_if
  */
 template <typename Cast_T>
@@ -110,11 +150,16 @@ public:
   Out_T operator()(In_T in, In_T in_end, Out_T out, Condition condition) {
     while (in != in_end) {
       if (condition(*in))
-	*out++ = dynamic_cast<Cast_T>(*in);
+	*out++ = tag_cast<Cast_T>(*in);
       ++in;
     }
     return(out);
   }
+  //with an execution policy first - see functional_parallel.h
+  template <typename Policy, typename In_T, typename Out_T, typename Condition>
+  Out_T operator()(const Policy &policy, In_T in, In_T in_end, Out_T out, Condition condition) {
+    return(re_functional_helpers::Policy_Runner<Policy>::template cast_if<Cast_T>(&policy, in, in_end, out, condition));
+  }
 };
 
 //* split_if function
@@ -140,18 +185,266 @@ public:
  * @note the predicate is a function or object with a suitable override pf the ()
  * operator. the function (or overridden () operator) must take a single source container
  * element parameter and return a bool.
+ * @note there's a parallel overload, which takes a Parallel policy first; see functional_parallel.h. with a compare
+ * predicate, it's vectorized; see functional_simd.h.
  * @see copy_if
  */
 template <typename In_T, typename Out_T1, typename Out_T2, typename Condition>
   Out_T1 split_if(In_T in, In_T in_end, Out_T1 out1, Out_T2 out2, Condition condition) {
-  while (in != in_end) {
-    if (condition(*in))
-      *out1++ = *in;
+  return(re_functional_helpers::Filter<Condition>::split_if(in, in_end, out1, out2, condition));
+}
+
+/* =================================================================
+ * pipelines: copy_if, cast and split_if fused into one pass, with no containers in between. a pipeline is a source (from), any
+ * number of stages (filter, cast), and a terminal (copy_to, split_to), joined with |. nothing is done until the terminal is
+ * joined on; then each element of the source is taken through every stage in turn, and on to the terminal's output(s) - so it's
+ * read once, while it's in cache, and nothing but the outputs is written.
+ * @example:
+ *  class a { ... };
+ *  class b : a { ... };
+ *  vector<a *> va;
+ *  vector<b *> vb, vc;
+ *  from(va) | filter(predicate<a *>) | cast<b *>() | split_to(back_inserter(vb), back_inserter(vc), predicate<b *>);
+ * @note from(policy, ...) (see functional_parallel.h) runs the pipeline in chunks on a Thread_Pool, as the parallel copy_if
+ * does: each chunk is taken through the stages once to count what reaches each output, and again to write it there. so the
+ * source must be random access, the outputs must be random access and have room for every element that might reach them, and
+ * the stages and the split_to condition are called twice per element (from several threads at once). the outputs are in the
+ * same order as sequentially. the pipeline holds on to the policy, so don't keep a pipeline made from a temporary Parallel
+ * beyond the statement.
+ * =================================================================
+ */
+namespace re_functional_helpers {
+  //the empty chain of stages: pass everything on
+  struct No_Stage {
+    template <typename X, typename Sink>
+    void push(const X &x, Sink &sink) const {
+      sink(x);
+    }
+  };
+
+  //stage a, then stage b
+  template <typename A, typename B>
+  struct Then {
+    A first;
+    B second;
+    template <typename Sink>
+    struct Into {
+      const B *stage;
+      Sink *sink;
+      template <typename Y>
+      void operator()(const Y &y) const {
+	stage->push(y, *sink);
+      }
+    };
+    Then(const A &_first, const B &_second) : first(_first), second(_second) {
+    }
+    template <typename X, typename Sink>
+    void push(const X &x, Sink &sink) const {
+      Into<Sink> into = {&second, &sink};
+      first.push(x, into);
+    }
+  };
+
+  template <typename Condition>
+  struct Filter_Stage {
+    mutable Condition condition;
+    explicit Filter_Stage(Condition _condition) : condition(_condition) {
+    }
+    template <typename X, typename Sink>
+    void push(const X &x, Sink &sink) const {
+      if (condition(x))
+	sink(x);
+    }
+  };
+
+  template <typename Cast_T>
+  struct Cast_Stage {
+    template <typename X, typename Sink>
+    void push(const X &x, Sink &sink) const {
+      sink(re_gen::tag_cast<Cast_T>(x));
+    }
+  };
+
+  //the policy of a pipeline that isn't run in parallel
+  struct Sequential {
+  };
+
+  //counts the elements that reach each of a terminal's outputs
+  template <typename Terminal>
+  struct Count_Sink {
+    Terminal *terminal;
+    size_t *counts;
+    template <typename Y>
+    void operator()(const Y &y) const {
+      ++counts[terminal->output(y)];
+    }
+  };
+
+  template <>
+  struct Policy_Runner<Sequential> {
+    template <typename In_T, typename Chain, typename Terminal>
+    static typename Terminal::Result run(const Sequential *, In_T in, In_T in_end, const Chain &chain, Terminal terminal) {
+      for (In_T x = in; x != in_end; ++x)
+	chain.push(*x, terminal);
+      return(terminal.result());
+    }
+  };
+}
+
+//* Pipeline class
+/*
+ * @brief a source, and the chain of stages that its elements go through; made by from, and extended with | (see above)
+ * @remarks Policy is re_functional_helpers::Sequential (for which policy is 0 - only its type matters), or Parallel (see
+ * functional_parallel.h).
+ */
+template <typename In_T, typename Chain, typename Policy>
+class Pipeline {
+public:
+  Pipeline(In_T _in, In_T _in_end, const Chain &_chain, const Policy *_policy) :
+    in(_in), in_end(_in_end), chain(_chain), policy(_policy) {
+  }
+  template <typename Stage>
+  Pipeline<In_T, re_functional_helpers::Then<Chain, Stage>, Policy> then(const Stage &stage) const {
+    return(Pipeline<In_T, re_functional_helpers::Then<Chain, Stage>, Policy>(in, in_end, re_functional_helpers::Then<Chain, Stage>(chain, stage),
+									      policy));
+  }
+  //take every element through the chain, to the terminal; returns the terminal's result (the end of its output(s))
+  template <typename Terminal>
+  typename Terminal::Result run(Terminal terminal) const {
+    return(re_functional_helpers::Policy_Runner<Policy>::run(policy, in, in_end, chain, terminal));
+  }
+private:
+  In_T in;
+  In_T in_end;
+  Chain chain;
+  const Policy *policy;
+};
+
+//* from function
+/*
+ * @brief the source of a pipeline: a container, or a range (there are overloads that take a Parallel policy first too - see
+ * functional_parallel.h)
+ */
+template <typename Container>
+  Pipeline<typename Container::const_iterator, re_functional_helpers::No_Stage, re_functional_helpers::Sequential>
+  from(const Container &container) {
+  return(Pipeline<typename Container::const_iterator, re_functional_helpers::No_Stage, re_functional_helpers::Sequential>(
+	   container.begin(), container.end(), re_functional_helpers::No_Stage(), 0));
+}
+
+template <typename In_T>
+  Pipeline<In_T, re_functional_helpers::No_Stage, re_functional_helpers::Sequential> from(In_T in, In_T in_end) {
+  return(Pipeline<In_T, re_functional_helpers::No_Stage, re_functional_helpers::Sequential>(in, in_end, re_functional_helpers::No_Stage(),
+											     0));
+}
+
+//* filter function
+/*
+ * @brief a pipeline stage that passes on only the elements for which the predicate returns true (as copy_if copies them)
+ */
+template <typename Condition>
+  re_functional_helpers::Filter_Stage<Condition> filter(Condition condition) {
+  return(re_functional_helpers::Filter_Stage<Condition>(condition));
+}
+
+template <typename In_T, typename Chain, typename Policy, typename Condition>
+  Pipeline<In_T, re_functional_helpers::Then<Chain, re_functional_helpers::Filter_Stage<Condition> >, Policy>
+  operator|(const Pipeline<In_T, Chain, Policy> &pipeline, const re_functional_helpers::Filter_Stage<Condition> &stage) {
+  return(pipeline.then(stage));
+}
+
+//a cast (see above) as a pipeline stage: each element is passed on tag_cast to Cast_T - a failed cast passes on 0
+template <typename In_T, typename Chain, typename Policy, typename Cast_T>
+  Pipeline<In_T, re_functional_helpers::Then<Chain, re_functional_helpers::Cast_Stage<Cast_T> >, Policy>
+  operator|(const Pipeline<In_T, Chain, Policy> &pipeline, const cast<Cast_T> &) {
+  return(pipeline.then(re_functional_helpers::Cast_Stage<Cast_T>()));
+}
+
+//* copy_to function
+/*
+ * @brief a pipeline terminal that copies the elements that reach it to out
+ * @returns (from the pipeline) iterator one past the last element copied.
+ */
+template <typename Out_T>
+class copy_to_terminal {
+public:
+  typedef Out_T Result;
+  enum { OUTPUTS = 1 };
+  explicit copy_to_terminal(Out_T _out) : out(_out) {
+  }
+  template <typename Y>
+  void operator()(const Y &y) {
+    *out++ = y;
+  }
+  template <typename Y>
+  size_t output(const Y &) const {
+    return(0);
+  }
+  copy_to_terminal at(const size_t *offsets) const {
+    return(copy_to_terminal(out + offsets[0]));
+  }
+  Result result(void) const {
+    return(out);
+  }
+private:
+  Out_T out;
+};
+
+template <typename Out_T>
+  copy_to_terminal<Out_T> copy_to(Out_T out) {
+  return(copy_to_terminal<Out_T>(out));
+}
+
+//* split_to function
+/*
+ * @brief a pipeline terminal that copies the elements that reach it for which the predicate returns true to out1, and the rest
+ * to out2 (as split_if does)
+ * @returns (from the pipeline) a pair of iterators, one past the last element copied to out1 and to out2.
+ */
+template <typename Out_T1, typename Out_T2, typename Condition>
+class split_to_terminal {
+public:
+  typedef std::pair<Out_T1, Out_T2> Result;
+  enum { OUTPUTS = 2 };
+  split_to_terminal(Out_T1 _out1, Out_T2 _out2, Condition _condition) : out1(_out1), out2(_out2), condition(_condition) {
+  }
+  template <typename Y>
+  void operator()(const Y &y) {
+    if (condition(y))
+      *out1++ = y;
     else
-      *out2++ = *in;
-    ++in;
+      *out2++ = y;
   }
-  return(out1);
+  template <typename Y>
+  size_t output(const Y &y) {
+    return(condition(y) ? 0 : 1);
+  }
+  split_to_terminal at(const size_t *offsets) const {
+    return(split_to_terminal(out1 + offsets[0], out2 + offsets[1], condition));
+  }
+  Result result(void) const {
+    return(Result(out1, out2));
+  }
+private:
+  Out_T1 out1;
+  Out_T2 out2;
+  Condition condition;
+};
+
+template <typename Out_T1, typename Out_T2, typename Condition>
+  split_to_terminal<Out_T1, Out_T2, Condition> split_to(Out_T1 out1, Out_T2 out2, Condition condition) {
+  return(split_to_terminal<Out_T1, Out_T2, Condition>(out1, out2, condition));
+}
+
+template <typename In_T, typename Chain, typename Policy, typename Out_T>
+  Out_T operator|(const Pipeline<In_T, Chain, Policy> &pipeline, const copy_to_terminal<Out_T> &terminal) {
+  return(pipeline.run(terminal));
+}
+
+template <typename In_T, typename Chain, typename Policy, typename Out_T1, typename Out_T2, typename Condition>
+  std::pair<Out_T1, Out_T2> operator|(const Pipeline<In_T, Chain, Policy> &pipeline,
+				      const split_to_terminal<Out_T1, Out_T2, Condition> &terminal) {
+  return(pipeline.run(terminal));
 }
 };//namespace re_gen
 #endif //__IF_FUNCTIONAL__
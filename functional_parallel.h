@@ -0,0 +1,194 @@
+//* functional_parallel.h - parallel versions of the functional.h functions header file.
+/*
+ * @brief header file for the Parallel execution policy, and the overloads of copy_if, cast_if, split_if and from (see
+ * functional.h) that take it - which run in chunks on a Thread_Pool.
+ * @remarks these are kept apart from functional.h so that code which only wants the sequential functions doesn't pull in
+ * thread_pool.h (and pthreads).
+ */
+#ifndef __IF_FUNCTIONAL_PARALLEL__
+#define __IF_FUNCTIONAL_PARALLEL__
+#include <vector>
+#include <algorithm>
+#include <gen/functional.h>
+#include <gen/thread_pool.h>
+
+/*
+ * @brief this namespace is for items that are of general interest.
+ */
+namespace re_gen {
+
+//* Parallel class
+/*
+ * @brief execution policy for the parallel overloads of copy_if, cast_if and split_if
+ * @remarks pass a Thread_Pool to run on it; or a thread count, to run on Thread_Pool::shared(n_threads) - a pool of that many
+ * threads that is made on first use and kept, so a call doesn't start any threads after the first.
+ * @param grain - elements per chunk; 0 => about four chunks per thread (counting the caller), but no fewer than MIN_GRAIN
+ * elements in a chunk. a range that makes just one chunk is done sequentially, on the calling thread.
+ * @example:
+ *  Thread_Pool pool;
+ *  vector<a> va, vb(va.size());
+ *  vb.erase(copy_if(Parallel(pool), va.begin(), va.end(), vb.begin(), predicate<a>), vb.end());
+ */
+class Parallel {
+public:
+  enum { MIN_GRAIN = 4096 };
+  explicit Parallel(Thread_Pool &_pool, size_t _grain = 0) : pool(&_pool), grain(_grain) {
+  }
+  explicit Parallel(size_t n_threads, size_t _grain = 0) : pool(&Thread_Pool::shared(n_threads)), grain(_grain) {
+  }
+  Thread_Pool &thread_pool(void) const { return(*pool); }
+  //the number of elements in each of the chunks that n elements are split into
+  size_t chunk_size(size_t n) const {
+    if (grain != 0)
+      return(std::max(grain, static_cast<size_t>(1)));
+    return(std::max(n / ((pool->size() + 1) * 4) + 1, static_cast<size_t>(MIN_GRAIN)));
+  }
+private:
+  Thread_Pool *pool;
+  size_t grain;
+  Parallel(const Parallel &);
+  Parallel& operator=(const Parallel &);
+};
+
+/* =================================================================
+ * the parallel overloads all work the same way: split the input into chunks, count the elements of each chunk that satisfy
+ * the condition (in parallel), turn the counts into each chunk's offset in the output (a prefix sum), then copy each chunk
+ * to its offset (in parallel). so the output is in the same order as the sequential version's, and it's written in place -
+ * but the condition is evaluated twice per element, so it must give the same answer both times (and be safe to call from
+ * several threads at once).
+ * =================================================================
+ */
+namespace re_functional_helpers {
+  //offsets[c] = the number of elements in chunks [0, c) that satisfy the condition; offsets has n_chunks + 1 entries
+  template <typename In_T, typename Condition>
+  void count_chunks(const re_gen::Parallel &policy, In_T in, size_t n, size_t chunk, std::vector<size_t> *const offsets,
+		    Condition &condition) {
+    const size_t n_chunks = (n + chunk - 1) / chunk;
+    offsets->assign(n_chunks + 1, 0);
+    std::vector<size_t> &counts = *offsets;
+    policy.thread_pool().parallel_for(0, n_chunks, [&, in](size_t c) {
+	In_T first = in + c * chunk, last = in + std::min((c + 1) * chunk, n);
+	size_t count = 0;
+	for (; first != last; ++first) {
+	  if (condition(*first))
+	    ++count;
+	}
+	counts[c + 1] = count;
+      }, 1);
+    for (size_t c = 1; c <= n_chunks; ++c)
+      counts[c] += counts[c - 1];
+  }
+
+  template <>
+  struct Policy_Runner<re_gen::Parallel> {
+    //cast_if - as for copy_if
+    template <typename Cast_T, typename In_T, typename Out_T, typename Condition>
+    static Out_T cast_if(const re_gen::Parallel *policy, In_T in, In_T in_end, Out_T out, Condition condition) {
+      const size_t n = in_end - in, chunk = policy->chunk_size(n);
+      if (n <= chunk)
+	return(re_gen::cast_if<Cast_T>()(in, in_end, out, condition));
+      std::vector<size_t> offsets;
+      count_chunks(*policy, in, n, chunk, &offsets, condition);
+      policy->thread_pool().parallel_for(0, offsets.size() - 1, [&, in, out](size_t c) {
+	  re_gen::cast_if<Cast_T>()(in + c * chunk, in + std::min((c + 1) * chunk, n), out + offsets[c], condition);
+	}, 1);
+      return(out + offsets.back());
+    }
+
+    //a pipeline - as copy_if's parallel overload: count what each chunk sends to each output, sum the counts into offsets,
+    //and then run each chunk again to write to them
+    template <typename In_T, typename Chain, typename Terminal>
+    static typename Terminal::Result run(const re_gen::Parallel *policy, In_T in, In_T in_end, const Chain &chain,
+					 Terminal terminal) {
+      const size_t n = in_end - in, chunk = policy->chunk_size(n);
+      if (n <= chunk)
+	return(Policy_Runner<Sequential>::run(0, in, in_end, chain, terminal));
+      //counts[(c + 1) * k + o] = the elements of chunk c that reach output o - and then, once summed, of chunks [0, c]
+      const size_t n_chunks = (n + chunk - 1) / chunk, k = Terminal::OUTPUTS;
+      std::vector<size_t> counts((n_chunks + 1) * k, 0);
+      policy->thread_pool().parallel_for(0, n_chunks, [&](size_t c) {
+	  Count_Sink<Terminal> sink = {&terminal, &counts[(c + 1) * k]};
+	  for (In_T x = in + c * chunk, last = in + std::min((c + 1) * chunk, n); x != last; ++x)
+	    chain.push(*x, sink);
+	}, 1);
+      for (size_t i = k; i < counts.size(); ++i)
+	counts[i] += counts[i - k];
+      policy->thread_pool().parallel_for(0, n_chunks, [&](size_t c) {
+	  Terminal part = terminal.at(&counts[c * k]);
+	  for (In_T x = in + c * chunk, last = in + std::min((c + 1) * chunk, n); x != last; ++x)
+	    chain.push(*x, part);
+	}, 1);
+      return(terminal.at(&counts[n_chunks * k]).result());
+    }
+  };
+}
+
+//* copy_if function - parallel
+/*
+ * @brief copy_if, run in chunks on a Thread_Pool
+ * @param policy - the pool, or thread count, to run on (see Parallel).
+ * @remarks the input and output iterators must be random access, and the output must have room for every element that might
+ * be copied (ie. in_end - in); copy_if returns one past the last element copied, so the output can then be trimmed. the
+ * elements are copied in the same order as by the sequential copy_if.
+ * @example:
+ *  vector<a> va, vb(va.size());
+ *  vb.erase(copy_if(Parallel(8), va.begin(), va.end(), vb.begin(), predicate<a>), vb.end());
+ */
+template <typename In_T, typename Out_T, typename Condition>
+  Out_T copy_if(const Parallel &policy, In_T in, In_T in_end, Out_T out, Condition condition) {
+  const size_t n = in_end - in, chunk = policy.chunk_size(n);
+  if (n <= chunk)
+    return(re_gen::copy_if(in, in_end, out, condition));
+  std::vector<size_t> offsets;
+  re_functional_helpers::count_chunks(policy, in, n, chunk, &offsets, condition);
+  policy.thread_pool().parallel_for(0, offsets.size() - 1, [&, in, out](size_t c) {
+      re_gen::copy_if(in + c * chunk, in + std::min((c + 1) * chunk, n), out + offsets[c], condition);
+    }, 1);
+  return(out + offsets.back());
+}
+
+//* split_if function - parallel
+/*
+ * @brief split_if, run in chunks on a Thread_Pool, as copy_if is
+ * @remarks both outputs must have room for every element, and the second output's end is returned through out2_end (if it
+ * isn't 0).
+ */
+template <typename In_T, typename Out_T1, typename Out_T2, typename Condition>
+  Out_T1 split_if(const Parallel &policy, In_T in, In_T in_end, Out_T1 out1, Out_T2 out2, Condition condition,
+		  Out_T2 *const out2_end = 0) {
+  const size_t n = in_end - in, chunk = policy.chunk_size(n);
+  if (n <= chunk) {
+    Out_T1 out1_end = re_gen::split_if(in, in_end, out1, out2, condition);
+    if (out2_end != 0)
+      *out2_end = out2 + (n - (out1_end - out1));
+    return(out1_end);
+  }
+  std::vector<size_t> offsets;
+  re_functional_helpers::count_chunks(policy, in, n, chunk, &offsets, condition);
+  //chunk c's elements that fail the condition go after those of the chunks before it: c * chunk of them, less the ones that passed
+  policy.thread_pool().parallel_for(0, offsets.size() - 1, [&, in, out1, out2](size_t c) {
+      re_gen::split_if(in + c * chunk, in + std::min((c + 1) * chunk, n), out1 + offsets[c], out2 + (c * chunk - offsets[c]), condition);
+    }, 1);
+  if (out2_end != 0)
+    *out2_end = out2 + (n - offsets.back());
+  return(out1 + offsets.back());
+}
+
+//* from function - parallel
+/*
+ * @brief the source of a pipeline that's run in chunks on a Thread_Pool (see the pipelines note in functional.h)
+ * @remarks the pipeline holds on to the policy, so don't keep a pipeline made from a temporary Parallel beyond the statement.
+ */
+template <typename Container>
+  Pipeline<typename Container::const_iterator, re_functional_helpers::No_Stage, Parallel>
+  from(const Parallel &policy, const Container &container) {
+  return(Pipeline<typename Container::const_iterator, re_functional_helpers::No_Stage, Parallel>(container.begin(), container.end(),
+												 re_functional_helpers::No_Stage(), &policy));
+}
+
+template <typename In_T>
+  Pipeline<In_T, re_functional_helpers::No_Stage, Parallel> from(const Parallel &policy, In_T in, In_T in_end) {
+  return(Pipeline<In_T, re_functional_helpers::No_Stage, Parallel>(in, in_end, re_functional_helpers::No_Stage(), &policy));
+}
+};//namespace re_gen
+#endif //__IF_FUNCTIONAL_PARALLEL__
@@ -0,0 +1,139 @@
+//* functional_simd.h - vectorized copy_if and split_if header file.
+/*
+ * @brief header file for the compare predicates, with which copy_if and split_if (see functional.h) filter whole registers at a
+ * time.
+ * @note the kernels are in simd_filter.cxx: a program that includes this header must link it (it's part of the library, like
+ * thread_pool.cxx). functional.h on its own doesn't need it.
+ */
+#ifndef __IF_FUNCTIONAL_SIMD__
+#define __IF_FUNCTIONAL_SIMD__
+#include <vector>
+#include <memory>
+#include <type_traits>
+#include <gen/functional.h>
+#include <gen/simd_filter.h>
+
+/*
+ * @brief this namespace is for items that are of general interest.
+ */
+namespace re_gen {
+
+//* compare class
+/*
+ * @brief a predicate that compares its argument with a bound: less_than<T>(bound), less_equal, greater_than, greater_equal,
+ * equals and not_equals; and in_range<T>(bound, upper), which is bound <= x && x < upper.
+ * @remarks any predicate will do for copy_if and split_if, but these ones let them vectorize. if the input and output(s) are
+ * pointers to, or std::vector iterators over, T - and T is a signed 32 or 64 bit int, a float or a double - copy_if and split_if
+ * filter whole registers at a time (see simd_filter.h): with AVX-512 compress, or with an AVX2 shuffle-table left-pack,
+ * whichever the cpu has (checked at run time), or else with a branchless loop. nothing is written to an output beyond the
+ * elements copied to it, just as with the plain loop, and the elements keep their order. the parallel overloads (see
+ * functional_parallel.h) vectorize each chunk in the same way.
+ * @example:
+ *  vector<float> vf, small(vf.size());
+ *  small.erase(copy_if(vf.begin(), vf.end(), small.begin(), in_range<float>(-1.0f, 1.0f)), small.end());
+ */
+template <typename T, int Op>
+class compare {
+public:
+  explicit compare(T _bound, T _upper = T()) : bound(_bound), upper(_upper) {
+  }
+  bool operator()(const T &x) const {
+    switch (Op) {
+    case CMP_LESS:
+      return(x < bound);
+    case CMP_LESS_EQUAL:
+      return(x <= bound);
+    case CMP_GREATER:
+      return(x > bound);
+    case CMP_GREATER_EQUAL:
+      return(x >= bound);
+    case CMP_EQUAL:
+      return(x == bound);
+    case CMP_NOT_EQUAL:
+      return(x != bound);
+    default:
+      return(bound <= x && x < upper);
+    }
+  }
+  T bound;
+  T upper;
+};
+
+template <typename T> using less_than = compare<T, CMP_LESS>;
+template <typename T> using less_equal = compare<T, CMP_LESS_EQUAL>;
+template <typename T> using greater_than = compare<T, CMP_GREATER>;
+template <typename T> using greater_equal = compare<T, CMP_GREATER_EQUAL>;
+template <typename T> using equals = compare<T, CMP_EQUAL>;
+template <typename T> using not_equals = compare<T, CMP_NOT_EQUAL>;
+template <typename T> using in_range = compare<T, CMP_IN_RANGE>;
+
+namespace re_functional_helpers {
+  //true if It is a pointer to, or a std::vector iterator over, T - so its elements are contiguous
+  template <typename It, typename T>
+  struct contiguous {
+    static const bool value = std::is_same<It, T *>::value || std::is_same<It, typename std::vector<T>::iterator>::value;
+  };
+
+  template <typename It, typename T>
+  struct contiguous_input {
+    static const bool value = contiguous<It, T>::value || std::is_same<It, const T *>::value ||
+      std::is_same<It, typename std::vector<T>::const_iterator>::value;
+  };
+
+  //copy_if and split_if with a compare predicate: the kernels when there's one for the elements, and the iterators are
+  //contiguous; otherwise the plain loops
+  template <typename T, int Op>
+  struct Filter<re_gen::compare<T, Op> > {
+    typedef re_gen::compare<T, Op> Condition;
+    template <typename In_T, typename Out_T>
+    static Out_T copy_if(In_T in, In_T in_end, Out_T out, Condition &condition) {
+      typedef std::integral_constant<bool, re_gen::simd_elem<T>::value != re_gen::SIMD_ELEM_NONE &&
+	contiguous_input<In_T, T>::value && contiguous<Out_T, T>::value> vectorized;
+      return(copy_if(in, in_end, out, condition, vectorized()));
+    }
+    template <typename In_T, typename Out_T1, typename Out_T2>
+    static Out_T1 split_if(In_T in, In_T in_end, Out_T1 out1, Out_T2 out2, Condition &condition) {
+      typedef std::integral_constant<bool, re_gen::simd_elem<T>::value != re_gen::SIMD_ELEM_NONE &&
+	contiguous_input<In_T, T>::value && contiguous<Out_T1, T>::value && contiguous<Out_T2, T>::value> vectorized;
+      return(split_if(in, in_end, out1, out2, condition, vectorized()));
+    }
+  private:
+    template <typename In_T, typename Out_T>
+    static Out_T copy_if(In_T in, In_T in_end, Out_T out, Condition &condition, std::true_type) {
+      if (in == in_end)
+	return(out);
+      return(out + re_gen::simd_copy_if(re_gen::simd_elem<T>::value, std::addressof(*in), in_end - in, std::addressof(*out),
+					static_cast<re_gen::Compare_Op>(Op), &condition.bound, &condition.upper));
+    }
+    template <typename In_T, typename Out_T>
+    static Out_T copy_if(In_T in, In_T in_end, Out_T out, Condition &condition, std::false_type) {
+      while (in != in_end) {
+	if (condition(*in))
+	  *out++ = *in;
+	++in;
+      }
+      return(out);
+    }
+    template <typename In_T, typename Out_T1, typename Out_T2>
+    static Out_T1 split_if(In_T in, In_T in_end, Out_T1 out1, Out_T2 out2, Condition &condition, std::true_type) {
+      if (in == in_end)
+	return(out1);
+      return(out1 + re_gen::simd_split_if(re_gen::simd_elem<T>::value, std::addressof(*in), in_end - in, std::addressof(*out1),
+					  std::addressof(*out2), static_cast<re_gen::Compare_Op>(Op), &condition.bound,
+					  &condition.upper));
+    }
+    template <typename In_T, typename Out_T1, typename Out_T2>
+    static Out_T1 split_if(In_T in, In_T in_end, Out_T1 out1, Out_T2 out2, Condition &condition, std::false_type) {
+      while (in != in_end) {
+	if (condition(*in))
+	  *out1++ = *in;
+	else
+	  *out2++ = *in;
+	++in;
+      }
+      return(out1);
+    }
+  };
+}
+};//namespace re_gen
+#endif //__IF_FUNCTIONAL_SIMD__
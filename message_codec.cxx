@@ -0,0 +1,345 @@
+//* binary message log encoder and decoder
+/*
+ * @remarks writes and reads the Message_Processor's binary log format (see message_codec.h)
+ */
+#include <cstring>
+#include "gen/gendefs.h"
+#include "gen/message_codec.h"
+
+namespace {
+  void put_varint(unsigned long long v, std::string *const out) {
+    while (v >= 0x80) {
+      out->push_back(static_cast<char>((v & 0x7f) | 0x80));
+      v >>= 7;
+    }
+    out->push_back(static_cast<char>(v));
+  }
+  void put_signed(long long v, std::string *const out) {
+    put_varint((static_cast<unsigned long long>(v) << 1) ^ static_cast<unsigned long long>(v >> 63), out);
+  }
+  void put_bytes(const char *s, size_t len, std::string *const out) {
+    put_varint(len, out);
+    out->append(s, len);
+  }
+  void put_double(double d, std::string *const out) {
+    unsigned long long bits;
+    memcpy(&bits, &d, sizeof(bits));
+    for (int i = 0; i < 8; ++i, bits >>= 8)
+      out->push_back(static_cast<char>(bits & 0xff));
+  }
+
+  bool get_varint(const char **p, const char *end, unsigned long long *v) {
+    *v = 0;
+    for (int shift = 0; *p < end && shift < 64; shift += 7) {
+      const unsigned char b = static_cast<unsigned char>(*(*p)++);
+      *v |= static_cast<unsigned long long>(b & 0x7f) << shift;
+      if ((b & 0x80) == 0)
+	return(true);
+    }
+    return(false);
+  }
+  bool get_signed(const char **p, const char *end, long long *v) {
+    unsigned long long u;
+    if (!get_varint(p, end, &u))
+      return(false);
+    *v = static_cast<long long>(u >> 1) ^ -static_cast<long long>(u & 1);
+    return(true);
+  }
+  bool get_bytes(const char **p, const char *end, std::string *s) {
+    unsigned long long len;
+    if (!get_varint(p, end, &len) || len > static_cast<unsigned long long>(end - *p))
+      return(false);
+    s->assign(*p, len);
+    *p += len;
+    return(true);
+  }
+  bool get_double(const char **p, const char *end, double *d) {
+    if (end - *p < 8)
+      return(false);
+    unsigned long long bits = 0;
+    for (int i = 7; i >= 0; --i)
+      bits = (bits << 8) | static_cast<unsigned char>((*p)[i]);
+    memcpy(d, &bits, sizeof(bits));
+    *p += 8;
+    return(true);
+  }
+};//anonymous namespace
+
+
+//* re_gen namespace
+/**
+ * @brief this namespace is for items that are of general interest.
+ */
+namespace re_gen {
+
+Message_Encoder::Message_Encoder(unsigned long long base_stamp) :
+  base_stamp(base_stamp), prev_stamp(base_stamp), known_sources(), format_ids(), thread_ids() {
+}
+
+//* Message_Encoder::begin
+/*
+ * @brief append the log header; call this once, before anything else
+ */
+void Message_Encoder::begin(std::string *const out) {
+  out->append(BINARY_LOG_MAGIC, BINARY_LOG_MAGIC_LEN);
+  put_varint(base_stamp, out);
+}
+
+void Message_Encoder::add_source(int src, const std::string &src_name, std::string *const out) {
+  if (src < 0)
+    return;
+  if (known_sources.size() <= static_cast<size_t>(src))
+    known_sources.resize(src + 1, false);
+  known_sources[src] = true;
+  out->push_back(static_cast<char>(MSG_REC_SOURCE));
+  put_varint(src, out);
+  put_bytes(src_name.data(), src_name.size(), out);
+}
+
+bool Message_Encoder::knows_source(int src) const {
+  return(src >= 0 && static_cast<size_t>(src) < known_sources.size() && known_sources[src]);
+}
+
+//* Message_Encoder::encode_header
+/*
+ * @brief append the record type and the fields that every message has; and the thread's dictionary record, if it's new
+ */
+void Message_Encoder::encode_header(unsigned long long stamp, unsigned long tid, int src, Verbosity_Level severity,
+                                    Msg_Rec_Type rec_type, std::string *const out) {
+  std::map<unsigned long, unsigned long>::const_iterator it = thread_ids.find(tid);
+  if (it == thread_ids.end()) {
+    it = thread_ids.insert(std::make_pair(tid, static_cast<unsigned long>(thread_ids.size()))).first;
+    out->push_back(static_cast<char>(MSG_REC_THREAD));
+    put_varint(it->second, out);
+    put_varint(tid, out);
+  }
+  out->push_back(static_cast<char>(rec_type));
+  put_signed(static_cast<long long>(stamp - prev_stamp), out);
+  prev_stamp = stamp;
+  //src is -1 for messages that have no source
+  put_varint(static_cast<unsigned long long>(src + 1), out);
+  out->push_back(static_cast<char>(severity));
+  put_varint(it->second, out);
+}
+
+void Message_Encoder::encode(unsigned long long stamp, unsigned long tid, int src, Verbosity_Level severity,
+                             const std::string &msg, std::string *const out) {
+  encode_header(stamp, tid, src, severity, MSG_REC_TEXT, out);
+  put_bytes(msg.data(), msg.size(), out);
+}
+
+void Message_Encoder::encode(unsigned long long stamp, unsigned long tid, int src, Verbosity_Level severity,
+                             const Fmt_Args &fmt_args, std::string *const out) {
+  std::map<const char *, unsigned long>::const_iterator it = format_ids.find(fmt_args.fmt);
+  if (it == format_ids.end()) {
+    it = format_ids.insert(std::make_pair(fmt_args.fmt, static_cast<unsigned long>(format_ids.size()))).first;
+    encode_format(it->second, fmt_args.fmt, out);
+  }
+  encode_header(stamp, tid, src, severity, MSG_REC_FMT, out);
+  put_varint(it->second, out);
+  encode_args(fmt_args, out);
+}
+
+//* Message_Encoder::encode_standalone
+/*
+ * @brief append a self-contained record: the message, preceded by the dictionary records that it needs
+ * @remarks the encoder keeps no state for these, so any thread can call them at any time. out is appended to, so reuse it to
+ * avoid allocation.
+ */
+void Message_Encoder::encode_standalone(unsigned long long stamp, unsigned long tid, int src, const std::string *src_name,
+                                        Verbosity_Level severity, const char *msg, size_t msg_len, std::string *const out) {
+  encode_standalone_header(stamp, tid, src, src_name, severity, MSG_REC_TEXT, out);
+  put_bytes(msg, msg_len, out);
+}
+
+void Message_Encoder::encode_standalone(unsigned long long stamp, unsigned long tid, int src, const std::string *src_name,
+                                        Verbosity_Level severity, const Fmt_Args &fmt_args, std::string *const out) {
+  encode_format(0, fmt_args.fmt, out);
+  encode_standalone_header(stamp, tid, src, src_name, severity, MSG_REC_FMT, out);
+  put_varint(0, out);
+  encode_args(fmt_args, out);
+}
+
+void Message_Encoder::encode_standalone_header(unsigned long long stamp, unsigned long tid, int src, const std::string *src_name,
+                                               Verbosity_Level severity, Msg_Rec_Type rec_type, std::string *const out) {
+  if (src_name != 0) {
+    out->push_back(static_cast<char>(MSG_REC_SOURCE));
+    put_varint(src, out);
+    put_bytes(src_name->data(), src_name->size(), out);
+  }
+  out->push_back(static_cast<char>(MSG_REC_THREAD));
+  put_varint(0, out);
+  put_varint(tid, out);
+  out->push_back(static_cast<char>(rec_type));
+  put_signed(static_cast<long long>(stamp), out);
+  put_varint(static_cast<unsigned long long>(src + 1), out);
+  out->push_back(static_cast<char>(severity));
+  put_varint(0, out);
+}
+
+void Message_Encoder::encode_format(unsigned long fmt_id, const char *fmt, std::string *const out) {
+  out->push_back(static_cast<char>(MSG_REC_FORMAT));
+  put_varint(fmt_id, out);
+  if (fmt != 0)
+    put_bytes(fmt, strlen(fmt), out);
+  else
+    put_varint(0, out);
+}
+
+void Message_Encoder::encode_args(const Fmt_Args &fmt_args, std::string *const out) {
+  out->push_back(static_cast<char>(fmt_args.n_args));
+  for (int i = 0; i < fmt_args.n_args; ++i) {
+    const Fmt_Arg &arg = fmt_args.args[i];
+    out->push_back(static_cast<char>(arg.type));
+    switch (arg.type) {
+    case FMT_ARG_INT:
+      put_signed(arg.value.i, out);
+      break;
+    case FMT_ARG_UINT:
+      put_varint(arg.value.u, out);
+      break;
+    case FMT_ARG_DOUBLE:
+      put_double(arg.value.d, out);
+      break;
+    case FMT_ARG_STR:
+      //the decoder has no way to tell a null string from an empty one, so it's written as "(null)", as format_fmt_args would
+      if (arg.value.s != 0)
+	put_bytes(arg.value.s, strlen(arg.value.s), out);
+      else
+	put_bytes("(null)", 6, out);
+      break;
+    case FMT_ARG_PTR:
+      put_varint(reinterpret_cast<unsigned long long>(arg.value.p), out);
+      break;
+    }
+  }
+}
+
+
+Message_Decoder::Message_Decoder(void) :
+  base(0), prev_stamp(0), source_names(), formats(), threads(), str_args(MAX_FMT_ARGS) {
+}
+
+//* Message_Decoder::read_header
+/*
+ * @brief check the magic number, and read the base time stamp
+ * @return false if this is not a binary log
+ */
+bool Message_Decoder::read_header(const char **p, const char *end) {
+  if (end - *p < static_cast<long>(BINARY_LOG_MAGIC_LEN) || memcmp(*p, BINARY_LOG_MAGIC, BINARY_LOG_MAGIC_LEN) != 0)
+    return(false);
+  const char *q = *p + BINARY_LOG_MAGIC_LEN;
+  if (!get_varint(&q, end, &base))
+    return(false);
+  prev_stamp = base;
+  *p = q;
+  return(true);
+}
+
+const std::string *Message_Decoder::source_name(int src) const {
+  std::map<int, std::string>::const_iterator it = source_names.find(src);
+  return(it != source_names.end() ? &it->second : 0);
+}
+
+//* Message_Decoder::decode
+/*
+ * @brief decode the record at *p
+ * @return DECODE_MSG if *msg has been filled in; DECODE_DICT for a dictionary record (nothing to display); DECODE_END at the
+ * end of the buffer; and DECODE_ERROR if the record is corrupt or truncated.
+ * @remarks *p is advanced past the record, except on DECODE_ERROR.
+ */
+Message_Decoder::Decode_Status Message_Decoder::decode(const char **p, const char *end, Decoded_Msg *const msg) {
+  if (*p >= end)
+    return(DECODE_END);
+  const char *q = *p;
+  const int rec_type = static_cast<unsigned char>(*q++);
+  unsigned long long id, value;
+  std::string text;
+  switch (rec_type) {
+  case MSG_REC_SOURCE:
+    if (!get_varint(&q, end, &id) || !get_bytes(&q, end, &text))
+      return(DECODE_ERROR);
+    source_names[static_cast<int>(id)].swap(text);
+    *p = q;
+    return(DECODE_DICT);
+  case MSG_REC_FORMAT:
+    if (!get_varint(&q, end, &id) || !get_bytes(&q, end, &text))
+      return(DECODE_ERROR);
+    formats[id].swap(text);
+    *p = q;
+    return(DECODE_DICT);
+  case MSG_REC_THREAD:
+    if (!get_varint(&q, end, &id) || !get_varint(&q, end, &value))
+      return(DECODE_ERROR);
+    threads[id] = value;
+    *p = q;
+    return(DECODE_DICT);
+  case MSG_REC_TEXT:
+  case MSG_REC_FMT:
+    break;
+  default:
+    return(DECODE_ERROR);
+  }
+  long long delta;
+  unsigned long long src, thread_idx;
+  if (!get_signed(&q, end, &delta) || !get_varint(&q, end, &src) || q >= end)
+    return(DECODE_ERROR);
+  const int severity = static_cast<unsigned char>(*q++);
+  if (severity > VERBOSITY_EVERYTHING || !get_varint(&q, end, &thread_idx))
+    return(DECODE_ERROR);
+  std::map<unsigned long, unsigned long>::const_iterator thread = threads.find(thread_idx);
+  if (thread == threads.end())
+    return(DECODE_ERROR);
+  if (rec_type == MSG_REC_TEXT) {
+    if (!get_bytes(&q, end, &msg->msg))
+      return(DECODE_ERROR);
+  } else {
+    unsigned long long fmt_id;
+    if (!get_varint(&q, end, &fmt_id) || q >= end)
+      return(DECODE_ERROR);
+    std::map<unsigned long, std::string>::const_iterator fmt = formats.find(fmt_id);
+    const int n_args = static_cast<unsigned char>(*q++);
+    if (fmt == formats.end() || n_args > MAX_FMT_ARGS)
+      return(DECODE_ERROR);
+    Fmt_Args fmt_args;
+    fmt_args.fmt = fmt->second.c_str();
+    fmt_args.n_args = n_args;
+    for (int i = 0; i < n_args; ++i) {
+      if (q >= end)
+	return(DECODE_ERROR);
+      Fmt_Arg &arg = fmt_args.args[i];
+      arg.type = static_cast<Fmt_Arg_Type>(static_cast<unsigned char>(*q++));
+      bool ok = false;
+      switch (arg.type) {
+      case FMT_ARG_INT:
+	ok = get_signed(&q, end, &arg.value.i);
+	break;
+      case FMT_ARG_UINT:
+	ok = get_varint(&q, end, &arg.value.u);
+	break;
+      case FMT_ARG_DOUBLE:
+	ok = get_double(&q, end, &arg.value.d);
+	break;
+      case FMT_ARG_STR:
+	ok = get_bytes(&q, end, &str_args[i]);
+	arg.value.s = str_args[i].c_str();
+	break;
+      case FMT_ARG_PTR:
+	ok = get_varint(&q, end, &value);
+	arg.value.p = reinterpret_cast<const void *>(value);
+	break;
+      }
+      if (!ok)
+	return(DECODE_ERROR);
+    }
+    format_fmt_args(fmt_args, &msg->msg);
+  }
+  prev_stamp += delta;
+  msg->stamp = prev_stamp;
+  msg->tid = thread->second;
+  msg->src = static_cast<int>(src) - 1;
+  msg->severity = static_cast<Verbosity_Level>(severity);
+  *p = q;
+  return(DECODE_MSG);
+}
+};//namespace re_gen
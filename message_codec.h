@@ -0,0 +1,127 @@
+//* message_codec.h - header file for the binary message log encoder and decoder
+/*
+ * @brief this header file defines the Message_Encoder and Message_Decoder classes, which write and read the Message_Processor's
+ * compact binary log format.
+ */
+#ifndef __IF_MESSAGE_CODEC__
+#define __IF_MESSAGE_CODEC__
+#include <map>
+#include <string>
+#include <vector>
+#include <gen/gendefs.h>
+#include <gen/message_format.h>
+
+//* re_gen namespace
+/**
+ * @brief this namespace is for items that are of general interest.
+ */
+namespace re_gen {
+
+/*
+ * the binary log format
+ *
+ * a binary log is an 8 byte magic number ("RGBLOG01"), a varint base time stamp, then a sequence of records. every record starts
+ * with a one byte record type. integers are unsigned LEB128 varints; signed integers are zigzag-encoded first.
+ *
+ *   MSG_REC_SOURCE  src id, name length, name
+ *   MSG_REC_FORMAT  format id, format length, format string
+ *   MSG_REC_THREAD  thread index, pthread id
+ *   MSG_REC_TEXT    signed stamp delta, src id, severity byte, thread index, text length, text
+ *   MSG_REC_FMT     signed stamp delta, src id, severity byte, thread index, format id, arg count, args
+ *
+ * each arg is a type byte (Fmt_Arg_Type) followed by a zigzag varint (FMT_ARG_INT), a varint (FMT_ARG_UINT, FMT_ARG_PTR), 8 bytes
+ * of little-endian IEEE double (FMT_ARG_DOUBLE), or a length and the characters (FMT_ARG_STR - the string itself is written, not
+ * the pointer).
+ *
+ * the names of the sources that are registered when the log is started are written straight after the header; after that,
+ * the dictionary records (source, format, thread) are written just before the first message that refers to them. so every
+ * source name, format string and thread id is written just once, and a log can be decoded from the start without a separate
+ * dictionary file. stamp deltas are relative to the previous message (or to the base stamp).
+ *
+ * a self-contained record (see Message_Encoder::encode_standalone) is a message together with its own dictionary records, and
+ * a stamp relative to 0; it can be decoded by a new Message_Decoder, without a header.
+ */
+const char BINARY_LOG_MAGIC[] = "RGBLOG01";
+const size_t BINARY_LOG_MAGIC_LEN = 8;
+enum Msg_Rec_Type { MSG_REC_SOURCE = 1,
+                    MSG_REC_FORMAT = 2,
+                    MSG_REC_THREAD = 3,
+                    MSG_REC_TEXT   = 4,
+                    MSG_REC_FMT    = 5
+};
+
+//* Message_Encoder class
+/*
+ * @brief appends binary log records to a buffer
+ * @remarks the encoder remembers which sources, formats and threads it has already written; so use one encoder per log file, and
+ * don't drop any of the bytes it appends.
+ * @note format strings are recognized by their address, as they're assumed to be string literals (see Fmt_Args).
+ */
+class Message_Encoder {
+ public:
+  Message_Encoder(unsigned long long base_stamp);
+  void begin(std::string *const out);
+  void add_source(int src, const std::string &src_name, std::string *const out);
+  bool knows_source(int src) const;
+  void encode(unsigned long long stamp, unsigned long tid, int src, Verbosity_Level severity, const std::string &msg,
+              std::string *const out);
+  void encode(unsigned long long stamp, unsigned long tid, int src, Verbosity_Level severity, const Fmt_Args &fmt_args,
+              std::string *const out);
+  static void encode_standalone(unsigned long long stamp, unsigned long tid, int src, const std::string *src_name,
+                                Verbosity_Level severity, const char *msg, size_t msg_len, std::string *const out);
+  static void encode_standalone(unsigned long long stamp, unsigned long tid, int src, const std::string *src_name,
+                                Verbosity_Level severity, const Fmt_Args &fmt_args, std::string *const out);
+
+ private:
+  void encode_header(unsigned long long stamp, unsigned long tid, int src, Verbosity_Level severity, Msg_Rec_Type rec_type,
+                     std::string *const out);
+  static void encode_standalone_header(unsigned long long stamp, unsigned long tid, int src, const std::string *src_name,
+                                       Verbosity_Level severity, Msg_Rec_Type rec_type, std::string *const out);
+  static void encode_format(unsigned long fmt_id, const char *fmt, std::string *const out);
+  static void encode_args(const Fmt_Args &fmt_args, std::string *const out);
+  unsigned long long base_stamp;
+  unsigned long long prev_stamp;
+  std::vector<bool> known_sources;
+  std::map<const char *, unsigned long> format_ids;
+  std::map<unsigned long, unsigned long> thread_ids;
+};//class Message_Encoder
+
+//* struct Decoded_Msg
+/*
+ * @brief a message read from a binary log, with its format string (if any) already applied
+ */
+struct Decoded_Msg {
+  unsigned long long stamp;
+  unsigned long tid;
+  int src;
+  Verbosity_Level severity;
+  std::string msg;
+};
+
+//* Message_Decoder class
+/*
+ * @brief reads binary log records from a buffer
+ * @remarks call read_header once, then call decode until it returns DECODE_END. the decoder keeps the dictionary records, so a
+ * log must be decoded in order, from the start.
+ * @note DECODE_ERROR means the record at *p is corrupt, or was cut short (eg. the process died while writing it); *p is left
+ * pointing at it.
+ */
+class Message_Decoder {
+ public:
+  enum Decode_Status { DECODE_MSG, DECODE_DICT, DECODE_END, DECODE_ERROR };
+  Message_Decoder(void);
+  bool read_header(const char **p, const char *end);
+  Decode_Status decode(const char **p, const char *end, Decoded_Msg *const msg);
+  const std::string *source_name(int src) const;
+  unsigned long long base_stamp(void) const { return(base); }
+
+ private:
+  unsigned long long base;
+  unsigned long long prev_stamp;
+  std::map<int, std::string> source_names;
+  std::map<unsigned long, std::string> formats;
+  std::map<unsigned long, unsigned long> threads;
+  std::vector<std::string> str_args;
+};//class Message_Decoder
+};//namespace re_gen
+#endif //__IF_MESSAGE_CODEC__
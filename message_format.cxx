@@ -0,0 +1,130 @@
+//* deferred message formatting
+/*
+ * @remarks formats the Fmt_Args records that are captured by Message_Processor::process_msg_fmt
+ */
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include "gen/message_format.h"
+
+namespace {
+  const char BAD_ARG[] = "<bad arg>";
+
+  //snprintf one conversion into out. spec is the conversion specification without its length modifier or conversion character
+  template <typename T>
+  void append_conversion(std::string *const out, std::string *const spec, const char *length, char conversion, T value) {
+    spec->append(length);
+    spec->push_back(conversion);
+    char buf[128];
+    int len = snprintf(buf, sizeof(buf), spec->c_str(), value);
+    if (len < 0)
+      return;
+    if (static_cast<size_t>(len) < sizeof(buf)) {
+      out->append(buf, len);
+      return;
+    }
+    //rare: a wide field, or a long %s with a precision. it's formatted again, in place at the end of out - whose capacity is
+    //kept from one message to the next, so this doesn't allocate either, once out has grown to fit
+    const size_t at = out->size();
+    out->resize(at + len + 1);
+    snprintf(&(*out)[at], len + 1, spec->c_str(), value);
+    out->resize(at + len);
+  }
+};//anonymous namespace
+
+
+//* re_gen namespace
+/**
+ * @brief this namespace is for items that are of general interest.
+ */
+namespace re_gen {
+
+void format_fmt_args(const Fmt_Args &record, std::string *const out) {
+  out->clear();
+  if (record.fmt == 0)
+    return;
+  std::string spec;
+  int arg_no = 0;
+  for (const char *p = record.fmt; *p != '\0'; ++p) {
+    if (*p != '%') {
+      out->push_back(*p);
+      continue;
+    }
+    if (p[1] == '%') {
+      out->push_back('%');
+      ++p;
+      continue;
+    }
+    //%[flags][width][.precision][length]conversion
+    spec.assign(1, '%');
+    for (++p; *p != '\0' && strchr("-+ #0", *p) != 0; ++p)
+      spec.push_back(*p);
+    for (; *p >= '0' && *p <= '9'; ++p)
+      spec.push_back(*p);
+    if (*p == '.') {
+      for (spec.push_back(*p++); *p >= '0' && *p <= '9'; ++p)
+	spec.push_back(*p);
+    }
+    for (; *p != '\0' && strchr("hlLqjzt", *p) != 0; ++p)
+      ;
+    if (*p == '\0')
+      break;
+    const char conversion = *p;
+    if (arg_no >= record.n_args) {
+      out->append(BAD_ARG);
+      continue;
+    }
+    const Fmt_Arg &arg = record.args[arg_no++];
+    switch (conversion) {
+    case 'd': case 'i':
+      if (arg.type == FMT_ARG_INT || arg.type == FMT_ARG_UINT)
+	append_conversion(out, &spec, "ll", conversion, arg.value.i);
+      else
+	out->append(BAD_ARG);
+      break;
+    case 'o': case 'u': case 'x': case 'X':
+      if (arg.type == FMT_ARG_INT || arg.type == FMT_ARG_UINT)
+	append_conversion(out, &spec, "ll", conversion, arg.value.u);
+      else
+	out->append(BAD_ARG);
+      break;
+    case 'c':
+      if (arg.type == FMT_ARG_INT || arg.type == FMT_ARG_UINT)
+	append_conversion(out, &spec, "", conversion, static_cast<int>(arg.value.i));
+      else
+	out->append(BAD_ARG);
+      break;
+    case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+      if (arg.type == FMT_ARG_DOUBLE)
+	append_conversion(out, &spec, "", conversion, arg.value.d);
+      else if (arg.type == FMT_ARG_INT)
+	append_conversion(out, &spec, "", conversion, static_cast<double>(arg.value.i));
+      else if (arg.type == FMT_ARG_UINT)
+	append_conversion(out, &spec, "", conversion, static_cast<double>(arg.value.u));
+      else
+	out->append(BAD_ARG);
+      break;
+    case 's':
+      if (arg.type == FMT_ARG_STR && spec.size() == 1) //a plain %s: no need for snprintf
+	out->append(arg.value.s != 0 ? arg.value.s : "(null)");
+      else if (arg.type == FMT_ARG_STR)
+	append_conversion(out, &spec, "", conversion, arg.value.s != 0 ? arg.value.s : "(null)");
+      else
+	out->append(BAD_ARG);
+      break;
+    case 'p':
+      if (arg.type == FMT_ARG_PTR)
+	append_conversion(out, &spec, "", conversion, arg.value.p);
+      else if (arg.type == FMT_ARG_STR)
+	append_conversion(out, &spec, "", conversion, static_cast<const void *>(arg.value.s));
+      else
+	out->append(BAD_ARG);
+      break;
+    default:
+      //%n, or something we don't recognize
+      out->append(BAD_ARG);
+      break;
+    }
+  }
+}
+};//namespace re_gen
@@ -0,0 +1,136 @@
+//* message_format.h - header file for deferred (printf-style) message formatting
+/*
+ * @brief this header file defines the Fmt_Args record, which holds a format string and its raw arguments, so that a message can
+ * be formatted on some thread other than the one that issued it.
+ */
+#ifndef __IF_MESSAGE_FORMAT__
+#define __IF_MESSAGE_FORMAT__
+#include <string>
+#include <type_traits>
+
+//* re_gen namespace
+/**
+ * @brief this namespace is for items that are of general interest.
+ */
+namespace re_gen {
+
+//the most arguments a deferred message can have
+const int MAX_FMT_ARGS = 8;
+
+enum Fmt_Arg_Type { FMT_ARG_INT,    //any signed integer, or enum
+                    FMT_ARG_UINT,   //any unsigned integer, or bool
+                    FMT_ARG_DOUBLE, //float, double or long double
+                    FMT_ARG_STR,    //char * - only the pointer is captured
+                    FMT_ARG_PTR     //any other pointer
+};
+
+struct Fmt_Arg {
+  Fmt_Arg_Type type;
+  union {
+    long long i;
+    unsigned long long u;
+    double d;
+    const char *s;
+    const void *p;
+  } value;
+};
+
+//* struct Fmt_Args
+/*
+ * @brief a printf-style format string and its arguments, captured but not yet formatted
+ * @remarks the record is a fixed size and trivially copyable, so capturing it costs a handful of stores, and no allocation.
+ * @note only the format pointer is captured, so the format string must outlive the record - in practice it should be a string
+ * literal. the same goes for %s arguments.
+ * @see capture_fmt_args, format_fmt_args
+ */
+struct Fmt_Args {
+  const char *fmt;
+  int n_args;
+  Fmt_Arg args[MAX_FMT_ARGS];
+};
+
+
+/* =================================================================
+ * Nothing to see beyond this point :-)
+ * =================================================================
+ */
+namespace re_fmt_helpers {
+  template <typename T>
+  typename std::enable_if<(std::is_integral<T>::value && std::is_signed<T>::value) || std::is_enum<T>::value, Fmt_Arg>::type
+  make_fmt_arg(T v) {
+    Fmt_Arg arg;
+    arg.type = FMT_ARG_INT;
+    arg.value.i = static_cast<long long>(v);
+    return(arg);
+  }
+  template <typename T>
+  typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value, Fmt_Arg>::type
+  make_fmt_arg(T v) {
+    Fmt_Arg arg;
+    arg.type = FMT_ARG_UINT;
+    arg.value.u = static_cast<unsigned long long>(v);
+    return(arg);
+  }
+  template <typename T>
+  typename std::enable_if<std::is_floating_point<T>::value, Fmt_Arg>::type
+  make_fmt_arg(T v) {
+    Fmt_Arg arg;
+    arg.type = FMT_ARG_DOUBLE;
+    arg.value.d = static_cast<double>(v);
+    return(arg);
+  }
+  inline Fmt_Arg make_fmt_arg(const char *v) {
+    Fmt_Arg arg;
+    arg.type = FMT_ARG_STR;
+    arg.value.s = v;
+    return(arg);
+  }
+  template <typename T>
+  Fmt_Arg make_fmt_arg(const T *v) {
+    Fmt_Arg arg;
+    arg.type = FMT_ARG_PTR;
+    arg.value.p = v;
+    return(arg);
+  }
+  template <typename T>
+  typename std::enable_if<!std::is_arithmetic<T>::value && !std::is_enum<T>::value && !std::is_pointer<T>::value, Fmt_Arg>::type
+  make_fmt_arg(const T &) {
+    static_assert(sizeof(T) == 0, "deferred message arguments must be arithmetic types, enums or pointers - format anything else with process_msg");
+    return(Fmt_Arg());
+  }
+  inline void capture(Fmt_Arg *) {
+  }
+  template <typename Arg_T, typename... Args>
+  void capture(Fmt_Arg *dst, const Arg_T &arg, const Args&... args) {
+    *dst = make_fmt_arg(arg);
+    capture(dst + 1, args...);
+  }
+}
+
+//* capture_fmt_args function
+/*
+ * @brief capture a format string and its arguments in a Fmt_Args record
+ * @param record - the record to fill in.
+ * @param fmt - the printf-style format string.
+ * @param args - the arguments; arithmetic types, enums and pointers only (checked at compile time).
+ */
+template <typename... Args>
+void capture_fmt_args(Fmt_Args *record, const char *fmt, const Args&... args) {
+  static_assert(sizeof...(Args) <= MAX_FMT_ARGS, "too many arguments for a deferred message");
+  record->fmt = fmt;
+  record->n_args = sizeof...(Args);
+  re_fmt_helpers::capture(record->args, args...);
+}
+
+//* format_fmt_args function
+/*
+ * @brief format a captured record, as printf would have
+ * @param record - the captured format string and arguments.
+ * @param out - the formatted message replaces the contents of this string.
+ * @remarks each conversion (bar a plain %s, which is simply appended) is done by snprintf, so flags, width and precision work as
+ * usual. length modifiers in the format string are ignored; the captured argument's own type is used instead. a conversion that
+ * doesn't suit its argument, or that has no argument, is displayed as "<bad arg>"; %n and '*' widths are not supported.
+ */
+void format_fmt_args(const Fmt_Args &record, std::string *const out);
+};//namespace re_gen
+#endif //__IF_MESSAGE_FORMAT__
@@ -2,14 +2,30 @@
 /*
  * @remarks message processor for serializing messages from multi-threaded applications; uses zthreads
  */
-#include <map>
-#include <iomanip>
+#include <new>
+#include <cstdlib>
+#include <atomic>
+#include <algorithm>
+#include <ctime>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <iterator>
+#include <utility>
 #include <sstream>
 #include <iostream>
 #include <pthread.h>
-#include <sys/time.h>
+#include <sched.h>
 #include "gen/gendefs.h"
-#include "gen/queue.h"
+#include "gen/bounded_queue.h"
+#include "gen/spsc_ring.h"
+#include "gen/message_renderer.h"
+#include "gen/message_sink.h"
+#include "gen/message_codec.h"
+#include "gen/crash_ring.h"
+#include "gen/msg_clock.h"
+#include "gen/msg_payload.h"
 #include "gen/message_processor.h"
 
 //* struct Message_Parms
@@ -20,31 +36,362 @@
  */
 namespace {
   //            Action              parameters
-  enum Action { ACTION_KILL,       //none
-                ACTION_DISPLAY_MSG //id of requesting thread, message source if, importance prefix, message string
+  enum Action { ACTION_DISPLAY_MSG,   //id of requesting thread, message source if, importance prefix, message string
+                ACTION_DISPLAY_FMT,   //as ACTION_DISPLAY_MSG, but the message is a format string and arguments, yet to be formatted
+                ACTION_SET_SINK,      //fmt_args().args[0] is the new Message_Sink
+                ACTION_FLUSH,         //none
+                ACTION_SET_TIMESTAMPS //fmt_args().args[0] is the Timestamp_Columns
   };
+  //nanoseconds on the monotonic clock
+  unsigned long long now_ns(void) {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return(static_cast<unsigned long long>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec);
+  }
+  //the record is a fixed size, with the text (or the Fmt_Args) in its payload, so it's built in its ring or queue slot without
+  //allocating anything; see Msg_Payload
   class Message_Parms {
   public:
     Action action;
     pthread_t tid;
     int src;
     re_gen::Verbosity_Level severity;
-    std::string msg;
+    unsigned long long stamp;  //Msg_Clock ticks
+    re_gen::Msg_Payload payload;  //the message string for ACTION_DISPLAY_MSG, and the Fmt_Args for everything else
     Message_Parms(Action  _action, pthread_t _tid, int _src, re_gen::Verbosity_Level _severity, const std::string &_msg) :
-      action(_action), tid(_tid), src(_src), severity(_severity), msg(_msg) {
+      action(_action), tid(_tid), src(_src), severity(_severity), stamp(re_gen::Msg_Clock::ticks()), payload(_msg.data(), _msg.size()) {
+    }
+    Message_Parms(Action  _action, pthread_t _tid, int _src, re_gen::Verbosity_Level _severity, const char *_msg) :
+      action(_action), tid(_tid), src(_src), severity(_severity), stamp(re_gen::Msg_Clock::ticks()), payload(_msg, strlen(_msg)) {
+    }
+    Message_Parms(Action  _action, pthread_t _tid, int _src, re_gen::Verbosity_Level _severity, const re_gen::Fmt_Args &_fmt_args) :
+      action(_action), tid(_tid), src(_src), severity(_severity), stamp(re_gen::Msg_Clock::ticks()), payload(_fmt_args) {
     }
+    const re_gen::Fmt_Args &fmt_args(void) const { return(payload.fmt_args()); }
   };
-  typedef re_gen::Queue<Message_Parms> Message_Queue;
-  typedef std::map<int, std::string> Message_Source_Name_Map;
-  typedef std::map<int, re_gen::Verbosity_Level> Message_Source_Verbosity_Map;
-  std::string msg_prefixes[] = { 
-    "",        //VERBOSITY_QUIET
-    "Error: ", //VERBOSITY_ERRORS
-    "Info:  ", //VERBOSITY_MAJOR_STEPS,
-    "Info:  ", //VERBOSITY_MINOR_STEPS,
-    "Debug: "  //VERBOSITY_EVERYTHING
+  //* struct Lane_Sweep
+  /*
+   * @brief the messages that have been taken out of one lane's rings and queue, but not yet handed on in a batch
+   * @remarks pending holds the messages that were held back last time, then those taken in this sweep. order is sorted instead of
+   * pending: (stamp, index in pending) pairs are a lot cheaper to move about than Message_Parms, and the index breaks ties the
+   * way a stable sort would. all three vectors are kept, so once they've grown a sweep allocates nothing.
+   */
+  struct Lane_Sweep {
+    std::vector<Message_Parms> pending;
+    std::vector<Message_Parms> held;
+    std::vector<std::pair<unsigned long long, size_t> > order;
+    Lane_Sweep(void) : pending(), held(), order() {}
+  };
+  typedef re_gen::Bounded_Queue<Message_Parms, 4096> Message_Queue;
+  typedef re_gen::Bounded_Queue<Message_Parms, 1024> Urgent_Queue;
+  //errors (and quiet messages - the program's own output) travel in the urgent lane; see Message_Processor::Impl::enqueue
+  bool is_urgent(re_gen::Verbosity_Level severity) {
+    return(severity <= re_gen::VERBOSITY_ERRORS);
+  }
+  //control messages (set_sink, flush) always travel in the normal lane
+  bool is_control(const Message_Parms &message_parms) {
+    return(message_parms.action != ACTION_DISPLAY_MSG && message_parms.action != ACTION_DISPLAY_FMT);
+  }
+
+  //* struct Staging_Buffer
+  /*
+   * @brief a producer thread's private ring of messages; see Message_Processor::Impl::staging_buffer
+   * @remarks a staging buffer is shared by its producer thread and the Message_Processor thread, and whichever lets go of it last
+   * deletes it. the producer lets go when it exits (see Staging_Handle); the Message_Processor lets go once the producer has gone
+   * and the ring is empty, or when the Message_Processor is destroyed.
+   */
+  //a ring holds a thread's bursts; beyond that its messages go in the shared queue, so the rings are kept small - each slot is a
+  //whole Message_Parms, and every thread that issues messages has a pair of them
+  const size_t STAGING_RING_SIZE = 256;
+  const size_t URGENT_RING_SIZE = 32;
+  //while working through a batch, the Message_Processor thread looks for urgent messages after every this many
+  const size_t URGENT_CHECK_INTERVAL = 256;
+  struct Staging_Buffer {
+    re_gen::Spsc_Ring<Message_Parms, STAGING_RING_SIZE> ring;
+    re_gen::Spsc_Ring<Message_Parms, URGENT_RING_SIZE> urgent_ring;
+    std::atomic<int> refs;
+    std::atomic<bool> orphaned;  //the producer thread has exited
+    unsigned long generation;    //which Message_Processor::Impl the buffer belongs to
+    Staging_Buffer *next;        //set by the producer before the buffer is published; from then on, only by the consumer
+    Staging_Buffer(unsigned long _generation) : refs(2), orphaned(false), generation(_generation), next(0) {
+    }
   };
-  re_gen::Message_Processor *singleton_message_processor = 0;
+  void release_staging_buffer(Staging_Buffer *buffer) {
+    if (buffer->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      delete buffer;
+  }
+  //lets go of the thread's staging buffer when the thread exits
+  class Staging_Handle {
+  public:
+    Staging_Buffer *buffer;
+    Staging_Handle(void) : buffer(0) {
+    }
+    ~Staging_Handle(void) {
+      if (buffer != 0) {
+	buffer->orphaned.store(true, std::memory_order_release);
+	release_staging_buffer(buffer);
+      }
+    }
+  };
+  thread_local Staging_Handle staging_handle;
+  //where a producer thread encodes its crash ring records
+  thread_local std::string crash_record;
+  //every Message_Processor::Impl gets a new generation, so a thread can tell that its staging buffer belongs to a dead one
+  std::atomic<unsigned long> impl_generations(0);
+
+  //* class Msg_Src_Table
+  /*
+   * @brief the registered message sources, indexed by id
+   * @remarks the table is allocated once, at its full size, and each entry has its own cache line(s), so that threads issuing
+   * messages from different sources never share a line. an id is claimed with a fetch-add; the entry's name is filled in, and
+   * then published with a release store, after which it never changes - so reading a name is wait-free. the verbosity can be
+   * changed at any time, without a lock (see set_verbosity).
+   * @remarks each entry also holds the source's rate limit, which is a token bucket kept as a single "theoretical arrival time"
+   * (the generic cell rate algorithm): a message is admitted if pushing that time on by one message interval leaves it no more
+   * than the burst ahead of now. admitting a message is a compare-and-swap, and there's nothing to refill.
+   */
+  class Msg_Src_Table {
+  public:
+    struct Fields {
+      std::atomic<int> verbosity;          //(source verbosity << 8) | effective verbosity - see set_verbosity
+      std::atomic<unsigned long> written;  //messages displayed (or written to the binary log) - by the Message_Processor thread
+      std::atomic<unsigned long long> rate_interval_ns;  //time per message allowed by the rate limit; 0 => no limit
+      std::atomic<unsigned long long> rate_burst_ns;     //how far ahead of now rate_tat may run: (burst - 1) intervals
+      std::atomic<unsigned long long> rate_tat;          //when the bucket will be full again
+      std::atomic<unsigned long> coalesced;              //repeats folded into "repeated" lines - by the Message_Processor thread
+      unsigned long reported_rate_limited;               //only touched by the Message_Processor thread
+      std::atomic<bool> registered;
+      std::string name;
+    };
+    enum { CACHE_LINE = 64 };
+    struct Entry : Fields {
+      char pad[CACHE_LINE - sizeof(Fields) % CACHE_LINE];
+    };
+    Msg_Src_Table(re_gen::Verbosity_Level _overall_verbosity) : entries(0), n_registered(0), overall_verbosity(_overall_verbosity) {
+      void *mem = 0;
+      if (posix_memalign(&mem, CACHE_LINE, sizeof(Entry) * re_gen::MAX_MSG_SRCS) != 0)
+	throw std::bad_alloc();
+      entries = static_cast<Entry *>(mem);
+      for (int src = 0; src < re_gen::MAX_MSG_SRCS; ++src) {
+	Entry *entry = new (&entries[src]) Entry;
+	//unregistered sources only get quiet messages through
+	entry->verbosity.store(0, std::memory_order_relaxed);
+	entry->written.store(0, std::memory_order_relaxed);
+	entry->rate_interval_ns.store(0, std::memory_order_relaxed);
+	entry->rate_burst_ns.store(0, std::memory_order_relaxed);
+	entry->rate_tat.store(0, std::memory_order_relaxed);
+	entry->coalesced.store(0, std::memory_order_relaxed);
+	entry->reported_rate_limited = 0;
+	entry->registered.store(false, std::memory_order_relaxed);
+      }
+    }
+    ~Msg_Src_Table(void) {
+      for (int src = 0; src < re_gen::MAX_MSG_SRCS; ++src)
+	entries[src].~Entry();
+      free(entries);
+    }
+    //returns the new source's id, or -1 if the table is full
+    int register_src(re_gen::Verbosity_Level verbosity, const std::string &name) {
+      int src = n_registered.fetch_add(1, std::memory_order_relaxed);
+      if (src >= re_gen::MAX_MSG_SRCS) {
+	n_registered.fetch_sub(1, std::memory_order_relaxed);
+	return(-1);
+      }
+      entries[src].name = name;
+      set_verbosity(src, verbosity);
+      entries[src].registered.store(true, std::memory_order_release);
+      return(src);
+    }
+    bool valid(int src) const {
+      return(static_cast<unsigned>(src) < static_cast<unsigned>(re_gen::MAX_MSG_SRCS));
+    }
+    //the effective verbosity is min(overall verbosity, source verbosity), so that filtering a message is a single load
+    re_gen::Verbosity_Level effective_verbosity(int src) const {
+      return(static_cast<re_gen::Verbosity_Level>(entries[src].verbosity.load(std::memory_order_relaxed) & 0xff));
+    }
+    //the entry's two verbosities are packed in one word, and both setters compare-and-swap it using the overall verbosity
+    //that they read after their last failed attempt; so whichever of two concurrent setters finishes last, the effective
+    //verbosity is right.
+    void set_verbosity(int src, re_gen::Verbosity_Level verbosity) {
+      int packed = entries[src].verbosity.load();
+      while (!entries[src].verbosity.compare_exchange_weak(packed, pack(verbosity)))
+	;
+    }
+    void set_overall_verbosity(re_gen::Verbosity_Level verbosity) {
+      overall_verbosity.store(verbosity);
+      for (int src = 0; src < re_gen::MAX_MSG_SRCS; ++src) {
+	int packed = entries[src].verbosity.load();
+	while (!entries[src].verbosity.compare_exchange_weak(packed, pack(static_cast<re_gen::Verbosity_Level>(packed >> 8))))
+	  ;
+      }
+    }
+    //msgs_per_sec <= 0 => no limit
+    void set_rate_limit(int src, double msgs_per_sec, unsigned long burst) {
+      Entry &entry = entries[src];
+      entry.rate_interval_ns.store(0, std::memory_order_relaxed);
+      if (msgs_per_sec <= 0)
+	return;
+      unsigned long long interval = std::max(static_cast<unsigned long long>(1e9 / msgs_per_sec), 1ULL);
+      entry.rate_burst_ns.store(interval * (std::max(burst, 1UL) - 1), std::memory_order_relaxed);
+      entry.rate_tat.store(0, std::memory_order_relaxed);
+      entry.rate_interval_ns.store(interval, std::memory_order_relaxed);
+    }
+    //true if the source's rate limit lets another message through now
+    bool admit(int src) {
+      Entry &entry = entries[src];
+      const unsigned long long interval = entry.rate_interval_ns.load(std::memory_order_relaxed);
+      if (interval == 0)
+	return(true);
+      const unsigned long long now = now_ns();
+      unsigned long long tat = entry.rate_tat.load(std::memory_order_relaxed);
+      unsigned long long next_tat;
+      do {
+	unsigned long long start = std::max(tat, now);
+	if (start - now > entry.rate_burst_ns.load(std::memory_order_relaxed))
+	  return(false);
+	next_tat = start + interval;
+      } while (!entry.rate_tat.compare_exchange_weak(tat, next_tat, std::memory_order_relaxed));
+      return(true);
+    }
+    re_gen::Verbosity_Level get_overall_verbosity(void) const {
+      return(static_cast<re_gen::Verbosity_Level>(overall_verbosity.load(std::memory_order_relaxed)));
+    }
+    const std::string *name(int src) const {
+      return(valid(src) && entries[src].registered.load(std::memory_order_acquire) ? &entries[src].name : 0);
+    }
+    int size(void) const {
+      return(std::min(n_registered.load(std::memory_order_acquire), static_cast<int>(re_gen::MAX_MSG_SRCS)));
+    }
+    Entry &operator[](int src) {
+      return(entries[src]);
+    }
+  private:
+    int pack(re_gen::Verbosity_Level verbosity) const {
+      return((verbosity << 8) | std::min(verbosity, static_cast<re_gen::Verbosity_Level>(overall_verbosity.load())));
+    }
+    Entry *entries;
+    std::atomic<int> n_registered;
+    std::atomic<int> overall_verbosity;
+    Msg_Src_Table(const Msg_Src_Table &);
+    Msg_Src_Table& operator=(const Msg_Src_Table &);
+  };
+
+  //* class Msg_Counters
+  /*
+   * @brief the per-source counts that the issuing threads keep, sharded by thread
+   * @remarks a shard holds a row of counters for every source, on cache lines of its own. each thread is given a shard, round
+   * robin, the first time it counts something, so threads only share a shard (and its lines) once there are more than
+   * N_SHARDS of them - however many of them issue messages from the same source. counting is a relaxed fetch-add on a line
+   * that is, in effect, the thread's own; reading a count means summing the shards, which only stats and the reports do.
+   */
+  std::atomic<unsigned> counter_shards(0);
+  thread_local int counter_shard = -1;
+  class Msg_Counters {
+  public:
+    enum Counter { ISSUED, DROPPED, FILTERED, RATE_LIMITED, N_COUNTERS };
+    enum { N_SHARDS = 16, CACHE_LINE = 64 };
+    Msg_Counters(void) : shards(0) {
+      void *mem = 0;
+      if (posix_memalign(&mem, CACHE_LINE, sizeof(Shard) * N_SHARDS) != 0)
+	throw std::bad_alloc();
+      shards = static_cast<Shard *>(mem);
+      for (int shard = 0; shard < N_SHARDS; ++shard) {
+	new (&shards[shard]) Shard;
+	for (int src = 0; src < re_gen::MAX_MSG_SRCS; ++src) {
+	  for (int counter = 0; counter < N_COUNTERS; ++counter)
+	    shards[shard].counts[src][counter].store(0, std::memory_order_relaxed);
+	}
+      }
+    }
+    ~Msg_Counters(void) {
+      for (int shard = 0; shard < N_SHARDS; ++shard)
+	shards[shard].~Shard();
+      free(shards);
+    }
+    void add(int src, Counter counter) {
+      if (counter_shard < 0)
+	counter_shard = counter_shards.fetch_add(1, std::memory_order_relaxed) % N_SHARDS;
+      shards[counter_shard].counts[src][counter].fetch_add(1, std::memory_order_relaxed);
+    }
+    unsigned long sum(int src, Counter counter) const {
+      unsigned long total = 0;
+      for (int shard = 0; shard < N_SHARDS; ++shard)
+	total += shards[shard].counts[src][counter].load(std::memory_order_relaxed);
+      return(total);
+    }
+  private:
+    struct Shard {
+      std::atomic<unsigned long> counts[re_gen::MAX_MSG_SRCS][N_COUNTERS];
+    };
+    Shard *shards;
+    Msg_Counters(const Msg_Counters &);
+    Msg_Counters& operator=(const Msg_Counters &);
+  };
+  //the latency histogram bucket for a latency of ns nanoseconds: floor(log2(ns)), within [0, MSG_LATENCY_BUCKETS)
+  int latency_bucket(unsigned long long ns) {
+    if (ns < 2)
+      return(0);
+    return(std::min(63 - __builtin_clzll(ns), re_gen::MSG_LATENCY_BUCKETS - 1));
+  }
+  //the time that a latency histogram's given fraction of messages were written within (rounded up to a bucket boundary)
+  unsigned long long latency_percentile(const unsigned long long *histogram, double fraction) {
+    unsigned long long total = 0, seen = 0;
+    for (int bucket = 0; bucket < re_gen::MSG_LATENCY_BUCKETS; ++bucket)
+      total += histogram[bucket];
+    for (int bucket = 0; bucket < re_gen::MSG_LATENCY_BUCKETS; ++bucket) {
+      seen += histogram[bucket];
+      if (seen != 0 && seen >= fraction * total)
+	return(2ULL << bucket);
+    }
+    return(0);
+  }
+  //a duration, in the largest unit in which it's at least 1 (rounded up, since it's used as an upper bound)
+  std::string round_up_duration(unsigned long long ns) {
+    static const char *const units[] = {" nS", " uS", " mS", " S"};
+    int unit = 0;
+    unsigned long long scale = 1;
+    for (; unit < 3 && ns >= scale * 1000; ++unit)
+      scale *= 1000;
+    std::ostringstream oss;
+    oss << (ns + scale - 1) / scale << units[unit];
+    return(oss.str());
+  }
+  //text as a JSON string, quotes and all
+  void json_string(std::ostringstream &oss, const std::string &text) {
+    oss << '"';
+    for (std::string::const_iterator it = text.begin(); it != text.end(); ++it) {
+      const unsigned char c = *it;
+      if (c == '"' || c == '\\')
+	oss << '\\' << c;
+      else if (c < 0x20) {
+	char escape[8];
+	snprintf(escape, sizeof(escape), "\\u%04x", c);
+	oss << escape;
+      }
+      else
+	oss << c;
+    }
+    oss << '"';
+  }
+  void json_src_stats(std::ostringstream &oss, const re_gen::Msg_Src_Stats &stats) {
+    oss << "{\"issued\":" << stats.issued << ",\"filtered\":" << stats.filtered << ",\"dropped\":" << stats.dropped
+	<< ",\"rate_limited\":" << stats.rate_limited << ",\"coalesced\":" << stats.coalesced << ",\"written\":" << stats.written
+	<< "}";
+  }
+  void json_queue_stats(std::ostringstream &oss, const re_gen::Queue_Stats &stats) {
+    oss << "{\"depth\":" << stats.depth << ",\"high_water\":" << stats.high_water << ",\"pushes\":" << stats.pushes
+	<< ",\"pops\":" << stats.pops << ",\"dropped\":" << stats.dropped << ",\"push_blocked_ns\":" << stats.push_blocked_ns
+	<< ",\"pop_blocked_ns\":" << stats.pop_blocked_ns << ",\"wait_empty_ns\":" << stats.wait_empty_ns << "}";
+  }
+  //the earlier of two deadlines, either of which may be 0 (none)
+  const timespec *earlier(const timespec *a, const timespec *b) {
+    if (a == 0 || b == 0)
+      return(a != 0 ? a : b);
+    return(b->tv_sec < a->tv_sec || (b->tv_sec == a->tv_sec && b->tv_nsec < a->tv_nsec) ? b : a);
+  }
+  std::atomic<re_gen::Message_Processor *> singleton_message_processor(0);
+  //Message_Processor::Holds in scope: ~Message_Processor waits for them before it tears the Message_Processor down
+  std::atomic<int> processor_holds(0);
 #define MESSAGE_PROCESSOR_VERBOSITY re_gen::VERBOSITY_EVERYTHING
 };//anonymous namespace
 
@@ -62,79 +409,736 @@ namespace re_gen {
  */
 class Message_Processor::Impl {
 public:
-  bool we_are_dead;
-  bool is_processing;
+  std::atomic<bool> we_are_dead;
+  std::atomic<bool> is_processing;
   int message_processor_src_id;
   Message_Queue message_queue;
+  Urgent_Queue urgent_queue;
   pthread_t impl_thread;
   Message_Processor *message_processor;
-  Message_Source_Name_Map message_source_name_map;
-  Message_Source_Verbosity_Map message_source_verbosity_map;
-  Verbosity_Level overall_verbosity;
+  Msg_Src_Table msg_srcs;
+  Msg_Counters counters;
+  Overflow_Policy overflow_policy;
+  unsigned long reported_drop_count;
+  time_t last_drop_report;
+  unsigned long generation;
+  std::atomic<Staging_Buffer *> staging_list;
+  std::atomic<Crash_Ring *> crash_ring;
+  std::atomic<int> crash_writers;      //producers that may be writing to the crash ring
+  std::atomic<bool> closing;
+  std::atomic<bool> consumer_parked;
+  bool doorbell_rung;
+  pthread_mutex_t doorbell_mutex;
+  pthread_cond_t doorbell_cond;
+  std::atomic<int> flush_verbosity;
+  std::atomic<unsigned long> flush_interval_ms;
+  std::atomic<bool> coalescing;
+  std::atomic<unsigned long> controls_issued;
+  std::atomic<unsigned long> stats_report_ms;
+  std::atomic<int> stats_report_verbosity;
+  std::atomic<Msg_Processor_Stats *> final_stats;
+  //published by the Message_Processor thread, for stats
+  std::atomic<unsigned long long> bytes_written;
+  std::atomic<unsigned long long> latency_histogram[MSG_LATENCY_BUCKETS];
+  //the rest is only touched by the Message_Processor thread
+  Msg_Clock clock;
+  int timestamp_columns;
+  Message_Sink *sink;
+  unsigned long long last_flush;
+  bool unflushed;
+  bool urgent_flush;
+  unsigned long long last_suppression_report;
+  unsigned long controls_collected;
+  unsigned long long retired_bytes;    //written by sinks that have since been replaced
+  unsigned long long last_stats_report;
+  Msg_Processor_Stats reported_stats;  //as they were at the last stats report
+  std::string msg_text;                //the text of the message being emitted; kept, so its buffer is reused
+  //the last message written, while coalescing
+  bool have_last;
+  int last_src;
+  unsigned long last_tid;
+  Verbosity_Level last_severity;
+  unsigned long long last_stamp;
+  std::string last_msg;
+  unsigned long repeats;
+  Lane_Sweep normal_sweep;             //see collect
+  Lane_Sweep urgent_sweep;
 
 //* Message_Processor::Impl::Impl
 /*
  * @brief constructor for class Message_Processor::Impl
  */
-Impl(Verbosity_Level _overall_verbosity, Message_Processor *_message_processor) :
-  we_are_dead(false), is_processing(false), message_processor(_message_processor), message_queue(),
-  message_source_name_map(), message_source_verbosity_map(), overall_verbosity(_overall_verbosity) {
-  message_processor_src_id = 0;
-  message_source_name_map[message_processor_src_id] = "Message_Processor";
-  message_source_verbosity_map[message_processor_src_id] = MESSAGE_PROCESSOR_VERBOSITY;
+Impl(Verbosity_Level _overall_verbosity, Overflow_Policy _overflow_policy, Message_Processor *_message_processor) :
+  we_are_dead(false), is_processing(false), message_processor(_message_processor), message_queue(_overflow_policy),
+  urgent_queue(_overflow_policy),
+  msg_srcs(_overall_verbosity), counters(),
+  overflow_policy(_overflow_policy), reported_drop_count(0), last_drop_report(0), generation(++impl_generations),
+  staging_list(0), crash_ring(0), crash_writers(0), closing(false), consumer_parked(false), doorbell_rung(false), flush_verbosity(VERBOSITY_ERRORS),
+  flush_interval_ms(0), coalescing(false), controls_issued(0), stats_report_ms(0), stats_report_verbosity(VERBOSITY_MINOR_STEPS),
+  final_stats(0),
+  bytes_written(0), clock(), timestamp_columns(TIMESTAMP_NONE), sink(new Stderr_Sink), last_flush(0), unflushed(false), urgent_flush(false),
+  last_suppression_report(0), controls_collected(0), retired_bytes(0), last_stats_report(0), reported_stats(), msg_text(), have_last(false), last_src(0), last_tid(0), last_severity(VERBOSITY_QUIET), last_stamp(0), last_msg(),
+  repeats(0), normal_sweep(), urgent_sweep() {
+  for (int bucket = 0; bucket < MSG_LATENCY_BUCKETS; ++bucket)
+    latency_histogram[bucket].store(0, std::memory_order_relaxed);
+  pthread_mutex_init(&doorbell_mutex, 0);
+  re_queue_helpers::init_monotonic_cond(&doorbell_cond);
+  message_processor_src_id = msg_srcs.register_src(MESSAGE_PROCESSOR_VERBOSITY, "Message_Processor");
   if (pthread_create(&impl_thread, 0, run, this) != 0) {
     if (MESSAGE_PROCESSOR_VERBOSITY >= VERBOSITY_ERRORS && _overall_verbosity >= VERBOSITY_ERRORS)
-      std::cerr << msg_prefixes[VERBOSITY_ERRORS] << "Impl::Impl - error in pthread_mutex_init\n" << std::flush;
+      std::cerr << Message_Renderer::severity_prefix(VERBOSITY_ERRORS) << "Impl::Impl - error in pthread_mutex_init\n" << std::flush;
+    pthread_mutex_destroy(&doorbell_mutex);
+    pthread_cond_destroy(&doorbell_cond);
+    delete sink;
     throw Gen_Err("error in pthread_mutex_init");
   }
 }
 
+//* Message_Processor::Impl::~Impl
+/*
+ * @brief destructor for class Message_Processor::Impl
+ * @remarks closing wakes the Message_Processor thread, which displays whatever is still queued and then exits; so we just join it.
+ * our own last words are queued with the rest, so they reach the sink before it's flushed and deleted.
+ */
 ~Impl() {
-  Message_Parms kill_msg(ACTION_DISPLAY_MSG, pthread_self(), message_processor_src_id, VERBOSITY_MINOR_STEPS, "killing message processor");
-  Message_Parms kill_act(ACTION_KILL,        pthread_self(), message_processor_src_id, VERBOSITY_QUIET, "");
-  message_queue.push(kill_msg);
-  message_queue.push(kill_act);
-  //wait for thread to die
-  for (int i = 0; !we_are_dead && i < 10; ++i) {
-    //10 mS
-    timeval timeout = {0, 100000};
-    select(0, 0, 0, 0, &timeout);
-  }
-  std::string msg_to_display;
-  Message_Parms message_parms(ACTION_DISPLAY_MSG, pthread_self(), message_processor_src_id, VERBOSITY_EVERYTHING, "Impl::~Impl");
-  if (make_msg_to_display(message_parms, &msg_to_display))
-    std::cerr << msg_to_display << std::endl;
-}
-
-//* Message_Processor::Impl::organize_importance_source_msg
-/*
- * @brief organize the importance-prefix, source-prefix, and actual_msg in a message string
- * @return int - nz ==> msg should be displayed (vis-a-vis verbosity level); z ==> msg is below verbosity level - don't display
- */
-bool make_msg_to_display(const Message_Parms &message_parms, std::string *const msg_to_display) {
-  std::ostringstream oss("");
-  std::string msg_src_str("");
-  Message_Source_Name_Map::iterator pos = message_source_name_map.find(message_parms.src);
-  if (pos != message_source_name_map.end()) {
-    std::ostringstream src_oss;
-    src_oss << pos->second;
-    //if message starts with '::', then source string is a class name, and the message starts with a member function name, so no hyphin
-    if (message_parms.msg.substr(0, 2) != "::")
-      src_oss << " - ";
-    msg_src_str.assign(src_oss.str());
-  }
-  //we only display the message prefix on messages that are not quiet. quiet messages are those that are displayed as part of normal
-  //program output; and they are displayed verbatum.
-  if (message_parms.severity == VERBOSITY_QUIET) {
-    oss << message_parms.msg;
-  } else {
-    oss << "[" << std::setw(2) << message_parms.tid << "] " << msg_prefixes[message_parms.severity] << " " << msg_src_str << message_parms.msg;
-    //no linefeed in case of a ticker message
-    if (message_parms.msg.rfind(" .") != message_parms.msg.size() - 2)
-      oss << std::endl;
-  }
-  msg_to_display->assign(oss.str());
-  return((message_parms.severity <= message_source_verbosity_map[message_parms.src] && message_parms.severity <= overall_verbosity) ? true : false);
+  //control messages must never be dropped
+  message_queue.push(Message_Parms(ACTION_DISPLAY_MSG, pthread_self(), message_processor_src_id, VERBOSITY_MINOR_STEPS, "killing message processor"),
+                     OVERFLOW_BLOCK);
+  message_queue.push(Message_Parms(ACTION_DISPLAY_MSG, pthread_self(), message_processor_src_id, VERBOSITY_EVERYTHING, "Impl::~Impl"),
+                     OVERFLOW_BLOCK);
+  message_queue.close();
+  urgent_queue.close();
+  closing = true;
+  {
+    re_queue_helpers::lock l(doorbell_mutex);
+    doorbell_rung = true;
+    pthread_cond_signal(&doorbell_cond);
+  }
+  pthread_join(impl_thread, 0);
+  Msg_Processor_Stats *const last_stats = final_stats.load();
+  if (last_stats != 0)
+    stats(last_stats);
+  for (Staging_Buffer *buffer = staging_list.load(std::memory_order_acquire); buffer != 0; ) {
+    Staging_Buffer *next = buffer->next;
+    release_staging_buffer(buffer);
+    buffer = next;
+  }
+  pthread_mutex_destroy(&doorbell_mutex);
+  pthread_cond_destroy(&doorbell_cond);
+  //a thread may still be issuing a message: take the crash ring away, and wait for any writer that already has it
+  Crash_Ring *const ring = crash_ring.exchange(0);
+  while (crash_writers.load() != 0)
+    sched_yield();
+  delete ring;
+}
+
+//* Message_Processor::Impl::staging_buffer
+/*
+ * @brief the calling thread's staging buffer, which is registered the first time the thread issues a message
+ * @remarks each producer thread puts its messages in its own single-producer / single-consumer ring, so that issuing a message
+ * shares nothing with any other producer. the buffers are kept on a list that producers push onto (with a compare-and-swap)
+ * and that only the Message_Processor thread walks and prunes.
+ */
+Staging_Buffer *staging_buffer(void) {
+  Staging_Buffer *buffer = staging_handle.buffer;
+  if (buffer != 0 && buffer->generation == generation)
+    return(buffer);
+  if (buffer != 0) {
+    //left over from a Message_Processor that has since been destroyed
+    buffer->orphaned.store(true, std::memory_order_release);
+    release_staging_buffer(buffer);
+  }
+  buffer = new Staging_Buffer(generation);
+  buffer->next = staging_list.load(std::memory_order_relaxed);
+  while (!staging_list.compare_exchange_weak(buffer->next, buffer, std::memory_order_release, std::memory_order_relaxed))
+    ;
+  staging_handle.buffer = buffer;
+  return(buffer);
+}
+
+//* Message_Processor::Impl::enqueue
+/*
+ * @brief put a message in the calling thread's staging buffer or, if that is full, in the shared message queue
+ * @remarks the message record is constructed in place; msg is only consumed by whichever of the two takes it.
+ * @remarks there are two lanes, each with its own staging rings and shared queue: urgent (errors and quiet messages) and normal.
+ * the Message_Processor thread services the urgent lane first, and checks it again every URGENT_CHECK_INTERVAL normal messages,
+ * so an error isn't held up behind a backlog of debug messages; and since the lanes fill up separately, a flood of debug
+ * messages that overflows the normal lane doesn't cost any errors.
+ */
+template <typename Msg_T>
+bool enqueue(Action action, int msg_src_id, Verbosity_Level severity, Msg_T &&msg) {
+  if (!msg_srcs.admit(msg_src_id)) {
+    counters.add(msg_src_id, Msg_Counters::RATE_LIMITED);
+    return(false);
+  }
+  if (crash_ring.load(std::memory_order_relaxed) != 0) {
+    //announce ourselves before we take the ring, so that ~Impl can't unmap it while we write (see ~Impl)
+    crash_writers.fetch_add(1);
+    Crash_Ring *const ring = crash_ring.load();
+    if (ring != 0)
+      record_crash(ring, msg_src_id, severity, msg);
+    crash_writers.fetch_sub(1, std::memory_order_release);
+  }
+  Staging_Buffer *buffer = staging_buffer();
+  bool queued = is_urgent(severity) ?
+    enqueue_in_lane(buffer->urgent_ring, urgent_queue, action, msg_src_id, severity, std::forward<Msg_T>(msg)) :
+    enqueue_in_lane(buffer->ring, message_queue, action, msg_src_id, severity, std::forward<Msg_T>(msg));
+  ring_doorbell();
+  counters.add(msg_src_id, queued ? Msg_Counters::ISSUED : Msg_Counters::DROPPED);
+  return(queued);
+}
+
+template <typename Ring_T, typename Queue_T, typename Msg_T>
+static bool enqueue_in_lane(Ring_T &ring, Queue_T &queue, Action action, int msg_src_id, Verbosity_Level severity, Msg_T &&msg) {
+  return(ring.try_emplace(action, pthread_self(), msg_src_id, severity, std::forward<Msg_T>(msg)) ||
+	 queue.emplace(action, pthread_self(), msg_src_id, severity, std::forward<Msg_T>(msg)));
+}
+
+//* Message_Processor::Impl::record_crash
+/*
+ * @brief copy a message into the crash ring, as a self-contained binary log record
+ * @remarks this is done on the producer thread, before the message is queued, so that the ring has everything that was issued
+ * up to the moment the process died - including what was still queued.
+ */
+void record_crash(Crash_Ring *ring, int msg_src_id, Verbosity_Level severity, const std::string &msg) {
+  record_crash(ring, msg_src_id, severity, msg.data(), msg.size());
+}
+
+void record_crash(Crash_Ring *ring, int msg_src_id, Verbosity_Level severity, const char *msg) {
+  record_crash(ring, msg_src_id, severity, msg, strlen(msg));
+}
+
+void record_crash(Crash_Ring *ring, int msg_src_id, Verbosity_Level severity, const char *msg, size_t msg_len) {
+  crash_record.clear();
+  Message_Encoder::encode_standalone(now_ns(), pthread_self(), msg_src_id, msg_srcs.name(msg_src_id), severity, msg, msg_len,
+                                     &crash_record);
+  ring->append(crash_record.data(), crash_record.size());
+}
+
+void record_crash(Crash_Ring *ring, int msg_src_id, Verbosity_Level severity, const Fmt_Args &fmt_args) {
+  crash_record.clear();
+  Message_Encoder::encode_standalone(now_ns(), pthread_self(), msg_src_id, msg_srcs.name(msg_src_id), severity, fmt_args,
+                                     &crash_record);
+  ring->append(crash_record.data(), crash_record.size());
+}
+
+//control messages must never be dropped, so if the staging buffer is full we wait for room in the shared queue. they're only
+//lost once we're closing; a control is counted in controls_issued once it's queued, and a sink that couldn't be handed over is
+//deleted here
+bool enqueue_control(Action action, const Fmt_Args &args) {
+  bool queued = !closing.load() &&
+    (staging_buffer()->ring.try_emplace(action, pthread_self(), message_processor_src_id, VERBOSITY_QUIET, args) ||
+     message_queue.push(Message_Parms(action, pthread_self(), message_processor_src_id, VERBOSITY_QUIET, args), OVERFLOW_BLOCK));
+  if (!queued) {
+    if (action == ACTION_SET_SINK)
+      delete static_cast<Message_Sink *>(const_cast<void *>(args.args[0].value.p));
+    return(false);
+  }
+  controls_issued.fetch_add(1, std::memory_order_release);
+  ring_doorbell();
+  return(true);
+}
+
+//* Message_Processor::Impl::ring_doorbell
+/*
+ * @brief wake the Message_Processor thread, if it is parked
+ * @remarks the fence orders the producer's ring update before its check of consumer_parked; the consumer sets consumer_parked
+ * before it checks the rings for the last time; so either we see that it is parked, or it sees our message.
+ */
+void ring_doorbell(void) {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (consumer_parked.load(std::memory_order_relaxed)) {
+    re_queue_helpers::lock l(doorbell_mutex);
+    doorbell_rung = true;
+    pthread_cond_signal(&doorbell_cond);
+  }
+}
+
+//* Message_Processor::Impl::wait_for_doorbell
+/*
+ * @brief park the Message_Processor thread until a producer issues a message (or the Message_Processor is being destroyed), or
+ * until the deadline, if there is one
+ */
+void wait_for_doorbell(const timespec *deadline = 0) {
+  consumer_parked.store(true, std::memory_order_seq_cst);
+  {
+    re_queue_helpers::lock l(doorbell_mutex);
+    if (!anything_pending()) {
+      //loop to catch spurious wake ups
+      while (!doorbell_rung) {
+	if (deadline == 0)
+	  pthread_cond_wait(&doorbell_cond, &doorbell_mutex);
+	else if (pthread_cond_timedwait(&doorbell_cond, &doorbell_mutex, deadline) == ETIMEDOUT)
+	  break;
+      }
+    }
+    doorbell_rung = false;
+  }
+  consumer_parked.store(false, std::memory_order_relaxed);
+}
+
+bool anything_pending(void) {
+  if (message_queue.depth() != 0 || urgent_queue.depth() != 0 || holding_back())
+    return(true);
+  for (Staging_Buffer *buffer = staging_list.load(std::memory_order_acquire); buffer != 0; buffer = buffer->next) {
+    if (!buffer->ring.empty() || !buffer->urgent_ring.empty())
+      return(true);
+  }
+  return(false);
+}
+
+//* Message_Processor::Impl::collect
+/*
+ * @brief take the pending messages out of every staging buffer, and out of the shared message queue, in the order in which
+ * they were issued
+ * @remarks each ring is already in order, so sorting on the time stamp (see release) merges them without disturbing any one
+ * thread's sequence.
+ * @remarks a message stamped after the sweep began is held back until the next collect: while we sweep one ring, a thread whose
+ * ring we've already swept can issue a message that belongs ahead of it, and that message only turns up next time. what can
+ * still come out of order is a message that was stamped before the sweep began but reached its ring after we'd swept it - the
+ * window is the few instructions between taking the stamp and publishing the message.
+ * @remarks we empty each ring, and take what was in the shared queue before we started, so a batch can hold up to
+ * (threads * STAGING_RING_SIZE) + Message_Queue capacity messages.
+ * @remarks this is also where we prune the buffers of threads that have exited.
+ * @remarks collect takes the normal lane; collect_urgent takes the urgent lane in the same way, and appends to batch after any
+ * urgent messages that are still waiting there.
+ */
+size_t collect(std::vector<Message_Parms> &batch) {
+  const unsigned long long cutoff = Msg_Clock::ticks();
+  size_t runs = normal_sweep.pending.empty() ? 0 : 1;
+  //a thread whose ring was full put its message in the shared queue instead. we only take what was queued before we sweep the
+  //rings: the thread's earlier messages were in its ring by then, so they're in this sweep too, and the sort puts them first.
+  //(a message queued after we swept its thread's ring could be ahead of ring messages that we've missed.)
+  const size_t queued = message_queue.push_position();
+  Staging_Buffer *prev = 0;
+  for (Staging_Buffer *buffer = staging_list.load(std::memory_order_acquire); buffer != 0; ) {
+    Staging_Buffer *next = buffer->next;
+    //read orphaned before we drain the ring; if it was set, the producer won't add to the ring again
+    bool orphaned = buffer->orphaned.load(std::memory_order_acquire);
+    if (buffer->ring.try_pop_batch(std::back_inserter(normal_sweep.pending), STAGING_RING_SIZE) != 0)
+      ++runs;
+    if (orphaned && buffer->ring.empty() && buffer->urgent_ring.empty()) {
+      unlink_staging_buffer(prev, buffer);
+      release_staging_buffer(buffer);
+    } else {
+      prev = buffer;
+    }
+    buffer = next;
+  }
+  if (message_queue.try_pop_batch_until(std::back_inserter(normal_sweep.pending), queued) != 0)
+    ++runs;
+  release(normal_sweep, runs, cutoff, batch);
+  return(batch.size());
+}
+
+size_t collect_urgent(std::vector<Message_Parms> &batch) {
+  const unsigned long long cutoff = Msg_Clock::ticks();
+  size_t runs = urgent_sweep.pending.empty() ? 0 : 1;
+  const size_t queued = urgent_queue.push_position();
+  for (Staging_Buffer *buffer = staging_list.load(std::memory_order_acquire); buffer != 0; buffer = buffer->next) {
+    if (buffer->urgent_ring.try_pop_batch(std::back_inserter(urgent_sweep.pending), URGENT_RING_SIZE) != 0)
+      ++runs;
+  }
+  if (urgent_queue.try_pop_batch_until(std::back_inserter(urgent_sweep.pending), queued) != 0)
+    ++runs;
+  release(urgent_sweep, runs, cutoff, batch);
+  return(batch.size());
+}
+
+//* Message_Processor::Impl::release
+/*
+ * @brief append the messages in sweep.pending that were stamped before cutoff to batch, in stamp order, and keep the rest back
+ * @remarks runs is the number of ordered runs that pending is made of; with just one there's nothing to sort.
+ */
+void release(Lane_Sweep &sweep, size_t runs, unsigned long long cutoff, std::vector<Message_Parms> &batch) {
+  if (sweep.pending.empty())
+    return;
+  sweep.order.clear();
+  for (size_t i = 0; i < sweep.pending.size(); ++i)
+    sweep.order.push_back(std::make_pair(sweep.pending[i].stamp, i));
+  if (runs > 1)
+    std::sort(sweep.order.begin(), sweep.order.end());
+  size_t n = 0;
+  for (; n < sweep.order.size() && sweep.order[n].first < cutoff; ++n)
+    batch.push_back(std::move(sweep.pending[sweep.order[n].second]));
+  sweep.held.clear();
+  for (size_t i = n; i < sweep.order.size(); ++i)
+    sweep.held.push_back(std::move(sweep.pending[sweep.order[i].second]));
+  sweep.pending.clear();
+  sweep.pending.swap(sweep.held);
+}
+
+bool holding_back(void) const {
+  return(!normal_sweep.pending.empty() || !urgent_sweep.pending.empty());
+}
+
+//producers only ever push onto the head of the list, so the head is the only link we can race them for
+void unlink_staging_buffer(Staging_Buffer *prev, Staging_Buffer *buffer) {
+  if (prev == 0) {
+    Staging_Buffer *expected = buffer;
+    if (staging_list.compare_exchange_strong(expected, buffer->next, std::memory_order_acq_rel))
+      return;
+    //somebody pushed a new buffer in front of us
+    for (prev = expected; prev->next != buffer; prev = prev->next)
+      ;
+  }
+  prev->next = buffer->next;
+}
+
+//* Message_Processor::Impl::accepts
+/*
+ * @return true if a message is at or above both the overall verbosity, and its source's verbosity
+ * @remarks the two are combined in the source's effective verbosity whenever either changes, so this is one relaxed load. a
+ * change of verbosity is seen by the other threads soon, rather than at once - which is all a verbosity setting needs.
+ */
+bool accepts(int msg_src_id, Verbosity_Level severity) const {
+  return(msg_srcs.valid(msg_src_id) && severity <= msg_srcs.effective_verbosity(msg_src_id));
+}
+
+void count_filtered(int msg_src_id) {
+  if (msg_srcs.valid(msg_src_id))
+    counters.add(msg_src_id, Msg_Counters::FILTERED);
+}
+
+bool should_display(const Message_Parms &message_parms) const {
+  return(accepts(message_parms.src, message_parms.severity));
+}
+
+const std::string *source_name(int src) const {
+  return(msg_srcs.name(src));
+}
+
+//* Message_Processor::Impl::emit
+/*
+ * @brief hand a message to the sink, if it should be displayed
+ */
+void emit(Message_Parms &message_parms) {
+  //the verbosity may have changed since the message was issued
+  if (!should_display(message_parms)) {
+    count_filtered(message_parms.src);
+    return;
+  }
+  const unsigned long long stamp = clock.to_ns(message_parms.stamp);
+  //a deferred message is formatted into msg_text (by the sink, if it wants the text)
+  const bool deferred = message_parms.action == ACTION_DISPLAY_FMT;
+  if (!deferred)
+    message_parms.payload.copy_to(&msg_text);
+  Sink_Msg sink_msg(stamp, message_parms.tid, message_parms.src, source_name(message_parms.src), message_parms.severity,
+                    deferred ? &message_parms.fmt_args() : 0, &msg_text);
+  const unsigned long long now = clock.now_ns();
+  sink_msg.latency_ns = now > stamp ? now - stamp : 0;
+  if (coalesce(sink_msg))
+    return;
+  std::atomic<unsigned long long> &bucket = latency_histogram[latency_bucket(sink_msg.latency_ns)];
+  bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  msg_srcs[message_parms.src].written.fetch_add(1, std::memory_order_relaxed);
+  write(sink_msg);
+}
+
+void write(const Sink_Msg &sink_msg) {
+  sink->write(sink_msg);
+  unflushed = true;
+  //flushed at the end of the batch, so that a burst of errors still makes just one write
+  if (sink_msg.severity <= flush_verbosity.load(std::memory_order_relaxed))
+    urgent_flush = true;
+}
+
+void emit(Verbosity_Level severity, const std::string &msg) {
+  Message_Parms message_parms(ACTION_DISPLAY_MSG, pthread_self(), message_processor_src_id, severity, msg);
+  emit(message_parms);
+}
+
+//* Message_Processor::Impl::coalesce
+/*
+ * @brief while coalescing, swallow a message that repeats the last one written (same source, thread, severity and text)
+ * @return true if the message was swallowed
+ * @remarks the repeats are counted, and written as one "last message repeated N times" line when a different message comes
+ * along, or when the sink is flushed - so a flood of one message costs one line per flush. tickers are left to the renderer,
+ * which already folds them into one line.
+ */
+bool coalesce(const Sink_Msg &sink_msg) {
+  if (!coalescing.load(std::memory_order_relaxed)) {
+    write_repeats();
+    have_last = false;
+    return(false);
+  }
+  const std::string &text = sink_msg.text();
+  if (have_last && sink_msg.src == last_src && sink_msg.tid == last_tid && sink_msg.severity == last_severity && text == last_msg) {
+    ++repeats;
+    last_stamp = sink_msg.stamp;
+    msg_srcs[sink_msg.src].coalesced.fetch_add(1, std::memory_order_relaxed);
+    return(true);
+  }
+  write_repeats();
+  have_last = !Message_Renderer::is_ticker(text);
+  if (have_last) {
+    last_src = sink_msg.src;
+    last_tid = sink_msg.tid;
+    last_severity = sink_msg.severity;
+    last_stamp = sink_msg.stamp;
+    last_msg = text;
+  }
+  return(false);
+}
+
+void write_repeats(void) {
+  if (repeats == 0)
+    return;
+  std::ostringstream oss;
+  oss << "last message repeated " << repeats << (repeats == 1 ? " time" : " times");
+  std::string msg = oss.str();
+  repeats = 0;
+  write(Sink_Msg(last_stamp, last_tid, last_src, source_name(last_src), last_severity, 0, &msg));
+}
+
+//* Message_Processor::Impl::set_sink
+/*
+ * @brief flush and delete the old sink, and install the new one
+ * @remarks the new sink is told about all of the sources that are registered now.
+ */
+void set_sink(Message_Sink *new_sink) {
+  write_repeats();
+  sink->flush();
+  retired_bytes += sink->bytes_written();
+  delete sink;
+  sink = new_sink;
+  unflushed = false;
+  publish_bytes();
+  if (timestamp_columns != TIMESTAMP_NONE)
+    sink->set_timestamps(timestamp_columns);
+  for (int src = 0, n_srcs = msg_srcs.size(); src < n_srcs; ++src) {
+    const std::string *src_name = msg_srcs.name(src);
+    if (src_name != 0)
+      sink->add_source(src, *src_name);
+  }
+}
+
+void publish_bytes(void) {
+  bytes_written.store(retired_bytes + sink->bytes_written(), std::memory_order_relaxed);
+}
+
+//* Message_Processor::Impl::flush_now, flush_due
+/*
+ * @brief messages are flushed after a batch in which a message at or above flush_verbosity was written, when flush_interval_ms has
+ * passed since the last flush, and when we're asked to
+ */
+void flush_now(void) {
+  write_repeats();
+  sink->flush();
+  last_flush = now_ns();
+  unflushed = false;
+  urgent_flush = false;
+}
+
+bool flush_due(timespec *const deadline) {
+  unsigned long long due = last_flush + flush_interval_ms.load(std::memory_order_relaxed) * 1000000ULL;
+  deadline->tv_sec = due / 1000000000ULL;
+  deadline->tv_nsec = due % 1000000000ULL;
+  return(now_ns() >= due);
+}
+
+//* Message_Processor::Impl::report_drops
+/*
+ * @brief with OVERFLOW_DROP_AND_COUNT, display the number of messages dropped since the last report
+ * @remarks we wait until we've caught up with the backlog (or for at most a second) so that an overload produces one report,
+ * rather than one per message.
+ */
+void report_drops(void) {
+  if (overflow_policy != OVERFLOW_DROP_AND_COUNT)
+    return;
+  unsigned long drop_count = message_queue.dropped() + urgent_queue.dropped();
+  if (drop_count == reported_drop_count)
+    return;
+  time_t now = time(0);
+  if (message_queue.depth() + urgent_queue.depth() != 0 && now == last_drop_report)
+    return;
+  std::ostringstream oss;
+  oss << "Impl::run - queue overflow, dropped " << drop_count - reported_drop_count << " messages";
+  emit(VERBOSITY_ERRORS, oss.str());
+  reported_drop_count = drop_count;
+  last_drop_report = now;
+}
+
+//* Message_Processor::Impl::report_suppressions
+/*
+ * @brief display, for each source, the number of messages its rate limit has suppressed since the last report
+ * @return true if there are counts still to report, in which case deadline is when they will be
+ * @remarks a source that is being rate limited gets at most one report a second (unless force), so the report can't become a
+ * flood of its own.
+ */
+bool report_suppressions(bool force, timespec *const deadline) {
+  bool pending = false;
+  for (int src = 0, n_srcs = msg_srcs.size(); src < n_srcs && !pending; ++src)
+    pending = counters.sum(src, Msg_Counters::RATE_LIMITED) != msg_srcs[src].reported_rate_limited;
+  if (!pending)
+    return(false);
+  const unsigned long long due = last_suppression_report + 1000000000ULL;
+  const unsigned long long now = now_ns();
+  if (!force && now < due) {
+    deadline->tv_sec = due / 1000000000ULL;
+    deadline->tv_nsec = due % 1000000000ULL;
+    return(true);
+  }
+  for (int src = 0, n_srcs = msg_srcs.size(); src < n_srcs; ++src) {
+    Msg_Src_Table::Entry &entry = msg_srcs[src];
+    unsigned long rate_limited = counters.sum(src, Msg_Counters::RATE_LIMITED);
+    if (rate_limited == entry.reported_rate_limited)
+      continue;
+    const std::string *src_name = source_name(src);
+    std::ostringstream oss;
+    oss << "Impl::run - rate limit suppressed " << rate_limited - entry.reported_rate_limited << " messages from "
+        << (src_name != 0 ? *src_name : std::string("an unnamed source"));
+    emit(VERBOSITY_ERRORS, oss.str());
+    entry.reported_rate_limited = rate_limited;
+  }
+  last_suppression_report = now;
+  return(false);
+}
+
+//* Message_Processor::Impl::src_stats, stats
+/*
+ * @brief snapshots of the counters; callable from any thread
+ */
+void src_stats(int src, Msg_Src_Stats *const stats) {
+  Msg_Src_Table::Entry &entry = msg_srcs[src];
+  stats->issued = counters.sum(src, Msg_Counters::ISSUED);
+  stats->dropped = counters.sum(src, Msg_Counters::DROPPED);
+  stats->written = entry.written.load(std::memory_order_relaxed);
+  stats->rate_limited = counters.sum(src, Msg_Counters::RATE_LIMITED);
+  stats->coalesced = entry.coalesced.load(std::memory_order_relaxed);
+  stats->filtered = counters.sum(src, Msg_Counters::FILTERED);
+}
+
+void stats(Msg_Processor_Stats *const stats) {
+  stats->queue = message_queue.stats();
+  stats->urgent_queue = urgent_queue.stats();
+  stats->bytes_written = bytes_written.load(std::memory_order_relaxed);
+  for (int bucket = 0; bucket < MSG_LATENCY_BUCKETS; ++bucket)
+    stats->latency_histogram[bucket] = latency_histogram[bucket].load(std::memory_order_relaxed);
+  const int n_srcs = msg_srcs.size();
+  stats->src_names.resize(n_srcs);
+  stats->srcs.resize(n_srcs);
+  for (int src = 0; src < n_srcs; ++src) {
+    const std::string *src_name = msg_srcs.name(src);
+    stats->src_names[src] = src_name != 0 ? *src_name : std::string();
+    src_stats(src, &stats->srcs[src]);
+  }
+}
+
+//* Message_Processor::Impl::report_stats
+/*
+ * @brief every stats_report_ms, display a summary of the counters for the period since the last report
+ * @return true if reports are on, in which case deadline is when the next one is due
+ * @remarks a period in which no message was issued (or filtered, dropped or rate limited) isn't reported, so an idle program
+ * stays quiet.
+ */
+bool report_stats(timespec *const deadline) {
+  const unsigned long long interval = stats_report_ms.load(std::memory_order_relaxed) * 1000000ULL;
+  if (interval == 0)
+    return(false);
+  const unsigned long long now = now_ns();
+  if (last_stats_report == 0)
+    last_stats_report = now;
+  unsigned long long due = last_stats_report + interval;
+  if (now >= due) {
+    Msg_Processor_Stats current;
+    stats(&current);
+    Msg_Src_Stats total = Msg_Src_Stats(), reported = Msg_Src_Stats();
+    add_src_stats(current, &total);
+    add_src_stats(reported_stats, &reported);
+    if (total.issued != reported.issued || total.filtered != reported.filtered || total.dropped != reported.dropped ||
+        total.rate_limited != reported.rate_limited) {
+      unsigned long long latencies[MSG_LATENCY_BUCKETS];
+      for (int bucket = 0; bucket < MSG_LATENCY_BUCKETS; ++bucket)
+	latencies[bucket] = current.latency_histogram[bucket] - reported_stats.latency_histogram[bucket];
+      std::ostringstream oss;
+      oss << "Impl::run - in the last " << (now - last_stats_report) / 1000000ULL << " mS: issued " << total.issued - reported.issued
+	  << ", filtered " << total.filtered - reported.filtered << ", dropped " << total.dropped - reported.dropped
+	  << ", rate limited " << total.rate_limited - reported.rate_limited << ", coalesced " << total.coalesced - reported.coalesced
+	  << ", written " << total.written - reported.written << " (" << current.bytes_written - reported_stats.bytes_written
+	  << " bytes); latency p50 < " << round_up_duration(latency_percentile(latencies, 0.5)) << ", p99 < "
+	  << round_up_duration(latency_percentile(latencies, 0.99)) << "; queue high water " << current.queue.high_water << "/"
+	  << message_queue.capacity() << ", urgent " << current.urgent_queue.high_water << "/" << urgent_queue.capacity();
+      emit(static_cast<Verbosity_Level>(stats_report_verbosity.load(std::memory_order_relaxed)), oss.str());
+    }
+    reported_stats = current;
+    last_stats_report = now;
+    due = now + interval;
+  }
+  deadline->tv_sec = due / 1000000000ULL;
+  deadline->tv_nsec = due % 1000000000ULL;
+  return(true);
+}
+
+static void add_src_stats(const Msg_Processor_Stats &stats, Msg_Src_Stats *const total) {
+  for (size_t src = 0; src < stats.srcs.size(); ++src) {
+    total->issued += stats.srcs[src].issued;
+    total->dropped += stats.srcs[src].dropped;
+    total->written += stats.srcs[src].written;
+    total->rate_limited += stats.srcs[src].rate_limited;
+    total->coalesced += stats.srcs[src].coalesced;
+    total->filtered += stats.srcs[src].filtered;
+  }
+}
+
+//* Message_Processor::Impl::service
+/*
+ * @brief carry out the messages in [begin, end)
+ */
+void service(std::vector<Message_Parms>::iterator begin, std::vector<Message_Parms>::iterator end) {
+  for (std::vector<Message_Parms>::iterator it = begin; it != end; ++it) {
+    switch (it->action) {
+    case ACTION_DISPLAY_MSG:
+    case ACTION_DISPLAY_FMT:
+      emit(*it);
+      break;
+    case ACTION_SET_SINK:
+      set_sink(static_cast<Message_Sink *>(const_cast<void *>(it->fmt_args().args[0].value.p)));
+      break;
+    case ACTION_FLUSH:
+      flush_now();
+      break;
+    case ACTION_SET_TIMESTAMPS:
+      timestamp_columns = static_cast<int>(it->fmt_args().args[0].value.i);
+      sink->set_timestamps(timestamp_columns);
+      break;
+    default:
+      emit(VERBOSITY_ERRORS, "Impl::run - unknown action");
+      break;
+    }
+  }
+}
+
+//* Message_Processor::Impl::service_urgent
+/*
+ * @brief carry out the urgent messages that can go ahead of the normal messages [begin, end) that are still to be serviced
+ * @remarks an urgent message can overtake normal messages, but not a control message (set_sink, flush) that was issued before
+ * it - or else an error issued just after set_sink could go to the old sink. so urgent messages issued after the first control
+ * message in [begin, end) are held back (in urgent_batch) until it has been carried out; and if a control message has been
+ * issued that we haven't even collected yet (or we've collected one that its issuer hasn't counted yet), they're all held back.
+ * @remarks next_control caches the search for the first control message; it only ever moves forward through the batch.
+ */
+void service_urgent(std::vector<Message_Parms> &urgent_batch, std::vector<Message_Parms>::iterator begin,
+		    std::vector<Message_Parms>::iterator end, std::vector<Message_Parms>::iterator *const next_control) {
+  if (urgent_batch.empty())
+    return;
+  find_control(begin, end, next_control);
+  unsigned long long barrier = *next_control != end ? (*next_control)->stamp : ~0ULL;
+  if (controls_issued.load(std::memory_order_acquire) != controls_collected)
+    barrier = 0;
+  std::vector<Message_Parms>::iterator held = urgent_batch.begin();
+  while (held != urgent_batch.end() && held->stamp < barrier)
+    ++held;
+  service(urgent_batch.begin(), held);
+  urgent_batch.erase(urgent_batch.begin(), held);
+}
+
+void find_control(std::vector<Message_Parms>::iterator begin, std::vector<Message_Parms>::iterator end,
+		  std::vector<Message_Parms>::iterator *const next_control) {
+  if (*next_control < begin)
+    *next_control = begin;
+  while (*next_control != end && !is_control(**next_control))
+    ++*next_control;
 }
 
 static void *run(void *instance) {
@@ -146,77 +1150,77 @@ static void *run(void *instance) {
  * @brief the Message_Processor worker
  */
 void *loop(void) {
-  int tick_count(0);
-  std::string prev_msg("");
-  std::string msg_to_display;
-  int prev_tid(-1), prev_src(-1);
-  re_gen::Verbosity_Level prev_severity(VERBOSITY_ERRORS);
-  const std::string tick_string[]     = {"\b|", "\b/", "\b-", "\b\\"};
-  const std::string mod_tick_string[] = {"\b!", "\bX", "\b=", "\bV" };
+  std::vector<Message_Parms> batch, urgent_batch;
+  batch.reserve(STAGING_RING_SIZE);
+  urgent_batch.reserve(URGENT_RING_SIZE);
+  timespec flush_deadline, report_deadline, stats_deadline;
   do {
     try {
       is_processing = false;
-      Message_Parms message_parms = message_queue.pop();
+      //once we're closing, a sweep that comes up empty is the last one
+      bool last_sweep = closing;
+      batch.clear();
+      //urgent_batch keeps any messages that were held back last time
+      collect_urgent(urgent_batch);
+      if (collect(batch) == 0 && urgent_batch.empty()) {
+	if (last_sweep && !holding_back()) {
+	  we_are_dead = true;
+	  break;
+	}
+	bool reports_pending = report_suppressions(false, &report_deadline);
+	bool stats_pending = report_stats(&stats_deadline);
+	if (unflushed && flush_due(&flush_deadline)) {
+	  flush_now();
+	  publish_bytes();
+	  continue;
+	}
+	const timespec *deadline = unflushed ? &flush_deadline : 0;
+	if (reports_pending)
+	  deadline = earlier(deadline, &report_deadline);
+	if (stats_pending)
+	  deadline = earlier(deadline, &stats_deadline);
+	wait_for_doorbell(deadline);
+	continue;
+      }
       is_processing = true;
-      if (message_parms.action == ACTION_KILL) {
-	we_are_dead = true;
-      } else if (message_parms.action != ACTION_DISPLAY_MSG) {
-	Message_Parms err_message_parms(ACTION_DISPLAY_MSG, pthread_self(), message_processor_src_id, VERBOSITY_ERRORS, "Impl::run - unknown action");
-	if (make_msg_to_display(err_message_parms, &msg_to_display))
-	  std::cerr << msg_to_display;
-      } else if (make_msg_to_display(message_parms, &msg_to_display)) {
-	if (message_parms.msg.rfind(" .") == message_parms.msg.size() - 2) {
-	  //handle ticker messages
-	  if (tick_count != 0) {
-	    if (message_parms.src == prev_src && message_parms.tid == prev_tid) {
-	      //already ticking, same source
-	      if (message_parms.msg.compare(prev_msg)) {
-		//new message => display new message, and restart ticker
-		std::cerr << std::endl << msg_to_display << tick_string[0];
-		prev_msg = message_parms.msg;
-		tick_count = 1;
-	      } else {
-		//same message => just display a new tick mark
-		std::cerr << tick_string[tick_count++ & 3];
-	      }
-	    } else {
-	      //already ticking, new source => display modified ticker
-	      std::cerr << mod_tick_string[tick_count++ & 3];
-	    }
-	  } else {
-	    //first tick message => display message, start ticker
-	    std::cerr << msg_to_display << tick_string[0];
-	    prev_src = message_parms.src;
-	    prev_msg = message_parms.msg;
-	    prev_tid = message_parms.tid;
-	    tick_count = 1;
-	  }
-	} else { //if (message_parms.msg.rfind(" .") == message_parms.msg.size() - 2) ...
-	  //handle non-ticker (normal) messages
-	  if (tick_count != 0) {
-	    std::cerr << std::endl;
-	    tick_count = 0;
-	  } else if (prev_severity == VERBOSITY_QUIET && message_parms.severity != VERBOSITY_QUIET) {
-	    //this is an error message. if the previous message was not an error message, then we need might need to add a newline
-	    std::cerr << std::endl;
-	  }
-	  std::cerr << msg_to_display;
-	  prev_src = message_parms.src;
-	  prev_msg = message_parms.msg;
-	  prev_tid = message_parms.tid;
-	  prev_severity = message_parms.severity;
+      for (std::vector<Message_Parms>::iterator it = batch.begin(); it != batch.end(); ++it) {
+	if (is_control(*it))
+	  ++controls_collected;
+      }
+      std::vector<Message_Parms>::iterator next_control = batch.begin();
+      service_urgent(urgent_batch, batch.begin(), batch.end(), &next_control);
+      for (std::vector<Message_Parms>::iterator it = batch.begin(); it != batch.end(); ) {
+	std::vector<Message_Parms>::iterator next = it + std::min(static_cast<size_t>(batch.end() - it), URGENT_CHECK_INTERVAL);
+	if (!urgent_batch.empty()) {
+	  //stop after the control message that's holding them back
+	  find_control(it, batch.end(), &next_control);
+	  if (next_control < next)
+	    next = next_control + 1;
 	}
-      } //else if (make_msg_to_display(message_parms, &msg_to_display))
+	service(it, next);
+	it = next;
+	//errors that arrived while we were working through a backlog go straight out
+	collect_urgent(urgent_batch);
+	service_urgent(urgent_batch, it, batch.end(), &next_control);
+      }
+      report_drops();
+      report_suppressions(false, &report_deadline);
+      report_stats(&stats_deadline);
+      if (urgent_flush || (unflushed && flush_due(&flush_deadline)))
+	flush_now();
+      publish_bytes();
     } catch (...) {
-      Message_Parms err_message_parms(ACTION_DISPLAY_MSG, pthread_self(), message_processor_src_id, VERBOSITY_ERRORS, "Impl::run - unknown exception");
-      if (make_msg_to_display(err_message_parms, &msg_to_display))
-	std::cerr << msg_to_display;
+      emit(VERBOSITY_ERRORS, "Impl::run - unknown exception");
+      flush_now();
     }
   } while (!we_are_dead);
   is_processing = false;
-  Message_Parms err_message_parms(ACTION_DISPLAY_MSG, pthread_self(), message_processor_src_id, VERBOSITY_MINOR_STEPS, "Impl::run - exit");
-  if (make_msg_to_display(err_message_parms, &msg_to_display))
-    std::cerr << msg_to_display << std::endl;
+  report_suppressions(true, &report_deadline);
+  emit(VERBOSITY_MINOR_STEPS, "Impl::run - exit");
+  flush_now();
+  delete sink;
+  sink = 0;
+  return(0);
 }
 };//class Message_Processor::Impl
 
@@ -230,20 +1234,25 @@ void *loop(void) {
  * pointer later (in the Message_Processor destructor) to cancel the thread. note that if you initially assign the
  * Thread to a pointer, then it doesn't matter wether the initial pointer, or another survives the scope.
  */
-Message_Processor::Message_Processor(Verbosity_Level overall_verbosity) : pimpl(0) {
-  if (singleton_message_processor != 0)
+Message_Processor::Message_Processor(Verbosity_Level overall_verbosity, Overflow_Policy overflow_policy) : pimpl(0) {
+  if (singleton_message_processor.load() != 0)
     throw re_gen::Gen_Err("Message_Processor::get_message_processor - Message_Processor singleton already initialized");
   try {
-    singleton_message_processor = this;
-    pimpl = new Impl(overall_verbosity, this);
+    pimpl = new Impl(overall_verbosity, overflow_policy, this);
     process_msg(pimpl->message_processor_src_id, VERBOSITY_EVERYTHING, "::Message_Processor - started Message_Processor");
   } catch (...) {
     if (MESSAGE_PROCESSOR_VERBOSITY >= VERBOSITY_ERRORS && overall_verbosity >= VERBOSITY_ERRORS)
-      std::cerr << msg_prefixes[VERBOSITY_ERRORS] << "Message_Processor::Message_Processor - unknown exception\n" << std::flush;
+      std::cerr << Message_Renderer::severity_prefix(VERBOSITY_ERRORS) << "Message_Processor::Message_Processor - unknown exception\n" << std::flush;
     if (pimpl)
       delete pimpl;
     throw;
   }
+  //we're only published once we're whole; and if another was constructed meanwhile, it wins
+  Message_Processor *expected = 0;
+  if (!singleton_message_processor.compare_exchange_strong(expected, this)) {
+    delete pimpl;
+    throw re_gen::Gen_Err("Message_Processor::get_message_processor - Message_Processor singleton already initialized");
+  }
 }
 
 //* Message_Processor::~Message_Processor
@@ -252,12 +1261,33 @@ Message_Processor::Message_Processor(Verbosity_Level overall_verbosity) : pimpl(
  * @note the kill message never gets displayed, so first we send a status message.
  * @note before killing the message processor (ie. before program termination), it's a good idea to make sure that
  * the message processor has a little time to finsish up it's queued messages... try waiting until is_idle returns true.
+ * @note once it's gone, get_message_processor throws again (so code that looks it up goes quiet), and another can be constructed.
+ * @remarks the singleton is cleared first, so no new Hold can get this Message_Processor; then we wait for the Holds that already
+ * have it, and only then tear it down.
  */
 Message_Processor::~Message_Processor() {
+  Message_Processor *self = this;
+  singleton_message_processor.compare_exchange_strong(self, 0);
+  while (processor_holds.load() != 0)
+    sched_yield();
   if (pimpl)
     delete pimpl;
 }
 
+//* Message_Processor::Hold::Hold
+/*
+ * @brief count ourselves in processor_holds before we load the singleton, so that ~Message_Processor can't miss us (see
+ * ~Message_Processor)
+ */
+Message_Processor::Hold::Hold(void) : mp(0) {
+  processor_holds.fetch_add(1);
+  mp = singleton_message_processor.load();
+}
+
+Message_Processor::Hold::~Hold(void) {
+  processor_holds.fetch_sub(1, std::memory_order_release);
+}
+
 //* Message_Processor::set_overall_verbosity
 /*
  * @brief modify the overall verbosity
@@ -266,27 +1296,339 @@ Message_Processor::~Message_Processor() {
  * requires you to use a no-argument constructor.
  */
 void Message_Processor::set_overall_verbosity(Verbosity_Level overall_verbosity) {
-  pimpl->overall_verbosity = overall_verbosity;
+  pimpl->msg_srcs.set_overall_verbosity(overall_verbosity);
+}
+
+//* Message_Processor::find_msg_src
+/*
+ * @brief the id of the first message source registered as src_str, or -1 if there is none
+ * @remarks for code that may be set up many times (eg. a Thread_Pool) and should share one source rather than use up the table.
+ */
+int Message_Processor::find_msg_src(const std::string &src_str) const {
+  const int n_srcs = pimpl->msg_srcs.size();
+  for (int src = 0; src < n_srcs; ++src) {
+    const std::string *src_name = pimpl->msg_srcs.name(src);
+    if (src_name != 0 && *src_name == src_str)
+      return(src);
+  }
+  return(-1);
 }
 
+//* Message_Processor::register_msg_src
+/*
+ * @brief register a message source, and return its id
+ * @remarks any thread can register a source at any time, and concurrently with any other call.
+ */
 int Message_Processor::register_msg_src(Verbosity_Level verbosity, const std::string &src_str) {
-  int msg_src_id = pimpl->message_source_name_map.size();
-  pimpl->message_source_name_map[msg_src_id] = src_str;
-  pimpl->message_source_verbosity_map[msg_src_id] = verbosity;
+  int msg_src_id = pimpl->msg_srcs.register_src(verbosity, src_str);
+  if (msg_src_id < 0)
+    throw re_gen::Gen_Err("Message_Processor::register_msg_src - too many message sources");
   return(msg_src_id);
 }
 
-void Message_Processor::process_msg(int msg_src_id, Verbosity_Level severity, const std::string &msg_str) {
-  if (severity <= pimpl->overall_verbosity && severity <= pimpl->message_source_verbosity_map[msg_src_id]) {
-    Message_Parms message_parms(ACTION_DISPLAY_MSG, pthread_self(), msg_src_id, severity, msg_str);
-    pimpl->message_queue.push(message_parms);
+//* Message_Processor::set_msg_src_verbosity
+/*
+ * @brief change a message source's verbosity; takes effect for messages that are issued from now on
+ */
+void Message_Processor::set_msg_src_verbosity(int msg_src_id, Verbosity_Level verbosity) {
+  if (!pimpl->msg_srcs.valid(msg_src_id) || pimpl->msg_srcs.name(msg_src_id) == 0)
+    throw re_gen::Gen_Err("Message_Processor::set_msg_src_verbosity - unknown message source");
+  pimpl->msg_srcs.set_verbosity(msg_src_id, verbosity);
+}
+
+//* Message_Processor::msg_src_stats
+/*
+ * @brief the counts of messages from one source that have been queued, dropped, and displayed
+ * @return false if there is no such source
+ */
+bool Message_Processor::msg_src_stats(int msg_src_id, Msg_Src_Stats *const stats) const {
+  if (pimpl->msg_srcs.name(msg_src_id) == 0)
+    return(false);
+  pimpl->src_stats(msg_src_id, stats);
+  return(true);
+}
+
+//* Message_Processor::stats
+/*
+ * @brief a snapshot of all the counters: per source, for the shared queues, bytes output, and the latency histogram
+ * @remarks the counters are read one at a time, without stopping anybody, so they may be a message or two out with each other.
+ * the shared queues only take the messages that overflow the issuing threads' staging rings, so their high water marks show
+ * how close the Message_Processor came to dropping messages; bytes_written only counts output once a sink has flushed it.
+ */
+void Message_Processor::stats(Msg_Processor_Stats *const stats) const {
+  pimpl->stats(stats);
+}
+
+//* Message_Processor::set_stats_report
+/*
+ * @brief have the Message_Processor display a summary of its counters every interval_ms (0 - the default - turns it off)
+ * @remarks the summary covers the period since the last one: messages issued, filtered, dropped, rate limited, coalesced and
+ * written, bytes output, the median and 99th percentile latency from issue to write (to within a factor of two), and the
+ * queues' high water marks. it's displayed from the Message_Processor's own source, at severity; periods in which nothing was
+ * issued are skipped.
+ */
+void Message_Processor::set_stats_report(unsigned long interval_ms, Verbosity_Level severity) {
+  pimpl->stats_report_verbosity.store(severity, std::memory_order_relaxed);
+  pimpl->stats_report_ms.store(interval_ms, std::memory_order_relaxed);
+  pimpl->ring_doorbell();
+}
+
+//* Message_Processor::set_final_stats
+/*
+ * @brief have the destructor fill in *stats, after the Message_Processor thread has written everything that was queued and exited
+ * @remarks so that, once the Message_Processor is gone, each source's written + coalesced should equal its issued (the
+ * Message_Processor's own source excepted, since its shutdown messages aren't issued through the queue's front door). stats must
+ * outlive the Message_Processor; 0 (the default) turns it off.
+ */
+void Message_Processor::set_final_stats(Msg_Processor_Stats *const stats) {
+  pimpl->final_stats.store(stats);
+}
+
+//* format_stats_json function
+/*
+ * @brief append a Msg_Processor_Stats to out, as a JSON object
+ * @see message_processor.h
+ */
+void format_stats_json(const Msg_Processor_Stats &stats, std::string *const out) {
+  Msg_Src_Stats total = Msg_Src_Stats();
+  for (size_t src = 0; src < stats.srcs.size(); ++src) {
+    total.issued += stats.srcs[src].issued;
+    total.filtered += stats.srcs[src].filtered;
+    total.dropped += stats.srcs[src].dropped;
+    total.rate_limited += stats.srcs[src].rate_limited;
+    total.coalesced += stats.srcs[src].coalesced;
+    total.written += stats.srcs[src].written;
+  }
+  std::ostringstream oss;
+  oss << "{\"total\":";
+  json_src_stats(oss, total);
+  oss << ",\"srcs\":[";
+  bool first = true;
+  for (size_t src = 0; src < stats.srcs.size(); ++src) {
+    if (src >= stats.src_names.size() || stats.src_names[src].empty())
+      continue;
+    oss << (first ? "" : ",") << "{\"id\":" << src << ",\"name\":";
+    json_string(oss, stats.src_names[src]);
+    oss << ",\"stats\":";
+    json_src_stats(oss, stats.srcs[src]);
+    oss << "}";
+    first = false;
   }
+  oss << "],\"queue\":";
+  json_queue_stats(oss, stats.queue);
+  oss << ",\"urgent_queue\":";
+  json_queue_stats(oss, stats.urgent_queue);
+  oss << ",\"bytes_written\":" << stats.bytes_written << ",\"latency_ns\":{\"p50\":"
+      << latency_percentile(stats.latency_histogram, 0.5) << ",\"p90\":" << latency_percentile(stats.latency_histogram, 0.9)
+      << ",\"p99\":" << latency_percentile(stats.latency_histogram, 0.99) << ",\"p999\":"
+      << latency_percentile(stats.latency_histogram, 0.999) << ",\"histogram\":[";
+  for (int bucket = 0; bucket < MSG_LATENCY_BUCKETS; ++bucket)
+    oss << (bucket == 0 ? "" : ",") << stats.latency_histogram[bucket];
+  oss << "]}}";
+  out->append(oss.str());
+}
+
+//* Message_Processor::count_filtered_msg
+/*
+ * @brief count a message that was filtered out without being passed to process_msg; the MSG_PROCESS macros call this
+ */
+void Message_Processor::count_filtered_msg(int msg_src_id) {
+  pimpl->count_filtered(msg_src_id);
+}
+
+//* Message_Processor::set_msg_src_rate_limit
+/*
+ * @brief limit the rate at which a source's messages are queued
+ * @param msgs_per_sec - the sustained rate; 0 => no limit (the default).
+ * @param burst - the number of messages that can be queued at once, after the source has been quiet for a while.
+ * @remarks the limit is checked by the issuing thread, before the message is queued, so a hot loop can't flood the queue and hold
+ * up other sources' messages. process_msg returns false for a message that's over the limit. the Message_Processor displays
+ * the number of messages each source has had suppressed, at most once a second.
+ */
+void Message_Processor::set_msg_src_rate_limit(int msg_src_id, double msgs_per_sec, unsigned long burst) {
+  if (!pimpl->msg_srcs.valid(msg_src_id) || pimpl->msg_srcs.name(msg_src_id) == 0)
+    throw re_gen::Gen_Err("Message_Processor::set_msg_src_rate_limit - unknown message source");
+  pimpl->msg_srcs.set_rate_limit(msg_src_id, msgs_per_sec, burst);
+}
+
+//* Message_Processor::set_coalescing
+/*
+ * @brief turn coalescing of repeated messages on or off
+ * @remarks while it's on, a message that repeats the last one displayed (same source, thread, severity and text) isn't
+ * displayed again; instead the repeats are counted, and shown as "last message repeated N times" once a different message is
+ * displayed, or when the output is flushed. each message has to be formatted to be compared, so process_msg_fmt messages
+ * lose some of their advantage.
+ */
+void Message_Processor::set_coalescing(bool coalesce) {
+  pimpl->coalescing.store(coalesce, std::memory_order_relaxed);
+}
+
+//* Message_Processor::accepts_msg
+/*
+ * @brief would a message of this severity, from this source, be displayed?
+ * @remarks this is the check that process_msg makes; it's one relaxed atomic load. the MSG_PROCESS macros make it before they evaluate
+ * the message arguments, so a message that won't be displayed costs nothing more.
+ */
+bool Message_Processor::accepts_msg(int msg_src_id, Verbosity_Level severity) const {
+  return(pimpl->accepts(msg_src_id, severity));
+}
+
+//* Message_Processor::process_msg
+/*
+ * @brief queue a message for display
+ * @remarks the message record is constructed directly in its staging buffer slot, and the text is copied into the record's
+ * Msg_Payload (see msg_payload.h) - the first Msg_Payload::INLINE_TEXT bytes in the record, the rest in spill blocks. every overload
+ * copies the text once: the rvalue overload doesn't move the string (it's kept for the callers that use it), and the c-string
+ * overload never builds one. the price of the fixed-size records is memory: a record is about 290 bytes, and each producer
+ * thread's staging buffer holds 256 + 32 of them (the normal and urgent rings) - about 83 KB per thread that issues messages.
+ */
+bool Message_Processor::process_msg(int msg_src_id, Verbosity_Level severity, const std::string &msg_str) {
+  if (pimpl->accepts(msg_src_id, severity))
+    return(pimpl->enqueue(ACTION_DISPLAY_MSG, msg_src_id, severity, msg_str));
+  pimpl->count_filtered(msg_src_id);
+  return(true);
+}
+
+bool Message_Processor::process_msg(int msg_src_id, Verbosity_Level severity, std::string &&msg_str) {
+  if (pimpl->accepts(msg_src_id, severity))
+    return(pimpl->enqueue(ACTION_DISPLAY_MSG, msg_src_id, severity, std::move(msg_str)));
+  pimpl->count_filtered(msg_src_id);
+  return(true);
+}
+
+bool Message_Processor::process_msg(int msg_src_id, Verbosity_Level severity, const char *msg_str) {
+  if (pimpl->accepts(msg_src_id, severity))
+    return(pimpl->enqueue(ACTION_DISPLAY_MSG, msg_src_id, severity, msg_str));
+  pimpl->count_filtered(msg_src_id);
+  return(true);
+}
+
+//* Message_Processor::process_fmt_args
+/*
+ * @brief queue a captured format string and arguments; the message is formatted on the Message_Processor thread
+ * @remarks this is the back end of process_msg_fmt, which is what you'd normally call.
+ */
+bool Message_Processor::process_fmt_args(int msg_src_id, Verbosity_Level severity, const Fmt_Args &fmt_args) {
+  if (pimpl->accepts(msg_src_id, severity))
+    return(pimpl->enqueue(ACTION_DISPLAY_FMT, msg_src_id, severity, fmt_args));
+  pimpl->count_filtered(msg_src_id);
+  return(true);
+}
+
+//* Message_Processor::set_sink
+/*
+ * @brief send messages to a new sink from now on
+ * @remarks the switch is made by the Message_Processor thread, in turn with this thread's messages, so every message issued before
+ * the call goes to the old sink and every message issued after it goes to the new one. the Message_Processor owns the sink: it
+ * deletes it (after flushing it) when it's replaced, or when the Message_Processor is destroyed - or at once, if the
+ * Message_Processor is already shutting down.
+ */
+void Message_Processor::set_sink(Message_Sink *sink) {
+  Fmt_Args args;
+  capture_fmt_args(&args, 0, static_cast<const void *>(sink));
+  pimpl->enqueue_control(ACTION_SET_SINK, args);
+}
+
+//* Message_Processor::set_binary_log
+/*
+ * @brief write messages to a binary log file from now on, rather than displaying them on stderr
+ * @param file_name - the log file, which is truncated; or "" to go back to displaying messages on stderr.
+ * @return false if the file can't be opened, in which case nothing changes.
+ * @remarks this is shorthand for set_sink(new Binary_Log_Sink(file_name)) (or set_sink(new Stderr_Sink)).
+ * @see msg_decode, which turns a binary log back into the text that would have been displayed.
+ */
+bool Message_Processor::set_binary_log(const std::string &file_name) {
+  Message_Sink *sink;
+  try {
+    sink = file_name.empty() ? static_cast<Message_Sink *>(new Stderr_Sink) : new Binary_Log_Sink(file_name);
+  } catch (const Gen_Err &err) {
+    process_msg(pimpl->message_processor_src_id, VERBOSITY_ERRORS, std::string("::set_binary_log - ") + err.what());
+    return(false);
+  }
+  set_sink(sink);
+  return(true);
+}
+
+//* Message_Processor::set_crash_log
+/*
+ * @brief also copy every message into a crash ring: a circular log in a memory-mapped file, which survives the process dying
+ * @param file_name - the ring file; if it already holds a ring of this size, it's appended to.
+ * @param capacity - the size of the ring, in bytes; it holds the most recent messages that fit.
+ * @remarks each message is copied into the ring by the thread that issues it, as it's issued - without a system call - so the
+ * ring holds the messages that were still queued when the process died. read it with msg_crash_tail.
+ * @note the crash log can only be set once, and stays until the Message_Processor is destroyed.
+ * @throw Gen_Err if the file can't be mapped, or if there already is a crash log.
+ */
+void Message_Processor::set_crash_log(const std::string &file_name, size_t capacity) {
+  Crash_Ring *ring = new Crash_Ring(file_name, capacity);
+  Crash_Ring *expected = 0;
+  if (!pimpl->crash_ring.compare_exchange_strong(expected, ring, std::memory_order_acq_rel)) {
+    delete ring;
+    throw re_gen::Gen_Err("Message_Processor::set_crash_log - there already is a crash log");
+  }
+}
+
+//* Message_Processor::set_timestamps
+/*
+ * @brief show time stamp columns in front of each message from now on
+ * @param columns - Timestamp_Columns, or'd together; eg. TIMESTAMP_WALL | TIMESTAMP_LATENCY. TIMESTAMP_NONE (the default) turns
+ * them off.
+ * @remarks messages are always time stamped (when they're issued, with Msg_Clock - a single rdtsc on x86-64); this just says
+ * whether text sinks display the stamps. the conversion to wall clock time is done by the Message_Processor thread. the latency
+ * column is the time from when the message was issued to when the Message_Processor handed it to the sink. the setting is
+ * passed on to sinks installed later.
+ */
+void Message_Processor::set_timestamps(int columns) {
+  Fmt_Args args;
+  capture_fmt_args(&args, 0, columns);
+  pimpl->enqueue_control(ACTION_SET_TIMESTAMPS, args);
+}
+
+//* Message_Processor::set_flush_policy
+/*
+ * @brief say when the sink should be flushed
+ * @param flush_verbosity - flush as soon as a message at or above this level is written; eg. VERBOSITY_ERRORS (the default)
+ * flushes straight after each error. VERBOSITY_QUIET flushes after all quiet messages (ie. normal program output).
+ * @param flush_interval_ms - otherwise flush this long after the last flush. 0 (the default) flushes after each batch of
+ * messages; a file sink does far fewer, larger writes with an interval of, say, 1000.
+ */
+void Message_Processor::set_flush_policy(Verbosity_Level flush_verbosity, unsigned long flush_interval_ms) {
+  pimpl->flush_verbosity.store(flush_verbosity, std::memory_order_relaxed);
+  pimpl->flush_interval_ms.store(flush_interval_ms, std::memory_order_relaxed);
+  pimpl->ring_doorbell();
+}
+
+//* Message_Processor::flush
+/*
+ * @brief flush the sink, once it has been sent this thread's earlier messages
+ */
+void Message_Processor::flush(void) {
+  Fmt_Args args;
+  capture_fmt_args(&args, 0);
+  pimpl->enqueue_control(ACTION_FLUSH, args);
+}
+
+//* Message_Processor::queue_depth
+/*
+ * @brief the number of messages waiting to be displayed
+ */
+size_t Message_Processor::queue_depth(void) const {
+  return(pimpl->message_queue.depth() + pimpl->urgent_queue.depth());
+}
+
+//* Message_Processor::dropped_msg_count
+/*
+ * @brief the number of messages dropped because the queue was full, since the Message_Processor was constructed
+ */
+unsigned long Message_Processor::dropped_msg_count(void) const {
+  return(pimpl->message_queue.dropped() + pimpl->urgent_queue.dropped());
 }
 
 Message_Processor *Message_Processor::get_message_processor(void) {
-  if (singleton_message_processor == 0)
+  Message_Processor *const mp = singleton_message_processor.load();
+  if (mp == 0)
     throw re_gen::Gen_Err("Message_Processor::get_message_processor - Message_Processor singleton was never initialized");
-  return(singleton_message_processor);
+  return(mp);
 }
 };//namespace re_gen
 
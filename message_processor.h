@@ -5,8 +5,13 @@
 #ifndef __IF_MESSAGE_PROCESSOR__
 #define __IF_MESSAGE_PROCESSOR__
 #include <string>
+#include <vector>
+#include <utility>
 #include <unistd.h>
 #include <gen/gendefs.h>
+#include <gen/queue.h>
+#include <gen/message_format.h>
+#include <gen/message_sink.h>
 
 //* re_gen namespace
 /**
@@ -14,6 +19,59 @@
  */
 namespace re_gen {
 
+//the most message sources that can be registered (including the Message_Processor's own)
+const int MAX_MSG_SRCS = 256;
+//the latency histogram's buckets: bucket b counts messages written between 2^b and 2^(b+1) nS after they were issued (bucket 0
+//also counts 0 nS, and the last bucket everything slower)
+const int MSG_LATENCY_BUCKETS = 40;
+
+//messages that are less important than MESSAGE_VERBOSITY_FLOOR are compiled out by the MSG_PROCESS macros and by the *_at templates.
+//eg. build release code with -DMESSAGE_VERBOSITY_FLOOR=re_gen::VERBOSITY_MINOR_STEPS to drop debug messages altogether.
+#ifndef MESSAGE_VERBOSITY_FLOOR
+#define MESSAGE_VERBOSITY_FLOOR re_gen::VERBOSITY_EVERYTHING
+#endif
+
+template <Verbosity_Level Severity>
+struct Msg_Compiled_In {
+  static const bool value = (Severity <= MESSAGE_VERBOSITY_FLOOR);
+};
+
+//* struct Msg_Src_Stats
+/*
+ * @brief counts of one message source's messages
+ * @see Message_Processor::msg_src_stats
+ */
+struct Msg_Src_Stats {
+  unsigned long issued;   //queued for display
+  unsigned long dropped;  //discarded because the queue was full
+  unsigned long written;  //displayed, or written to the binary log
+  unsigned long rate_limited;  //discarded by the source's rate limit
+  unsigned long coalesced;     //folded into a "last message repeated N times" line
+  unsigned long filtered;      //below the source's (or the overall) verbosity
+};
+
+//* struct Msg_Processor_Stats
+/*
+ * @brief a snapshot of a Message_Processor's counters
+ * @see Message_Processor::stats
+ */
+struct Msg_Processor_Stats {
+  Queue_Stats queue;                    //the shared queue of the normal lane, which takes what overflows the staging rings
+  Queue_Stats urgent_queue;             //and of the urgent lane
+  unsigned long long bytes_written;     //output by the sinks, current and past
+  unsigned long long latency_histogram[MSG_LATENCY_BUCKETS];  //issue-to-write latency of the messages written
+  std::vector<std::string> src_names;   //indexed by source id
+  std::vector<Msg_Src_Stats> srcs;      //indexed by source id
+};
+
+//* format_stats_json function
+/*
+ * @brief append a Msg_Processor_Stats to out, as a JSON object
+ * @remarks the object has the totals over all sources, each source by name, both queues, bytes_written, the latency histogram
+ * (bucket b is [2^b, 2^(b+1)) nS) and the p50, p90, p99 and p999 latencies in nS (upper bounds, to within a factor of two).
+ */
+void format_stats_json(const Msg_Processor_Stats &stats, std::string *const out);
+
 //* Message_Processor class
 /*
  * @brief the Message_Processor encapulates a thread whose sole function is to display Messages
@@ -29,6 +87,57 @@ namespace re_gen {
  * to construction of the message processor are not displayed; and even if you subsequently set the verbosity to be noisy-er, you will miss those initial
  * messages.... just so you know...
  *
+ * @note a message's text is copied into a fixed-size record in the queue: up to Msg_Payload::INLINE_TEXT bytes in the record
+ * itself, and the rest in blocks from a pool that's shared by all threads and only ever grows (see msg_payload.h). so, once the
+ * pool has grown to fit the backlog, issuing a message allocates nothing - and the const char * overload doesn't even build a
+ * string. (the rvalue overload is kept, for callers that use it; the string is copied like any other.)
+ *
+ * @note process_msg_fmt is the cheapest way to issue a message: it captures a printf-style format string and up to MAX_FMT_ARGS
+ * arithmetic, enum or pointer arguments in a fixed-size record, and leaves all of the formatting to the Message_Processor thread.
+ * the format string, and any %s arguments, are captured by pointer, so they must outlive the message - use string literals.
+ * eg. mp->process_msg_fmt(src_id, VERBOSITY_MINOR_STEPS, "::poll - %d events in %.3f mS", n_events, elapsed_ms);
+ *
+ * @note to issue a message that might well be filtered out, use the MSG_PROCESS or MSG_PROCESS_FMT macro; eg.
+ * MSG_PROCESS(mp, src_id, VERBOSITY_EVERYTHING, "::poll - state " + state.to_string());
+ * the macros check the verbosity before the message arguments are evaluated, so a message that won't be displayed costs one
+ * atomic load (and the increment of a counter that no other thread touches); and if the severity is a constant below MESSAGE_VERBOSITY_FLOOR the whole thing compiles to nothing. the
+ * process_msg_at and process_msg_fmt_at templates are compiled out the same way, but their arguments are always evaluated.
+ *
+ * @note the message queue is bounded. overflow_policy says what process_msg does when the queue is full: OVERFLOW_BLOCK stalls the
+ * calling thread until the Message_Processor catches up; the other policies never stall it. with OVERFLOW_DROP_AND_COUNT (the
+ * default) the Message_Processor displays the number of dropped messages once it has caught up. process_msg returns false if the
+ * queue was full and the message was discarded (or if it was over its source's rate limit).
+ *
+ * @note errors (and quiet messages) have a lane of their own, which the Message_Processor services first; so an error is displayed
+ * promptly even behind a backlog of debug messages, and isn't dropped when the backlog overflows the queue. the price is that
+ * an error can be displayed ahead of less important messages that were issued before it; within each lane, messages are
+ * displayed in the order they were issued.
+ *
+ * @note messages are written to a Message_Sink - by default a Stderr_Sink. set_sink installs another: eg. a File_Sink (large
+ * buffer, rotation), a Memory_Sink (for tests), a Null_Sink (for benchmarks), or a Fan_Out_Sink, which writes to several sinks, each with its own verbosity.
+ * sinks buffer their output; set_flush_policy says when it's flushed (by default, straight after any error message, and
+ * otherwise after each batch of messages), and flush flushes it now.
+ *
+ * @note every message is time stamped as it's issued, with a cheap clock (see Msg_Clock); set_timestamps displays the stamps, as
+ * wall clock time and/or CLOCK_MONOTONIC seconds, and/or the latency from issue to output.
+ *
+ * @note set_binary_log sends messages to a compact binary log file instead of stderr. the file holds each source name and format
+ * string just once, and process_msg_fmt arguments unformatted; the msg_decode tool turns it back into exactly the text that would
+ * have been displayed.
+ *
+ * @note set_crash_log has every message copied, as it is issued, into a memory-mapped ring file; if the process crashes, the last
+ * messages (including any that were still queued) can be recovered from it with the msg_crash_tail tool.
+ *
+ * @note to keep a noisy source from flooding the queue, set_msg_src_rate_limit gives it a token bucket: messages over the limit
+ * are discarded by the issuing thread, and the number discarded is displayed (at most once a second). set_coalescing folds
+ * runs of identical messages into a single "last message repeated N times" line.
+ *
+ * @note stats takes a snapshot of the counters: per source (issued, filtered, dropped, rate limited, coalesced, written), for
+ * the shared queues, bytes output, and a histogram of the latency from issue to write. the counters that producer threads bump
+ * are sharded, so threads never contend for them. set_stats_report has the Message_Processor display a summary of them
+ * periodically; format_stats_json writes a snapshot as JSON, for tools that track them over time. set_final_stats has the
+ * destructor take a last snapshot, once everything queued has been written - so a test can check that no message was lost.
+ *
  * @note one source cannot, with its tick message, pre-empt another source's tick messages; but the same source can preempt its own tick messages - unless
  * the thread_id's of the two tick messages are different.
  */
@@ -38,15 +147,120 @@ class Message_Processor {
   Impl *pimpl;
 
  public:
-  Message_Processor(re_gen::Verbosity_Level overall_verbosity = re_gen::VERBOSITY_MINOR_STEPS);
+  Message_Processor(re_gen::Verbosity_Level overall_verbosity = re_gen::VERBOSITY_MINOR_STEPS,
+                    re_gen::Overflow_Policy overflow_policy = re_gen::OVERFLOW_DROP_AND_COUNT);
   ~Message_Processor();
   int register_msg_src(Verbosity_Level verbosity, const std::string &src_str);
-  void process_msg(int msg_src_id, Verbosity_Level importance, const std::string &msg_str);
+  int find_msg_src(const std::string &src_str) const;
+  bool process_msg(int msg_src_id, Verbosity_Level importance, const std::string &msg_str);
+  bool process_msg(int msg_src_id, Verbosity_Level importance, std::string &&msg_str);
+  bool process_msg(int msg_src_id, Verbosity_Level importance, const char *msg_str);
+  template <typename... Args>
+  bool process_msg_fmt(int msg_src_id, Verbosity_Level importance, const char *fmt, const Args&... args);
+  bool process_fmt_args(int msg_src_id, Verbosity_Level importance, const Fmt_Args &fmt_args);
+  template <Verbosity_Level Importance, typename Msg_T>
+  bool process_msg_at(int msg_src_id, Msg_T &&msg_str);
+  template <Verbosity_Level Importance, typename... Args>
+  bool process_msg_fmt_at(int msg_src_id, const char *fmt, const Args&... args);
+  bool accepts_msg(int msg_src_id, Verbosity_Level importance) const;
   void set_overall_verbosity(Verbosity_Level overall_verbosity);
+  void set_msg_src_verbosity(int msg_src_id, Verbosity_Level verbosity);
+  bool msg_src_stats(int msg_src_id, Msg_Src_Stats *const stats) const;
+  void stats(Msg_Processor_Stats *const stats) const;
+  void set_stats_report(unsigned long interval_ms, Verbosity_Level severity = VERBOSITY_MINOR_STEPS);
+  void set_final_stats(Msg_Processor_Stats *const stats);
+  void count_filtered_msg(int msg_src_id);
+  void set_msg_src_rate_limit(int msg_src_id, double msgs_per_sec, unsigned long burst);
+  void set_coalescing(bool coalesce);
+  void set_sink(Message_Sink *sink);
+  bool set_binary_log(const std::string &file_name);
+  void set_crash_log(const std::string &file_name, size_t capacity = 4 * 1024 * 1024);
+  void set_timestamps(int columns);
+  void set_flush_policy(Verbosity_Level flush_verbosity, unsigned long flush_interval_ms);
+  void flush(void);
+  size_t queue_depth(void) const;
+  unsigned long dropped_msg_count(void) const;
   static Message_Processor *get_message_processor(void);
+
+  //* Message_Processor::Hold class
+  /*
+   * @brief keeps the current Message_Processor (if there is one) from being torn down while the Hold is in scope
+   * @remarks for code that may outlive the Message_Processor, eg. a Thread_Pool: get() is the Message_Processor, or 0 if there is
+   * none, and stays valid until the Hold is destroyed - ~Message_Processor waits for every Hold to go first. so keep a Hold
+   * just for the few calls that need it.
+   */
+  class Hold {
+   public:
+    Hold(void);
+    ~Hold(void);
+    Message_Processor *get(void) const { return(mp); }
+   private:
+    Message_Processor *mp;
+    Hold(const Hold &);
+    Hold& operator=(const Hold &);
+  };
  private:
   Message_Processor(const Message_Processor &);
   Message_Processor& operator=(const Message_Processor &);
 };//class Message_Processor
+
+//* Message_Processor::process_msg_fmt
+/*
+ * @brief capture a format string and its arguments, to be formatted on the Message_Processor thread
+ * @see process_fmt_args, capture_fmt_args
+ */
+template <typename... Args>
+bool Message_Processor::process_msg_fmt(int msg_src_id, Verbosity_Level importance, const char *fmt, const Args&... args) {
+  Fmt_Args fmt_args;
+  capture_fmt_args(&fmt_args, fmt, args...);
+  return(process_fmt_args(msg_src_id, importance, fmt_args));
+}
+
+//* Message_Processor::process_msg_at
+/*
+ * @brief process_msg, with the importance fixed at compile time; compiles to nothing below MESSAGE_VERBOSITY_FLOOR
+ */
+template <Verbosity_Level Importance, typename Msg_T>
+bool Message_Processor::process_msg_at(int msg_src_id, Msg_T &&msg_str) {
+  if (!Msg_Compiled_In<Importance>::value)
+    return(true);
+  return(process_msg(msg_src_id, Importance, std::forward<Msg_T>(msg_str)));
+}
+
+//* Message_Processor::process_msg_fmt_at
+/*
+ * @brief process_msg_fmt, with the importance fixed at compile time; compiles to nothing below MESSAGE_VERBOSITY_FLOOR
+ */
+template <Verbosity_Level Importance, typename... Args>
+bool Message_Processor::process_msg_fmt_at(int msg_src_id, const char *fmt, const Args&... args) {
+  if (!Msg_Compiled_In<Importance>::value)
+    return(true);
+  return(process_msg_fmt(msg_src_id, Importance, fmt, args...));
+}
 };//namespace re_gen
+
+//* MSG_PROCESS, MSG_PROCESS_FMT macros
+/*
+ * @brief issue a message via Message_Processor *mp, without evaluating the message arguments unless the message will be displayed
+ * @remarks a message that is filtered out is still counted (see Message_Processor::stats); one that is compiled out isn't.
+ * @see Message_Processor
+ */
+#define MSG_PROCESS(mp, msg_src_id, importance, msg_str)						\
+  do {													\
+    if ((importance) <= MESSAGE_VERBOSITY_FLOOR) {							\
+      if ((mp)->accepts_msg((msg_src_id), (importance)))						\
+	(mp)->process_msg((msg_src_id), (importance), (msg_str));					\
+      else												\
+	(mp)->count_filtered_msg((msg_src_id));							\
+    }													\
+  } while (0)
+#define MSG_PROCESS_FMT(mp, msg_src_id, importance, ...)						\
+  do {													\
+    if ((importance) <= MESSAGE_VERBOSITY_FLOOR) {							\
+      if ((mp)->accepts_msg((msg_src_id), (importance)))						\
+	(mp)->process_msg_fmt((msg_src_id), (importance), __VA_ARGS__);					\
+      else												\
+	(mp)->count_filtered_msg((msg_src_id));							\
+    }													\
+  } while (0)
 #endif //__IF_MESSAGE_PROCESSOR__
@@ -0,0 +1,165 @@
+//* message renderer class
+/*
+ * @remarks renders messages as text, for the Message_Processor and for the binary log decoder
+ */
+#include <ctime>
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+#include "gen/gendefs.h"
+#include "gen/message_renderer.h"
+
+namespace {
+  const std::string msg_prefixes[] = {
+    "",        //VERBOSITY_QUIET
+    "Error: ", //VERBOSITY_ERRORS
+    "Info:  ", //VERBOSITY_MAJOR_STEPS,
+    "Info:  ", //VERBOSITY_MINOR_STEPS,
+    "Debug: "  //VERBOSITY_EVERYTHING
+  };
+  const std::string tick_string[]     = {"\b|", "\b/", "\b-", "\b\\"};
+  const std::string mod_tick_string[] = {"\b!", "\bX", "\b=", "\bV" };
+};//anonymous namespace
+
+
+//* re_gen namespace
+/**
+ * @brief this namespace is for items that are of general interest.
+ */
+namespace re_gen {
+
+Message_Renderer::Message_Renderer(void) :
+  tick_count(0), prev_msg(""), msg_to_display(), prev_tid(0), prev_src(-1), prev_severity(VERBOSITY_ERRORS),
+  timestamp_columns(TIMESTAMP_NONE), wall_offset_ns(0), wall_offset_taken(0) {
+}
+
+const std::string &Message_Renderer::severity_prefix(Verbosity_Level severity) {
+  return(msg_prefixes[severity]);
+}
+
+bool Message_Renderer::is_ticker(const std::string &msg) {
+  return(msg.size() >= 2 && msg.compare(msg.size() - 2, 2, " .") == 0);
+}
+
+//* Message_Renderer::make_msg_to_display
+/*
+ * @brief organize the importance-prefix, source-prefix, and actual_msg in a message string
+ * @param src_name - the name of the message source, or 0 if it has none.
+ */
+void Message_Renderer::make_msg_to_display(const std::string *src_name, unsigned long tid, Verbosity_Level severity,
+                                           const std::string &msg, std::string *const msg_to_display) {
+  std::ostringstream oss("");
+  std::string msg_src_str("");
+  if (src_name != 0) {
+    std::ostringstream src_oss;
+    src_oss << *src_name;
+    //if message starts with '::', then source string is a class name, and the message starts with a member function name, so no hyphin
+    if (msg.substr(0, 2) != "::")
+      src_oss << " - ";
+    msg_src_str.assign(src_oss.str());
+  }
+  //we only display the message prefix on messages that are not quiet. quiet messages are those that are displayed as part of normal
+  //program output; and they are displayed verbatum.
+  if (severity == VERBOSITY_QUIET) {
+    oss << msg;
+  } else {
+    oss << "[" << std::setw(2) << tid << "] " << msg_prefixes[severity] << " " << msg_src_str << msg;
+    //no linefeed in case of a ticker message
+    if (!is_ticker(msg))
+      oss << std::endl;
+  }
+  msg_to_display->assign(oss.str());
+}
+
+//* Message_Renderer::add_timestamps
+/*
+ * @brief put the time stamp columns in front of msg_to_display
+ */
+void Message_Renderer::add_timestamps(unsigned long long stamp, unsigned long long latency_ns) {
+  char columns[96];
+  int len = 0;
+  if (timestamp_columns & TIMESTAMP_WALL) {
+    if (wall_offset_taken == 0 || stamp > wall_offset_taken + 1000000000ULL) {
+      timespec mono, real;
+      clock_gettime(CLOCK_MONOTONIC, &mono);
+      clock_gettime(CLOCK_REALTIME, &real);
+      wall_offset_taken = static_cast<unsigned long long>(mono.tv_sec) * 1000000000ULL + mono.tv_nsec;
+      wall_offset_ns = (static_cast<long long>(real.tv_sec) * 1000000000LL + real.tv_nsec) - static_cast<long long>(wall_offset_taken);
+    }
+    long long wall = static_cast<long long>(stamp) + wall_offset_ns;
+    time_t secs = wall / 1000000000LL;
+    struct tm tm;
+    localtime_r(&secs, &tm);
+    len += strftime(columns + len, sizeof(columns) - len, "%Y-%m-%d %H:%M:%S", &tm);
+    len += snprintf(columns + len, sizeof(columns) - len, ".%06lld ", (wall % 1000000000LL) / 1000);
+  }
+  if (timestamp_columns & TIMESTAMP_MONOTONIC)
+    len += snprintf(columns + len, sizeof(columns) - len, "%llu.%09llu ", stamp / 1000000000ULL, stamp % 1000000000ULL);
+  if (timestamp_columns & TIMESTAMP_LATENCY)
+    len += snprintf(columns + len, sizeof(columns) - len, "+%llu.%03lluus ", latency_ns / 1000, latency_ns % 1000);
+  msg_to_display.insert(0, columns, len);
+}
+
+//* Message_Renderer::render
+/*
+ * @brief append a message, as it should be displayed, to out
+ * @param stamp - when the message was issued, in CLOCK_MONOTONIC nanoseconds; latency_ns - how long it took to reach us. these are
+ * only used for the time stamp columns (see set_timestamps).
+ */
+void Message_Renderer::render(const std::string *src_name, unsigned long tid, int src, Verbosity_Level severity,
+                              const std::string &msg, std::string *const out) {
+  render(src_name, tid, src, severity, msg, 0, 0, out);
+}
+
+void Message_Renderer::render(const std::string *src_name, unsigned long tid, int src, Verbosity_Level severity,
+                              const std::string &msg, unsigned long long stamp, unsigned long long latency_ns,
+                              std::string *const out) {
+  make_msg_to_display(src_name, tid, severity, msg, &msg_to_display);
+  if (timestamp_columns != TIMESTAMP_NONE && severity != VERBOSITY_QUIET)
+    add_timestamps(stamp, latency_ns);
+  if (is_ticker(msg)) {
+    //handle ticker messages
+    if (tick_count != 0) {
+      if (src == prev_src && tid == prev_tid) {
+	//already ticking, same source
+	if (msg.compare(prev_msg)) {
+	  //new message => display new message, and restart ticker
+	  *out += '\n';
+	  *out += msg_to_display;
+	  *out += tick_string[0];
+	  prev_msg = msg;
+	  tick_count = 1;
+	} else {
+	  //same message => just display a new tick mark
+	  *out += tick_string[tick_count++ & 3];
+	}
+      } else {
+	//already ticking, new source => display modified ticker
+	*out += mod_tick_string[tick_count++ & 3];
+      }
+    } else {
+      //first tick message => display message, start ticker
+      *out += msg_to_display;
+      *out += tick_string[0];
+      prev_src = src;
+      prev_msg = msg;
+      prev_tid = tid;
+      tick_count = 1;
+    }
+  } else {
+    //handle non-ticker (normal) messages
+    if (tick_count != 0) {
+      *out += '\n';
+      tick_count = 0;
+    } else if (prev_severity == VERBOSITY_QUIET && severity != VERBOSITY_QUIET) {
+      //this is an error message. if the previous message was not an error message, then we need might need to add a newline
+      *out += '\n';
+    }
+    *out += msg_to_display;
+    prev_src = src;
+    prev_msg = msg;
+    prev_tid = tid;
+    prev_severity = severity;
+  }
+}
+};//namespace re_gen
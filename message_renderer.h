@@ -0,0 +1,67 @@
+//* message_renderer.h - header file for the Message_Renderer class
+/*
+ * @brief this header file defines the Message_Renderer class, which turns messages into the text that the Message_Processor
+ * displays.
+ */
+#ifndef __IF_MESSAGE_RENDERER__
+#define __IF_MESSAGE_RENDERER__
+#include <string>
+#include <gen/gendefs.h>
+
+//* re_gen namespace
+/**
+ * @brief this namespace is for items that are of general interest.
+ */
+namespace re_gen {
+
+//the optional time stamp columns, which can be combined; see Message_Renderer::set_timestamps
+enum Timestamp_Columns { TIMESTAMP_NONE      = 0,
+                         TIMESTAMP_WALL      = 1,  //when the message was issued: "2026-01-31 23:59:59.123456"
+                         TIMESTAMP_MONOTONIC = 2,  //when the message was issued, in seconds of CLOCK_MONOTONIC: "12345.123456789"
+                         TIMESTAMP_LATENCY   = 4   //how long it took to reach the sink, after being issued: "+12.345us"
+};
+
+//* Message_Renderer class
+/*
+ * @brief renders a stream of messages as text: "[tid] Prefix: source - message", plus tickers
+ *
+ * @remarks the Message_Processor renders its messages with this class, and so does the binary log decoder (msg_decode), which is
+ * why the decoder's output is identical to what the Message_Processor would have displayed.
+ *
+ * @note a message that ends in " ." is a ticker message. the first one is displayed as usual, with a spinning tick mark after it.
+ * repeats of the same message from the same source and thread just advance the tick mark; a ticker message from some other
+ * source or thread advances a modified tick mark; and any other message ends the ticker line.
+ *
+ * @note render keeps state (for the tickers), so use one Message_Renderer per output stream.
+ *
+ * @note set_timestamps adds time stamp columns in front of each message (but not in front of quiet messages, which are displayed
+ * verbatim). the wall clock time is worked out from the message's CLOCK_MONOTONIC stamp, using the difference between the two
+ * clocks, which is sampled at most once a second.
+ */
+class Message_Renderer {
+ public:
+  Message_Renderer(void);
+  void set_timestamps(int columns) { timestamp_columns = columns; }
+  void render(const std::string *src_name, unsigned long tid, int src, Verbosity_Level severity, const std::string &msg,
+              std::string *const out);
+  void render(const std::string *src_name, unsigned long tid, int src, Verbosity_Level severity, const std::string &msg,
+              unsigned long long stamp, unsigned long long latency_ns, std::string *const out);
+  static void make_msg_to_display(const std::string *src_name, unsigned long tid, Verbosity_Level severity, const std::string &msg,
+                                  std::string *const msg_to_display);
+  static const std::string &severity_prefix(Verbosity_Level severity);
+  static bool is_ticker(const std::string &msg);
+
+ private:
+  int tick_count;
+  std::string prev_msg;
+  std::string msg_to_display;
+  unsigned long prev_tid;
+  int prev_src;
+  Verbosity_Level prev_severity;
+  int timestamp_columns;
+  long long wall_offset_ns;                //CLOCK_REALTIME - CLOCK_MONOTONIC
+  unsigned long long wall_offset_taken;    //CLOCK_MONOTONIC nanoseconds
+  void add_timestamps(unsigned long long stamp, unsigned long long latency_ns);
+};//class Message_Renderer
+};//namespace re_gen
+#endif //__IF_MESSAGE_RENDERER__
@@ -0,0 +1,245 @@
+//* message sinks
+/*
+ * @remarks the standard Message_Sinks: stderr, buffered file (with rotation), in-memory, null, binary log, and fan-out
+ */
+#include <ctime>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "gen/gendefs.h"
+#include "gen/queue.h"
+#include "gen/async_writer.h"
+#include "gen/message_sink.h"
+
+namespace {
+  //nanoseconds on the monotonic clock
+  unsigned long long now_ns(void) {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return(static_cast<unsigned long long>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec);
+  }
+  std::string numbered(const std::string &file_name, int n) {
+    char suffix[16];
+    snprintf(suffix, sizeof(suffix), ".%d", n);
+    return(file_name + suffix);
+  }
+};//anonymous namespace
+
+
+//* re_gen namespace
+/**
+ * @brief this namespace is for items that are of general interest.
+ */
+namespace re_gen {
+
+Text_Sink::Text_Sink(size_t _buffer_size) : renderer(), buffer(), buffer_size(_buffer_size), text_bytes(0) {
+  buffer.reserve(buffer_size);
+}
+
+void Text_Sink::write(const Sink_Msg &msg) {
+  renderer.render(msg.src_name, msg.tid, msg.src, msg.severity, msg.text(), msg.stamp, msg.latency_ns, &buffer);
+  if (buffer.size() >= buffer_size)
+    flush();
+}
+
+void Text_Sink::flush(void) {
+  if (buffer.empty())
+    return;
+  text_bytes += buffer.size();
+  write_text(&buffer);
+  buffer.clear();
+}
+
+
+Stderr_Sink::Stderr_Sink(size_t buffer_size) : Text_Sink(buffer_size), writer(new Async_Writer(STDERR_FILENO)) {
+}
+
+Stderr_Sink::~Stderr_Sink(void) {
+  flush();
+  delete writer;
+}
+
+void Stderr_Sink::write_text(std::string *const text) {
+  writer->write(text);
+}
+
+
+File_Sink::File_Sink(const std::string &_file_name, size_t buffer_size, unsigned long long _max_bytes, unsigned long _max_secs,
+                     int _keep) :
+  Text_Sink(buffer_size), file_name(_file_name), max_bytes(_max_bytes), max_secs(_max_secs), keep(_keep), fd(-1), file_bytes(0),
+  opened_at(0), writer(0) {
+  open_file();
+  if (fd < 0)
+    throw Gen_Err("File_Sink::File_Sink - can't open " + file_name + ": " + strerror(errno));
+  try {
+    writer = new Async_Writer(fd);
+  } catch (...) {
+    ::close(fd);
+    throw;
+  }
+}
+
+File_Sink::~File_Sink(void) {
+  flush();
+  delete writer;
+  if (fd >= 0)
+    ::close(fd);
+}
+
+void File_Sink::open_file(void) {
+  fd = ::open(file_name.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+  struct stat st;
+  file_bytes = (fd >= 0 && fstat(fd, &st) == 0) ? st.st_size : 0;
+  opened_at = time(0);
+}
+
+void File_Sink::write_text(std::string *const text) {
+  if (fd < 0)
+    return;
+  file_bytes += text->size();
+  writer->write(text);
+  if ((max_bytes != 0 && file_bytes >= max_bytes) || (max_secs != 0 && static_cast<unsigned long>(time(0) - opened_at) >= max_secs))
+    rotate();
+}
+
+//* File_Sink::rotate
+/*
+ * @brief file_name.<keep-1> => file_name.<keep>, ... file_name => file_name.1; then start a new file_name
+ * @remarks if the new file can't be opened, we stop writing, rather than lose the old ones.
+ */
+void File_Sink::rotate(void) {
+  writer->drain();
+  ::close(fd);
+  if (keep > 0) {
+    for (int n = keep - 1; n > 0; --n)
+      ::rename(numbered(file_name, n).c_str(), numbered(file_name, n + 1).c_str());
+    ::rename(file_name.c_str(), numbered(file_name, 1).c_str());
+  } else {
+    ::unlink(file_name.c_str());
+  }
+  open_file();
+  writer->set_fd(fd);
+}
+
+
+Memory_Sink::Memory_Sink(void) : Text_Sink(64 * 1024), text() {
+  pthread_mutex_init(&mutex, 0);
+}
+
+Memory_Sink::~Memory_Sink(void) {
+  pthread_mutex_destroy(&mutex);
+}
+
+std::string Memory_Sink::contents(void) const {
+  re_queue_helpers::lock l(mutex);
+  return(text);
+}
+
+void Memory_Sink::clear(void) {
+  re_queue_helpers::lock l(mutex);
+  text.clear();
+}
+
+void Memory_Sink::write_text(std::string *const _text) {
+  re_queue_helpers::lock l(mutex);
+  text += *_text;
+}
+
+
+Null_Sink::Null_Sink(bool _format) : format(_format), text_bytes(0), n_messages(0) {
+}
+
+void Null_Sink::write(const Sink_Msg &msg) {
+  if (format)
+    text_bytes += msg.text().size();
+  n_messages.store(n_messages.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+
+Binary_Log_Sink::Binary_Log_Sink(const std::string &file_name, size_t _buffer_size) :
+  encoder(now_ns()), buffer(), buffer_size(_buffer_size), log_bytes(0), fd(-1), writer(0) {
+  fd = ::open(file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    throw Gen_Err("Binary_Log_Sink::Binary_Log_Sink - can't open " + file_name + ": " + strerror(errno));
+  try {
+    writer = new Async_Writer(fd);
+  } catch (...) {
+    ::close(fd);
+    throw;
+  }
+  buffer.reserve(buffer_size);
+  encoder.begin(&buffer);
+}
+
+Binary_Log_Sink::~Binary_Log_Sink(void) {
+  flush();
+  delete writer;
+  ::close(fd);
+}
+
+void Binary_Log_Sink::write(const Sink_Msg &msg) {
+  if (!encoder.knows_source(msg.src) && msg.src_name != 0)
+    encoder.add_source(msg.src, *msg.src_name, &buffer);
+  if (msg.deferred() != 0)
+    encoder.encode(msg.stamp, msg.tid, msg.src, msg.severity, *msg.deferred(), &buffer);
+  else
+    encoder.encode(msg.stamp, msg.tid, msg.src, msg.severity, msg.text(), &buffer);
+  if (buffer.size() >= buffer_size)
+    flush();
+}
+
+void Binary_Log_Sink::flush(void) {
+  log_bytes += buffer.size();
+  writer->write(&buffer);
+  buffer.clear();
+}
+
+void Binary_Log_Sink::add_source(int src, const std::string &src_name) {
+  encoder.add_source(src, src_name, &buffer);
+}
+
+
+Fan_Out_Sink::Fan_Out_Sink(void) : sinks() {
+}
+
+Fan_Out_Sink::~Fan_Out_Sink(void) {
+  for (size_t i = 0; i < sinks.size(); ++i)
+    delete sinks[i].first;
+}
+
+void Fan_Out_Sink::add_sink(Message_Sink *sink, Verbosity_Level verbosity) {
+  sinks.push_back(std::make_pair(sink, verbosity));
+}
+
+void Fan_Out_Sink::write(const Sink_Msg &msg) {
+  for (size_t i = 0; i < sinks.size(); ++i) {
+    if (msg.severity <= sinks[i].second)
+      sinks[i].first->write(msg);
+  }
+}
+
+void Fan_Out_Sink::flush(void) {
+  for (size_t i = 0; i < sinks.size(); ++i)
+    sinks[i].first->flush();
+}
+
+void Fan_Out_Sink::add_source(int src, const std::string &src_name) {
+  for (size_t i = 0; i < sinks.size(); ++i)
+    sinks[i].first->add_source(src, src_name);
+}
+
+void Fan_Out_Sink::set_timestamps(int columns) {
+  for (size_t i = 0; i < sinks.size(); ++i)
+    sinks[i].first->set_timestamps(columns);
+}
+
+unsigned long long Fan_Out_Sink::bytes_written(void) const {
+  unsigned long long bytes = 0;
+  for (size_t i = 0; i < sinks.size(); ++i)
+    bytes += sinks[i].first->bytes_written();
+  return(bytes);
+}
+};//namespace re_gen
@@ -0,0 +1,252 @@
+//* message_sink.h - header file for the Message_Processor's output sinks
+/*
+ * @brief this header file defines the Message_Sink interface, to which the Message_Processor writes its messages, and the
+ * standard sinks: stderr, buffered file (with rotation), in-memory, null, binary log, and fan-out.
+ */
+#ifndef __IF_MESSAGE_SINK__
+#define __IF_MESSAGE_SINK__
+#include <string>
+#include <vector>
+#include <utility>
+#include <atomic>
+#include <pthread.h>
+#include <gen/gendefs.h>
+#include <gen/message_format.h>
+#include <gen/message_renderer.h>
+#include <gen/message_codec.h>
+#include <gen/async_writer.h>
+
+//* re_gen namespace
+/**
+ * @brief this namespace is for items that are of general interest.
+ */
+namespace re_gen {
+
+//* Sink_Msg class
+/*
+ * @brief a message, as it's handed to a Message_Sink
+ * @remarks a deferred message (see Message_Processor::process_msg_fmt) is only formatted if a sink asks for its text; so a binary log
+ * sink can write the format and arguments as they are.
+ */
+class Sink_Msg {
+ public:
+  Sink_Msg(unsigned long long _stamp, unsigned long _tid, int _src, const std::string *_src_name, Verbosity_Level _severity,
+           const Fmt_Args *_fmt_args, std::string *const _msg) :
+    stamp(_stamp), latency_ns(0), tid(_tid), src(_src), src_name(_src_name), severity(_severity), fmt_args(_fmt_args), msg(_msg),
+    formatted(false) {
+  }
+  const std::string &text(void) const {
+    if (fmt_args != 0 && !formatted) {
+      format_fmt_args(*fmt_args, msg);
+      formatted = true;
+    }
+    return(*msg);
+  }
+  const Fmt_Args *deferred(void) const { return(fmt_args); }
+  unsigned long long stamp;      //CLOCK_MONOTONIC nanoseconds, when the message was issued
+  unsigned long long latency_ns; //from when the message was issued, to when it was handed to the sink
+  unsigned long tid;
+  int src;
+  const std::string *src_name;   //0 if the source has no name
+  Verbosity_Level severity;
+ private:
+  const Fmt_Args *fmt_args;
+  std::string *const msg;
+  mutable bool formatted;
+};//class Sink_Msg
+
+//* Message_Sink class
+/*
+ * @brief where the Message_Processor writes its messages
+ * @remarks a sink is only ever called by the Message_Processor thread, so it needs no locking of its own (unless, like the
+ * Memory_Sink, it is also read by other threads). sinks are expected to buffer: the Message_Processor calls flush when it's
+ * time for the buffered messages to be seen - see Message_Processor::set_flush_policy.
+ * @note add_source is called, for each registered source, when the sink is installed; a sink that keeps a dictionary of
+ * source names can use it. sources registered later first appear in write.
+ * @note set_timestamps asks for time stamp columns (see Message_Renderer::set_timestamps); sinks that don't display text
+ * ignore it.
+ * @note bytes_written is the number of bytes the sink has output so far (text or binary, as flushed - whether or not its
+ * writer has finished writing them); it's read by the Message_Processor thread, for Message_Processor::stats.
+ */
+class Message_Sink {
+ public:
+  virtual ~Message_Sink(void) {}
+  virtual void write(const Sink_Msg &msg) = 0;
+  virtual void flush(void) = 0;
+  virtual void add_source(int , const std::string &) {}
+  virtual void set_timestamps(int ) {}
+  virtual unsigned long long bytes_written(void) const { return(0); }
+};//class Message_Sink
+
+//* Text_Sink class
+/*
+ * @brief base class for sinks that display messages as text, just as they'd appear on stderr (tickers included)
+ * @remarks the text is buffered, and handed to write_text on flush, or when the buffer is full. write_text may take the text (by
+ * swapping it for another buffer, eg. an Async_Writer's spare); whatever it leaves is cleared.
+ */
+class Text_Sink : public Message_Sink {
+ public:
+  virtual ~Text_Sink(void) {}
+  void write(const Sink_Msg &msg);
+  void flush(void);
+  void set_timestamps(int columns) { renderer.set_timestamps(columns); }
+  unsigned long long bytes_written(void) const { return(text_bytes); }
+ protected:
+  Text_Sink(size_t _buffer_size);
+  virtual void write_text(std::string *const text) = 0;
+ private:
+  Message_Renderer renderer;
+  std::string buffer;
+  size_t buffer_size;
+  unsigned long long text_bytes;
+};//class Text_Sink
+
+//* Stderr_Sink class
+/*
+ * @brief displays messages on stderr; this is the Message_Processor's default sink
+ * @remarks the text is written by an Async_Writer, so a slow reader doesn't hold up the Message_Processor thread.
+ */
+class Stderr_Sink : public Text_Sink {
+ public:
+  Stderr_Sink(size_t buffer_size = 64 * 1024);
+  ~Stderr_Sink(void);
+  Async_Write_Stats write_stats(void) const { return(writer->stats()); }
+ protected:
+  void write_text(std::string *const text);
+ private:
+  Async_Writer *writer;
+  Stderr_Sink(const Stderr_Sink &);
+  Stderr_Sink& operator=(const Stderr_Sink &);
+};//class Stderr_Sink
+
+//* File_Sink class
+/*
+ * @brief appends messages, as text, to a file; with a large buffer, and optional rotation by size and by age
+ * @param file_name - the log file; created if need be, and appended to.
+ * @param buffer_size - text is written to the file when this much has built up (or on flush).
+ * @param max_bytes - rotate the file once it has grown to this size; 0 => never.
+ * @param max_secs - rotate the file once it has been open this long; 0 => never.
+ * @param keep - the number of rotated files to keep: file_name.1 (the newest) ... file_name.<keep>.
+ * @remarks rotation is checked after each write to the file, so a file can overshoot max_bytes by up to buffer_size.
+ * @remarks the file is written by an Async_Writer, so the Message_Processor thread formats the next buffer while the last one is
+ * written; write_stats says how long the writes take, and how much is waiting to be written.
+ * @throw Gen_Err if the file can't be opened.
+ */
+class File_Sink : public Text_Sink {
+ public:
+  File_Sink(const std::string &file_name, size_t buffer_size = 1024 * 1024, unsigned long long max_bytes = 0,
+            unsigned long max_secs = 0, int keep = 4);
+  ~File_Sink(void);
+  Async_Write_Stats write_stats(void) const { return(writer->stats()); }
+ protected:
+  void write_text(std::string *const text);
+ private:
+  void open_file(void);
+  void rotate(void);
+  std::string file_name;
+  unsigned long long max_bytes;
+  unsigned long max_secs;
+  int keep;
+  int fd;
+  unsigned long long file_bytes;
+  time_t opened_at;
+  Async_Writer *writer;
+  File_Sink(const File_Sink &);
+  File_Sink& operator=(const File_Sink &);
+};//class File_Sink
+
+//* Memory_Sink class
+/*
+ * @brief keeps the displayed text in memory - for tests
+ * @remarks contents only includes text that has been flushed. it's safe to call contents and clear from any thread.
+ */
+class Memory_Sink : public Text_Sink {
+ public:
+  Memory_Sink(void);
+  ~Memory_Sink(void);
+  std::string contents(void) const;
+  void clear(void);
+ protected:
+  void write_text(std::string *const text);
+ private:
+  std::string text;
+  mutable pthread_mutex_t mutex;
+  Memory_Sink(const Memory_Sink &);
+  Memory_Sink& operator=(const Memory_Sink &);
+};//class Memory_Sink
+
+//* Null_Sink class
+/*
+ * @brief discards messages, counting them - for measuring the cost of issuing and queueing messages, without the output
+ * @param format - if true, each message's text is still made (so a deferred message is formatted), and its size counted in
+ * bytes_written; that's the work a text sink does short of rendering and writing it.
+ * @remarks messages is safe to call from any thread.
+ */
+class Null_Sink : public Message_Sink {
+ public:
+  Null_Sink(bool _format = false);
+  void write(const Sink_Msg &msg);
+  void flush(void) {}
+  unsigned long long bytes_written(void) const { return(text_bytes); }
+  unsigned long long messages(void) const { return(n_messages.load(std::memory_order_relaxed)); }
+ private:
+  bool format;
+  unsigned long long text_bytes;
+  std::atomic<unsigned long long> n_messages;
+  Null_Sink(const Null_Sink &);
+  Null_Sink& operator=(const Null_Sink &);
+};//class Null_Sink
+
+//* Binary_Log_Sink class
+/*
+ * @brief writes messages to a binary log file (see message_codec.h); the msg_decode tool turns it back into text
+ * @remarks the file is truncated. deferred messages are written unformatted. the file is written by an Async_Writer.
+ * @throw Gen_Err if the file can't be opened.
+ */
+class Binary_Log_Sink : public Message_Sink {
+ public:
+  Binary_Log_Sink(const std::string &file_name, size_t buffer_size = 1024 * 1024);
+  ~Binary_Log_Sink(void);
+  void write(const Sink_Msg &msg);
+  void flush(void);
+  void add_source(int src, const std::string &src_name);
+  unsigned long long bytes_written(void) const { return(log_bytes); }
+  Async_Write_Stats write_stats(void) const { return(writer->stats()); }
+ private:
+  Message_Encoder encoder;
+  std::string buffer;
+  size_t buffer_size;
+  unsigned long long log_bytes;
+  int fd;
+  Async_Writer *writer;
+  Binary_Log_Sink(const Binary_Log_Sink &);
+  Binary_Log_Sink& operator=(const Binary_Log_Sink &);
+};//class Binary_Log_Sink
+
+//* Fan_Out_Sink class
+/*
+ * @brief hands each message on to several sinks, each of which has its own verbosity
+ * @remarks eg. everything to a file, but only errors to stderr:
+ *   Fan_Out_Sink *sink = new Fan_Out_Sink;
+ *   sink->add_sink(new File_Sink("app.log"), VERBOSITY_EVERYTHING);
+ *   sink->add_sink(new Stderr_Sink, VERBOSITY_ERRORS);
+ *   mp->set_sink(sink);
+ * @note the Fan_Out_Sink owns the sinks that are added to it. add them before it's installed.
+ */
+class Fan_Out_Sink : public Message_Sink {
+ public:
+  Fan_Out_Sink(void);
+  ~Fan_Out_Sink(void);
+  void add_sink(Message_Sink *sink, Verbosity_Level verbosity);
+  void write(const Sink_Msg &msg);
+  void flush(void);
+  void add_source(int src, const std::string &src_name);
+  void set_timestamps(int columns);
+  unsigned long long bytes_written(void) const;
+ private:
+  std::vector<std::pair<Message_Sink *, Verbosity_Level> > sinks;
+  Fan_Out_Sink(const Fan_Out_Sink &);
+  Fan_Out_Sink& operator=(const Fan_Out_Sink &);
+};//class Fan_Out_Sink
+};//namespace re_gen
+#endif //__IF_MESSAGE_SINK__
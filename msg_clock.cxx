@@ -0,0 +1,64 @@
+//* message clock
+/*
+ * @remarks cheap time stamps, and their conversion to CLOCK_MONOTONIC nanoseconds (see msg_clock.h)
+ */
+#include "gen/gendefs.h"
+#include "gen/msg_clock.h"
+
+namespace {
+  //how long the initial measurement of the tick rate takes, and how often it's measured again
+  const unsigned long long CALIBRATION_NS = 200000ULL;
+  const unsigned long long ANCHOR_INTERVAL_NS = 1000000000ULL;
+
+  //a matching pair of readings; the tick reading is the midpoint of two, either side of the clock reading
+  void sample(unsigned long long *const ticks, unsigned long long *const ns) {
+    unsigned long long before = re_gen::Msg_Clock::ticks();
+    *ns = re_gen::Msg_Clock::monotonic_ns();
+    unsigned long long after = re_gen::Msg_Clock::ticks();
+    *ticks = before + (after - before) / 2;
+  }
+};//anonymous namespace
+
+
+//* re_gen namespace
+/**
+ * @brief this namespace is for items that are of general interest.
+ */
+namespace re_gen {
+
+Msg_Clock::Msg_Clock(void) : first_ticks(0), first_ns(0), anchor_ticks(0), anchor_ns(0), ns_per_tick(1.0) {
+  sample(&first_ticks, &first_ns);
+#ifdef MSG_CLOCK_TSC
+  while (monotonic_ns() - first_ns < CALIBRATION_NS)
+    ;
+#endif
+  anchor();
+}
+
+//* Msg_Clock::anchor
+/*
+ * @brief take a new pair of readings to convert from, and measure the tick rate over everything since construction
+ */
+void Msg_Clock::anchor(void) {
+  sample(&anchor_ticks, &anchor_ns);
+  if (anchor_ticks > first_ticks)
+    ns_per_tick = static_cast<double>(anchor_ns - first_ns) / static_cast<double>(anchor_ticks - first_ticks);
+}
+
+//* Msg_Clock::to_ns
+/*
+ * @brief convert a time stamp in ticks to CLOCK_MONOTONIC nanoseconds
+ */
+unsigned long long Msg_Clock::to_ns(unsigned long long ticks) {
+#ifdef MSG_CLOCK_TSC
+  long long delta = static_cast<long long>(ticks - anchor_ticks);
+  if (delta > 0 && static_cast<double>(delta) * ns_per_tick > ANCHOR_INTERVAL_NS) {
+    anchor();
+    delta = static_cast<long long>(ticks - anchor_ticks);
+  }
+  return(anchor_ns + static_cast<long long>(static_cast<double>(delta) * ns_per_tick));
+#else
+  return(ticks);
+#endif
+}
+};//namespace re_gen
@@ -0,0 +1,63 @@
+//* msg_clock.h - header file for the Msg_Clock class
+/*
+ * @brief this header file defines the Msg_Clock class, the cheap clock with which messages are time stamped.
+ */
+#ifndef __IF_MSG_CLOCK__
+#define __IF_MSG_CLOCK__
+#include <ctime>
+#include <gen/gendefs.h>
+#if defined(__x86_64__) && !defined(MSG_CLOCK_NO_TSC)
+#include <x86intrin.h>
+#define MSG_CLOCK_TSC 1
+#endif
+
+//* re_gen namespace
+/**
+ * @brief this namespace is for items that are of general interest.
+ */
+namespace re_gen {
+
+//* Msg_Clock class
+/*
+ * @brief time stamps in ticks, which are cheap to take, and a converter from ticks to CLOCK_MONOTONIC nanoseconds
+ *
+ * @remarks on x86-64 a tick is a cycle of the time stamp counter, so taking a time stamp is one rdtsc instruction (~10 nS, and no
+ * system call or vDSO page); elsewhere (or if built with -DMSG_CLOCK_NO_TSC, eg. for a cpu whose TSC isn't invariant) a tick is a
+ * nanosecond of CLOCK_MONOTONIC. CLOCK_MONOTONIC_COARSE would be cheaper still, but its resolution (a few mS) is too coarse to
+ * measure latency with.
+ *
+ * @remarks ticks are converted by a Msg_Clock object, which belongs to the thread that does the converting (the Message_Processor
+ * thread); so a producer never pays for the conversion. the converter measures the tick rate against CLOCK_MONOTONIC when it's
+ * constructed (for 200 uS), and then, each time it's been a second since it last did, re-anchors itself and measures the rate
+ * again over everything since construction - so the rate only gets more accurate.
+ *
+ * @note a Msg_Clock isn't thread safe; ticks is.
+ */
+class Msg_Clock {
+ public:
+  Msg_Clock(void);
+  static unsigned long long ticks(void) {
+#ifdef MSG_CLOCK_TSC
+    return(__rdtsc());
+#else
+    return(monotonic_ns());
+#endif
+  }
+  static unsigned long long monotonic_ns(void) {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return(static_cast<unsigned long long>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec);
+  }
+  unsigned long long to_ns(unsigned long long ticks);
+  unsigned long long now_ns(void) { return(to_ns(ticks())); }
+
+ private:
+  void anchor(void);
+  unsigned long long first_ticks;
+  unsigned long long first_ns;
+  unsigned long long anchor_ticks;
+  unsigned long long anchor_ns;
+  double ns_per_tick;
+};//class Msg_Clock
+};//namespace re_gen
+#endif //__IF_MSG_CLOCK__
@@ -0,0 +1,69 @@
+//* msg_crash_tail - crash ring reader
+/*
+ * @remarks usage: msg_crash_tail [-n count] crash_ring_file
+ * reads a crash ring written by the Message_Processor (see Message_Processor::set_crash_log), typically after the process that
+ * wrote it has died, and writes the last count messages (by default, all that survive) to stdout, as they'd have been displayed.
+ * records that were only partly written or were overwritten, and records that can't be decoded, are skipped; the numbers
+ * skipped are reported on stderr.
+ */
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <iostream>
+#include "gen/gendefs.h"
+#include "gen/crash_ring.h"
+#include "gen/message_codec.h"
+#include "gen/message_renderer.h"
+
+int main(int argc, char **argv) {
+  size_t count = 0;
+  int arg = 1;
+  if (arg + 1 < argc && std::string(argv[arg]) == "-n") {
+    count = strtoul(argv[arg + 1], 0, 10);
+    arg += 2;
+  }
+  if (arg + 1 != argc) {
+    std::cerr << "usage: " << argv[0] << " [-n count] crash_ring_file\n";
+    return(2);
+  }
+  std::vector<std::string> records;
+  size_t n_skipped = 0;
+  std::string err;
+  if (!re_gen::Crash_Ring::read_records(argv[arg], &records, &n_skipped, &err)) {
+    std::cerr << argv[0] << ": " << err << "\n";
+    return(2);
+  }
+  //each record is self-contained, so decode it with a decoder of its own
+  std::vector<re_gen::Decoded_Msg> msgs;
+  std::vector<std::string> src_names;
+  std::vector<bool> has_src_name;
+  unsigned long n_bad = 0;
+  for (std::vector<std::string>::const_iterator it = records.begin(); it != records.end(); ++it) {
+    re_gen::Message_Decoder decoder;
+    re_gen::Decoded_Msg msg;
+    const char *p = it->data();
+    const char *const end = p + it->size();
+    re_gen::Message_Decoder::Decode_Status status;
+    while ((status = decoder.decode(&p, end, &msg)) == re_gen::Message_Decoder::DECODE_DICT)
+      ;
+    if (status != re_gen::Message_Decoder::DECODE_MSG) {
+      ++n_bad;
+      continue;
+    }
+    const std::string *src_name = decoder.source_name(msg.src);
+    msgs.push_back(msg);
+    src_names.push_back(src_name != 0 ? *src_name : std::string());
+    has_src_name.push_back(src_name != 0);
+  }
+  size_t first = (count != 0 && count < msgs.size()) ? msgs.size() - count : 0;
+  re_gen::Message_Renderer renderer;
+  std::string out_buf;
+  for (size_t i = first; i < msgs.size(); ++i)
+    renderer.render(has_src_name[i] ? &src_names[i] : 0, msgs[i].tid, msgs[i].src, msgs[i].severity, msgs[i].msg, &out_buf);
+  std::cout << out_buf << std::flush;
+  if (n_skipped != 0)
+    std::cerr << argv[0] << ": skipped " << n_skipped << " partly written or overwritten records\n";
+  if (n_bad != 0)
+    std::cerr << argv[0] << ": skipped " << n_bad << " records that couldn't be decoded\n";
+  return(0);
+}
@@ -0,0 +1,96 @@
+//* msg_decode - binary message log decoder
+/*
+ * @remarks usage: msg_decode [-t] [binary_log_file]
+ * reads a binary log written by the Message_Processor (see Message_Processor::set_binary_log), from the named file or from
+ * stdin, and writes the text that the Message_Processor would have displayed - tickers included - to stdout.
+ * -t puts each message's time stamp (CLOCK_MONOTONIC seconds of the machine that wrote the log) in front of it.
+ * a log whose tail is truncated or corrupt (eg. the process died while writing it) is decoded up to the bad record, which is
+ * reported on stderr; the exit status is then 1.
+ */
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include "gen/gendefs.h"
+#include "gen/message_codec.h"
+#include "gen/message_renderer.h"
+
+namespace {
+  bool read_all(int fd, std::string *const buf) {
+    char chunk[65536];
+    for (;;) {
+      ssize_t n = ::read(fd, chunk, sizeof(chunk));
+      if (n == 0)
+	return(true);
+      if (n < 0) {
+	if (errno == EINTR)
+	  continue;
+	return(false);
+      }
+      buf->append(chunk, n);
+    }
+  }
+};//anonymous namespace
+
+
+int main(int argc, char **argv) {
+  int arg = 1;
+  bool timestamps = false;
+  if (arg < argc && std::string(argv[arg]) == "-t") {
+    timestamps = true;
+    ++arg;
+  }
+  if (argc - arg > 1) {
+    std::cerr << "usage: " << argv[0] << " [-t] [binary_log_file]\n";
+    return(2);
+  }
+  int fd = STDIN_FILENO;
+  if (arg < argc && (fd = ::open(argv[arg], O_RDONLY)) < 0) {
+    std::cerr << argv[0] << ": can't open " << argv[arg] << ": " << strerror(errno) << "\n";
+    return(2);
+  }
+  std::string log;
+  bool read_ok = read_all(fd, &log);
+  if (fd != STDIN_FILENO)
+    ::close(fd);
+  if (!read_ok) {
+    std::cerr << argv[0] << ": read error: " << strerror(errno) << "\n";
+    return(2);
+  }
+  const char *p = log.data();
+  const char *const end = p + log.size();
+  re_gen::Message_Decoder decoder;
+  if (!decoder.read_header(&p, end)) {
+    std::cerr << argv[0] << ": not a binary message log\n";
+    return(2);
+  }
+  re_gen::Message_Renderer renderer;
+  if (timestamps)
+    renderer.set_timestamps(re_gen::TIMESTAMP_MONOTONIC);
+  re_gen::Decoded_Msg msg;
+  std::string out_buf;
+  unsigned long n_msgs = 0;
+  for (;;) {
+    re_gen::Message_Decoder::Decode_Status status = decoder.decode(&p, end, &msg);
+    if (status == re_gen::Message_Decoder::DECODE_MSG) {
+      renderer.render(decoder.source_name(msg.src), msg.tid, msg.src, msg.severity, msg.msg, msg.stamp, 0, &out_buf);
+      ++n_msgs;
+      if (out_buf.size() >= 65536) {
+	fwrite(out_buf.data(), 1, out_buf.size(), stdout);
+	out_buf.clear();
+      }
+    } else if (status != re_gen::Message_Decoder::DECODE_DICT) {
+      fwrite(out_buf.data(), 1, out_buf.size(), stdout);
+      fflush(stdout);
+      if (status == re_gen::Message_Decoder::DECODE_ERROR) {
+	std::cerr << argv[0] << ": truncated or corrupt record at offset " << (p - log.data()) << " (after " << n_msgs
+		  << " messages); " << (end - p) << " bytes not decoded\n";
+	return(1);
+      }
+      return(0);
+    }
+  }
+}
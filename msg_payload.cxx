@@ -0,0 +1,195 @@
+//* message payload
+/*
+ * @remarks fixed-size message bodies, and the lock-free pool of blocks for long texts (see msg_payload.h)
+ */
+#include <new>
+#include <cstring>
+#include <algorithm>
+#include <type_traits>
+#include "gen/gendefs.h"
+#include "gen/queue.h"
+#include "gen/msg_payload.h"
+
+namespace {
+  uint64_t make_head(uint64_t tag, uint32_t index) {
+    return((tag << 32) | index);
+  }
+  uint32_t head_index(uint64_t head) {
+    return(static_cast<uint32_t>(head));
+  }
+  uint64_t head_tag(uint64_t head) {
+    return(head >> 32);
+  }
+};//anonymous namespace
+
+
+//* re_gen namespace
+/**
+ * @brief this namespace is for items that are of general interest.
+ */
+namespace re_gen {
+
+static_assert(sizeof(Msg_Payload) == Msg_Payload::SIZE, "a Msg_Payload should be SIZE bytes");
+static_assert(sizeof(Fmt_Args) <= Msg_Payload::INLINE_TEXT, "a Fmt_Args must fit in a Msg_Payload");
+static_assert(std::is_trivially_copyable<Fmt_Args>::value, "a Fmt_Args is copied into a Msg_Payload byte for byte");
+
+const uint32_t Spill_Pool::NO_BLOCK;
+const uint32_t Msg_Payload::FMT_PAYLOAD;
+
+Spill_Pool::Spill_Pool(void) : free_head(make_head(0, NO_BLOCK)), n_slabs(0) {
+  for (size_t i = 0; i < MAX_SLABS; ++i)
+    slabs[i].store(0, std::memory_order_relaxed);
+  pthread_mutex_init(&grow_mutex, 0);
+}
+
+Spill_Pool &Spill_Pool::instance(void) {
+  static Spill_Pool *pool = new Spill_Pool;
+  return(*pool);
+}
+
+//* Spill_Pool::allocate
+/*
+ * @brief take a block off the free stack, growing the pool if it's empty
+ * @return the block's index, or NO_BLOCK if the pool is at its ceiling (or out of memory)
+ * @remarks a block's next may be changed by its new owner between our reading it and our compare-and-swap; but then the head's
+ * tag has changed too, so the compare-and-swap fails, and we try again.
+ */
+uint32_t Spill_Pool::allocate(void) {
+  uint64_t head = free_head.load(std::memory_order_acquire);
+  for (;;) {
+    const uint32_t index = head_index(head);
+    if (index == NO_BLOCK) {
+      if (!grow())
+	return(NO_BLOCK);
+      head = free_head.load(std::memory_order_acquire);
+      continue;
+    }
+    const uint32_t next = block(index).next.load(std::memory_order_relaxed);
+    if (free_head.compare_exchange_weak(head, make_head(head_tag(head) + 1, next), std::memory_order_acquire,
+					std::memory_order_acquire))
+      return(index);
+  }
+}
+
+//* Spill_Pool::release
+/*
+ * @brief put a chain of blocks (linked by next, and ended by NO_BLOCK) back on the free stack
+ */
+void Spill_Pool::release(uint32_t first) {
+  uint32_t last = first;
+  for (uint32_t next; (next = block(last).next.load(std::memory_order_relaxed)) != NO_BLOCK; )
+    last = next;
+  push(first, last);
+}
+
+void Spill_Pool::push(uint32_t first, uint32_t last) {
+  Block &tail = block(last);
+  uint64_t head = free_head.load(std::memory_order_relaxed);
+  do {
+    tail.next.store(head_index(head), std::memory_order_relaxed);
+  } while (!free_head.compare_exchange_weak(head, make_head(head_tag(head) + 1, first), std::memory_order_release,
+					    std::memory_order_relaxed));
+}
+
+//* Spill_Pool::grow
+/*
+ * @brief add a slab of blocks to the free stack, unless some other thread has just done so (or put blocks back)
+ * @return false if the pool can't grow
+ */
+bool Spill_Pool::grow(void) {
+  re_queue_helpers::lock l(grow_mutex);
+  if (head_index(free_head.load(std::memory_order_acquire)) != NO_BLOCK)
+    return(true);
+  const uint32_t slab = n_slabs.load(std::memory_order_relaxed);
+  if (slab == MAX_SLABS)
+    return(false);
+  Block *blocks = new (std::nothrow) Block[SLAB_BLOCKS];
+  if (blocks == 0)
+    return(false);
+  const uint32_t first = slab * SLAB_BLOCKS;
+  for (uint32_t i = 0; i < SLAB_BLOCKS; ++i)
+    blocks[i].next.store(i + 1 < SLAB_BLOCKS ? first + i + 1 : NO_BLOCK, std::memory_order_relaxed);
+  //the slab is published before any of its indexes can be seen on the stack
+  slabs[slab].store(blocks, std::memory_order_release);
+  n_slabs.store(slab + 1, std::memory_order_relaxed);
+  push(first, first + SLAB_BLOCKS - 1);
+  return(true);
+}
+
+//* Msg_Payload::Msg_Payload
+/*
+ * @brief copy a text into the payload: the first INLINE_TEXT bytes in place, the rest in spill blocks
+ * @remarks if the pool can't supply enough blocks, the text is cut short at what it could hold.
+ */
+Msg_Payload::Msg_Payload(const char *text, size_t len) : length(0), spill(Spill_Pool::NO_BLOCK) {
+  size_t n = std::min(len, static_cast<size_t>(INLINE_TEXT));
+  memcpy(body.text, text, n);
+  if (n < len) {
+    Spill_Pool &pool = Spill_Pool::instance();
+    Spill_Pool::Block *prev = 0;
+    while (n < len) {
+      const uint32_t index = pool.allocate();
+      if (index == Spill_Pool::NO_BLOCK)
+	break;
+      Spill_Pool::Block &block = pool.block(index);
+      const size_t chunk = std::min(len - n, sizeof(block.data));
+      memcpy(block.data, text + n, chunk);
+      block.next.store(Spill_Pool::NO_BLOCK, std::memory_order_relaxed);
+      if (prev == 0)
+	spill = index;
+      else
+	prev->next.store(index, std::memory_order_relaxed);
+      prev = &block;
+      n += chunk;
+    }
+  }
+  length = static_cast<uint32_t>(n);
+}
+
+Msg_Payload::Msg_Payload(const Fmt_Args &fmt_args) : length(FMT_PAYLOAD), spill(Spill_Pool::NO_BLOCK) {
+  new (&body.fmt_args) Fmt_Args(fmt_args);
+}
+
+Msg_Payload::Msg_Payload(Msg_Payload &&other) noexcept : length(0), spill(Spill_Pool::NO_BLOCK) {
+  take(other);
+}
+
+Msg_Payload& Msg_Payload::operator=(Msg_Payload &&other) noexcept {
+  if (this != &other) {
+    if (spill != Spill_Pool::NO_BLOCK)
+      Spill_Pool::instance().release(spill);
+    take(other);
+  }
+  return(*this);
+}
+
+//copy the bytes of other that are in use, and take over its spill chain
+void Msg_Payload::take(Msg_Payload &other) {
+  length = other.length;
+  spill = other.spill;
+  other.spill = Spill_Pool::NO_BLOCK;
+  if (length == FMT_PAYLOAD)
+    new (&body.fmt_args) Fmt_Args(other.body.fmt_args);
+  else
+    memcpy(body.text, other.body.text, std::min(static_cast<size_t>(length), static_cast<size_t>(INLINE_TEXT)));
+}
+
+//* Msg_Payload::copy_to
+/*
+ * @brief the text (which must be a text payload), in one piece
+ */
+void Msg_Payload::copy_to(std::string *const out) const {
+  size_t n = std::min(static_cast<size_t>(length), static_cast<size_t>(INLINE_TEXT));
+  out->assign(body.text, n);
+  if (spill == Spill_Pool::NO_BLOCK)
+    return;
+  Spill_Pool &pool = Spill_Pool::instance();
+  for (uint32_t index = spill; index != Spill_Pool::NO_BLOCK && n < length; ) {
+    const Spill_Pool::Block &block = pool.block(index);
+    const size_t chunk = std::min(static_cast<size_t>(length) - n, sizeof(block.data));
+    out->append(block.data, chunk);
+    n += chunk;
+    index = block.next.load(std::memory_order_relaxed);
+  }
+}
+};//namespace re_gen
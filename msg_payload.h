@@ -0,0 +1,106 @@
+//* msg_payload.h - header file for the Msg_Payload and Spill_Pool classes
+/*
+ * @brief this header file defines Msg_Payload, the fixed-size body of a queued message - its text, or its captured format
+ * arguments - and Spill_Pool, the pool of blocks that holds whatever of a long text doesn't fit.
+ */
+#ifndef __IF_MSG_PAYLOAD__
+#define __IF_MSG_PAYLOAD__
+#include <string>
+#include <atomic>
+#include <stdint.h>
+#include <pthread.h>
+#include <gen/gendefs.h>
+#include <gen/message_format.h>
+
+//* re_gen namespace
+/**
+ * @brief this namespace is for items that are of general interest.
+ */
+namespace re_gen {
+
+//* Spill_Pool class
+/*
+ * @brief fixed-size blocks, shared by every thread, for the text that doesn't fit in a Msg_Payload
+ *
+ * @remarks the free blocks are a lock-free stack, linked by block index. the head is a 64 bit word: the index of the top block,
+ * and a tag that's bumped by every change - so a thread that read the head, and then lost the processor while the top block was
+ * taken and put back, fails its compare-and-swap rather than corrupting the stack (the ABA problem). a producer takes blocks, and
+ * the Message_Processor thread, once it has written the message, puts the whole chain back with one compare-and-swap.
+ *
+ * @remarks the blocks come in slabs, which are allocated (under a mutex) when the stack is empty, and then kept for good; so once
+ * the pool has grown to the most text that's ever pending at once, a long message costs no allocation. MAX_SLABS puts a ceiling on
+ * it; allocate returns NO_BLOCK beyond that (and Msg_Payload truncates the text).
+ *
+ * @note the pool is a process-wide singleton (instance), and is never destroyed, since payloads may be destroyed by thread exit
+ * and static destructors, in any order.
+ */
+class Spill_Pool {
+ public:
+  enum { BLOCK_SIZE = 1024, SLAB_BLOCKS = 64, MAX_SLABS = 4096 };
+  static const uint32_t NO_BLOCK = 0xffffffffU;
+  struct Block {
+    std::atomic<uint32_t> next;             //the next block of the chain, or of the free stack
+    char data[BLOCK_SIZE - sizeof(uint32_t)];
+  };
+  static Spill_Pool &instance(void);
+  uint32_t allocate(void);
+  void release(uint32_t first);
+  Block &block(uint32_t index) const {
+    return(slabs[index / SLAB_BLOCKS].load(std::memory_order_acquire)[index % SLAB_BLOCKS]);
+  }
+  size_t blocks(void) const { return(static_cast<size_t>(n_slabs.load(std::memory_order_relaxed)) * SLAB_BLOCKS); }
+
+ private:
+  Spill_Pool(void);
+  bool grow(void);
+  void push(uint32_t first, uint32_t last);
+  std::atomic<uint64_t> free_head;          //(tag << 32) | index of the top free block
+  std::atomic<uint32_t> n_slabs;
+  std::atomic<Block *> slabs[MAX_SLABS];
+  pthread_mutex_t grow_mutex;
+  Spill_Pool(const Spill_Pool &);
+  Spill_Pool& operator=(const Spill_Pool &);
+};//class Spill_Pool
+
+//* Msg_Payload class
+/*
+ * @brief a message's text, or its Fmt_Args, in a fixed SIZE bytes; text beyond INLINE_TEXT bytes goes in a chain of Spill_Pool
+ * blocks
+ *
+ * @remarks a message record carries its payload by value, in whichever ring or queue slot it's in; so issuing a message of up to
+ * INLINE_TEXT bytes (or a deferred one) is a copy into the slot, with no allocation - and there's no string for the Message_Processor
+ * thread to free, on behalf of another thread's allocator. moving a payload copies just the bytes in use, and takes over the spill
+ * chain; the destructor puts the chain back in the pool.
+ *
+ * @note a payload is move-only.
+ */
+class Msg_Payload {
+ public:
+  enum { SIZE = 256, INLINE_TEXT = SIZE - 2 * sizeof(uint32_t) };
+  Msg_Payload(const char *text, size_t len);
+  explicit Msg_Payload(const Fmt_Args &fmt_args);
+  Msg_Payload(Msg_Payload &&other) noexcept;
+  Msg_Payload& operator=(Msg_Payload &&other) noexcept;
+  ~Msg_Payload(void) {
+    if (spill != Spill_Pool::NO_BLOCK)
+      Spill_Pool::instance().release(spill);
+  }
+  bool is_text(void) const { return(length != FMT_PAYLOAD); }
+  size_t size(void) const { return(is_text() ? length : 0); }
+  const Fmt_Args &fmt_args(void) const { return(body.fmt_args); }
+  void copy_to(std::string *const out) const;
+
+ private:
+  static const uint32_t FMT_PAYLOAD = 0xffffffffU;
+  void take(Msg_Payload &other);
+  uint32_t length;                          //of the text, or FMT_PAYLOAD
+  uint32_t spill;                           //the first spill block, or NO_BLOCK
+  union Body {
+    char text[INLINE_TEXT];
+    Fmt_Args fmt_args;
+  } body;
+  Msg_Payload(const Msg_Payload &);
+  Msg_Payload& operator=(const Msg_Payload &);
+};//class Msg_Payload
+};//namespace re_gen
+#endif //__IF_MSG_PAYLOAD__
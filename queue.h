@@ -4,7 +4,11 @@
 // system includes
 #include <deque>
 #include <queue>
+#include <vector>
 #include <ctime>
+#include <chrono>
+#include <utility>
+#include <cerrno>
 #include <stdexcept>
 #include <pthread.h>
 #include <unistd.h>
@@ -12,6 +16,53 @@
 
 namespace re_gen {
 
+/*
+ * what a bounded queue does when push finds it full.
+ *
+ * OVERFLOW_BLOCK          - push waits until a pop makes room.
+ * OVERFLOW_FAIL           - push returns false and the object is not queued.
+ * OVERFLOW_DROP_NEWEST    - the object being pushed is discarded; push returns false.
+ * OVERFLOW_DROP_OLDEST    - the oldest queued object is discarded to make room; push returns true.
+ * OVERFLOW_DROP_AND_COUNT - as OVERFLOW_DROP_NEWEST, but the owner of the queue is expected to report dropped() to the user
+ *                           (see Message_Processor).
+ *
+ * every discarded object (but not a failed push) is counted in dropped().
+ */
+enum Overflow_Policy { OVERFLOW_BLOCK,
+                       OVERFLOW_FAIL,
+                       OVERFLOW_DROP_NEWEST,
+                       OVERFLOW_DROP_OLDEST,
+                       OVERFLOW_DROP_AND_COUNT
+};
+
+/*
+ * the result of a pop that can return without an object.
+ *
+ * QUEUE_OK      - an object was popped.
+ * QUEUE_EMPTY   - try_pop found the queue empty.
+ * QUEUE_TIMEOUT - pop_for timed out before an object was pushed.
+ * QUEUE_CLOSED  - the queue has been closed, and every object pushed before the close has already been popped.
+ */
+enum Queue_Status { QUEUE_OK,
+                    QUEUE_EMPTY,
+                    QUEUE_TIMEOUT,
+                    QUEUE_CLOSED
+};
+
+/*
+ * a snapshot of a queue's counters (see Queue::stats and Bounded_Queue::stats); times are in nanoseconds.
+ */
+struct Queue_Stats {
+  size_t depth;
+  size_t high_water;                     //the greatest depth so far
+  unsigned long long pushes;             //objects queued
+  unsigned long long pops;               //objects taken off the queue (including those discarded by OVERFLOW_DROP_OLDEST)
+  unsigned long dropped;
+  unsigned long long push_blocked_ns;    //time pushers spent waiting for room
+  unsigned long long pop_blocked_ns;     //time poppers spent waiting for an object
+  unsigned long long wait_empty_ns;      //time spent in wait_empty
+};
+
 /*
  * the re_gen::queue class is a generic queue that contains objects of type Queue_Of_T. The queue is designed to be shared
  * by a group of threads. the threads that share this queue will block when they try to pop a Queue_Of_T off the queue. once
@@ -19,26 +70,72 @@ namespace re_gen {
  * the Queue_Of_T that was taken off the queue.
  *
  * @param Queue_Of_T - the type of object that is queued. it must have a default constructor.
+ * @param capacity - constructor parameter; the maximum number of queued objects, or 0 for an unbounded queue.
+ * @param policy - constructor parameter; what push does when the queue is at capacity.
+ *
+ * @note push has copy and move overloads, and emplace constructs the object in place from its constructor arguments (using the
+ * queue's overflow policy); pop, pop_batch and drain_into move objects out of the queue rather than copying them.
+ *
+ * @note pop_batch and drain_into take several objects off the queue with a single lock; like pop, they block until there is at
+ * least one object to take. pop_batch takes at most max_n objects and writes them to an output iterator (with max_n 0, it returns
+ * 0 at once, as Bounded_Queue's does); drain_into steals the whole queue (in constant time) and appends it to a vector after the
+ * lock is released. both return the number of objects taken.
+ * try_pop_batch is pop_batch without the blocking; it returns 0 if the queue is empty.
+ *
+ * @note try_pop never blocks, and pop_for blocks for at most the given timeout; both return a Queue_Status.
+ *
+ * @note close wakes every thread that is waiting on the queue. after a close, push fails (returns false) and objects that were
+ * already queued can still be popped; once they're gone try_pop and pop_for return QUEUE_CLOSED, pop_batch and drain_into return
+ * 0, and pop throws std::runtime_error. so to shut down a group of threads, close the queue and join them.
+ *
+ * @note the queue destructor does not release threads that are waiting on the queue; close it and wait for those threads to end
+ * before you destruct the queue.
  *
- * @note the queue destructor does not release threads that are waiting on the queue. you should send each thread a special
- * Queue_Of_T object to indicate to the thread that you want it to shut down; then wait for the thread to end before you
- * destruct the queue.
+ * @note stats returns a snapshot of the queue's counters. they're kept under the queue's mutex, which is held anyway, so they
+ * cost no extra contention; blocked time is only measured when a thread actually has to wait.
  *
  */
 template <typename Queue_Of_T>
 class Queue {
  public:
-    Queue(void);
+    Queue(size_t capacity = 0, Overflow_Policy policy = OVERFLOW_BLOCK);
     ~Queue(void);
-    void push(const Queue_Of_T &obj);
+    bool push(const Queue_Of_T &obj);
+    bool push(Queue_Of_T &&obj);
+    bool push(const Queue_Of_T &obj, Overflow_Policy policy);
+    bool push(Queue_Of_T &&obj, Overflow_Policy policy);
+    bool try_push(const Queue_Of_T &obj);
+    bool try_push(Queue_Of_T &&obj);
+    template <typename... Args> bool emplace(Args&&... args);
     Queue_Of_T pop(void);
+    Queue_Status try_pop(Queue_Of_T &obj);
+    template <typename Rep, typename Period> Queue_Status pop_for(Queue_Of_T &obj, const std::chrono::duration<Rep, Period> &timeout);
+    template <typename Output_It> size_t pop_batch(Output_It out, size_t max_n);
+    template <typename Output_It> size_t try_pop_batch(Output_It out, size_t max_n);
+    size_t drain_into(std::vector<Queue_Of_T> &objs);
     void wait_empty(void);
+    void close(void);
+    bool is_closed(void);
+    size_t depth(void);
+    unsigned long dropped(void);
+    Queue_Stats stats(void);
 
  private:
     pthread_mutex_t q_mutex;
     pthread_cond_t q_push_cond;
     pthread_cond_t q_pop_cond;
+    pthread_cond_t q_space_cond;
     std::queue<Queue_Of_T> q;
+    size_t q_capacity;
+    Overflow_Policy q_policy;
+    unsigned long q_dropped;
+    int q_space_waiters;
+    bool q_closed;
+    Queue_Stats q_stats;
+    template <typename... Args> bool push_with(Overflow_Policy policy, Args&&... args);
+    Queue_Status wait_not_empty(const timespec *deadline = 0);
+    Queue_Of_T take_front(void);
+    void popped(size_t n);
     // don't allow copy or assignement
     Queue(const Queue&);
     const Queue& operator=(const Queue&);
@@ -58,15 +155,46 @@ namespace re_queue_helpers {
   private:
     pthread_mutex_t *m;
   };
+  //condition variables that are waited on with a timeout use the monotonic clock, so that setting the time of day doesn't
+  //shorten or stretch the wait
+  inline void init_monotonic_cond(pthread_cond_t *cond) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+  }
+  inline unsigned long long monotonic_ns(void) {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return(static_cast<unsigned long long>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec);
+  }
+  template <typename Rep, typename Period>
+  timespec deadline_after(const std::chrono::duration<Rep, Period> &timeout) {
+    timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(timeout).count();
+    if (ns < 0)
+      ns = 0;
+    deadline.tv_sec += ns / 1000000000LL;
+    deadline.tv_nsec += ns % 1000000000LL;
+    if (deadline.tv_nsec >= 1000000000L) {
+      ++deadline.tv_sec;
+      deadline.tv_nsec -= 1000000000L;
+    }
+    return(deadline);
+  }
 }
 
 
 //####################################################################
 template <typename Queue_Of_T>
-Queue<Queue_Of_T>::Queue(void) {
+Queue<Queue_Of_T>::Queue(size_t capacity, Overflow_Policy policy) :
+  q_capacity(capacity), q_policy(policy), q_dropped(0), q_space_waiters(0), q_closed(false), q_stats() {
     pthread_mutex_init(&q_mutex, 0);
-    pthread_cond_init(&q_push_cond, 0);
+    re_queue_helpers::init_monotonic_cond(&q_push_cond);
     pthread_cond_init(&q_pop_cond, 0);
+    pthread_cond_init(&q_space_cond, 0);
 }
 //####################################################################
 template <typename Queue_Of_T>
@@ -74,42 +202,257 @@ Queue<Queue_Of_T>::~Queue(void) {
     pthread_mutex_destroy(&q_mutex);
     pthread_cond_destroy(&q_push_cond);
     pthread_cond_destroy(&q_pop_cond);
+    pthread_cond_destroy(&q_space_cond);
+}
+//####################################################################
+template <typename Queue_Of_T>
+bool Queue<Queue_Of_T>::push(const Queue_Of_T &obj) {
+    return(push_with(q_policy, obj));
+}
+//####################################################################
+template <typename Queue_Of_T>
+bool Queue<Queue_Of_T>::push(Queue_Of_T &&obj) {
+    return(push_with(q_policy, std::move(obj)));
+}
+//####################################################################
+template <typename Queue_Of_T>
+bool Queue<Queue_Of_T>::push(const Queue_Of_T &obj, Overflow_Policy policy) {
+    return(push_with(policy, obj));
+}
+//####################################################################
+template <typename Queue_Of_T>
+bool Queue<Queue_Of_T>::push(Queue_Of_T &&obj, Overflow_Policy policy) {
+    return(push_with(policy, std::move(obj)));
+}
+//####################################################################
+template <typename Queue_Of_T>
+bool Queue<Queue_Of_T>::try_push(const Queue_Of_T &obj) {
+    return(push_with(OVERFLOW_FAIL, obj));
 }
 //####################################################################
 template <typename Queue_Of_T>
-void Queue<Queue_Of_T>::push(const Queue_Of_T &obj) {
+bool Queue<Queue_Of_T>::try_push(Queue_Of_T &&obj) {
+    return(push_with(OVERFLOW_FAIL, std::move(obj)));
+}
+//####################################################################
+template <typename Queue_Of_T>
+template <typename... Args>
+bool Queue<Queue_Of_T>::emplace(Args&&... args) {
+    return(push_with(q_policy, std::forward<Args>(args)...));
+}
+//####################################################################
+template <typename Queue_Of_T>
+template <typename... Args>
+bool Queue<Queue_Of_T>::push_with(Overflow_Policy policy, Args&&... args) {
     re_queue_helpers::lock l(q_mutex);
-    q.push(obj);
+    if (q_closed)
+      return(false);
+    if (q_capacity != 0 && q.size() >= q_capacity) {
+      switch (policy) {
+      case OVERFLOW_BLOCK: {
+	const unsigned long long start = re_queue_helpers::monotonic_ns();
+	++q_space_waiters;
+	//loop to catch spurious wake ups
+	while (q.size() >= q_capacity && !q_closed)
+	  pthread_cond_wait(&q_space_cond, &q_mutex);
+	--q_space_waiters;
+	q_stats.push_blocked_ns += re_queue_helpers::monotonic_ns() - start;
+      }
+	if (q_closed)
+	  return(false);
+	break;
+      case OVERFLOW_FAIL:
+	return(false);
+      case OVERFLOW_DROP_OLDEST:
+	q.pop();
+	++q_stats.pops;
+	++q_dropped;
+	break;
+      case OVERFLOW_DROP_NEWEST:
+      case OVERFLOW_DROP_AND_COUNT:
+	++q_dropped;
+	return(false);
+      }
+    }
+    q.emplace(std::forward<Args>(args)...);
+    ++q_stats.pushes;
+    if (q.size() > q_stats.high_water)
+      q_stats.high_water = q.size();
     pthread_cond_signal(&q_push_cond);
+    return(true);
 }
 //####################################################################
+//called, and returns, with mutex locked
 template <typename Queue_Of_T>
-Queue_Of_T Queue<Queue_Of_T>::pop(void) {
-  re_queue_helpers::lock l(q_mutex);
+Queue_Status Queue<Queue_Of_T>::wait_not_empty(const timespec *deadline) {
+  if (!q.empty())
+    return(QUEUE_OK);
+  const unsigned long long start = re_queue_helpers::monotonic_ns();
+  Queue_Status status = QUEUE_OK;
   //loop to catch spurious wake ups
-  for (;;) { 
-    if (!q.empty()) {
-      Queue_Of_T obj = q.front();
-      q.pop();
-      if (q.empty())
-	pthread_cond_signal(&q_pop_cond);
-      return(obj);
+  while (q.empty()) {
+    if (q_closed) {
+      status = QUEUE_CLOSED;
+      break;
     }
     //pthread_cond_wait is called, and returns, with mutex locked
-    pthread_cond_wait(&q_push_cond, &q_mutex);
+    if (deadline == 0) {
+      pthread_cond_wait(&q_push_cond, &q_mutex);
+    } else if (pthread_cond_timedwait(&q_push_cond, &q_mutex, deadline) == ETIMEDOUT && q.empty()) {
+      status = q_closed ? QUEUE_CLOSED : QUEUE_TIMEOUT;
+      break;
+    }
+  }
+  q_stats.pop_blocked_ns += re_queue_helpers::monotonic_ns() - start;
+  return(status);
+}
+//####################################################################
+//called with mutex locked and the queue not empty
+template <typename Queue_Of_T>
+Queue_Of_T Queue<Queue_Of_T>::take_front(void) {
+  Queue_Of_T obj(std::move(q.front()));
+  q.pop();
+  popped(1);
+  return(obj);
+}
+//####################################################################
+template <typename Queue_Of_T>
+Queue_Of_T Queue<Queue_Of_T>::pop(void) {
+  re_queue_helpers::lock l(q_mutex);
+  if (wait_not_empty() != QUEUE_OK)
+    throw std::runtime_error("pop from closed queue");
+  return(take_front());
+}
+//####################################################################
+template <typename Queue_Of_T>
+Queue_Status Queue<Queue_Of_T>::try_pop(Queue_Of_T &obj) {
+  re_queue_helpers::lock l(q_mutex);
+  if (q.empty())
+    return(q_closed ? QUEUE_CLOSED : QUEUE_EMPTY);
+  obj = take_front();
+  return(QUEUE_OK);
+}
+//####################################################################
+template <typename Queue_Of_T>
+template <typename Rep, typename Period>
+Queue_Status Queue<Queue_Of_T>::pop_for(Queue_Of_T &obj, const std::chrono::duration<Rep, Period> &timeout) {
+  timespec deadline = re_queue_helpers::deadline_after(timeout);
+  re_queue_helpers::lock l(q_mutex);
+  Queue_Status status = wait_not_empty(&deadline);
+  if (status == QUEUE_OK)
+    obj = take_front();
+  return(status);
+}
+//####################################################################
+//called with mutex locked, after n objects have been taken off the queue
+template <typename Queue_Of_T>
+void Queue<Queue_Of_T>::popped(size_t n) {
+  q_stats.pops += n;
+  if (q_space_waiters != 0) {
+    if (n == 1)
+      pthread_cond_signal(&q_space_cond);
+    else
+      pthread_cond_broadcast(&q_space_cond);
+  }
+  if (q.empty())
+    pthread_cond_signal(&q_pop_cond);
+}
+//####################################################################
+template <typename Queue_Of_T>
+template <typename Output_It>
+size_t Queue<Queue_Of_T>::pop_batch(Output_It out, size_t max_n) {
+  if (max_n == 0)
+    return(0);
+  re_queue_helpers::lock l(q_mutex);
+  if (wait_not_empty() != QUEUE_OK)
+    return(0);
+  size_t n = 0;
+  for (; n < max_n && !q.empty(); ++n) {
+    *out++ = std::move(q.front());
+    q.pop();
+  }
+  popped(n);
+  return(n);
+}
+//####################################################################
+template <typename Queue_Of_T>
+template <typename Output_It>
+size_t Queue<Queue_Of_T>::try_pop_batch(Output_It out, size_t max_n) {
+  re_queue_helpers::lock l(q_mutex);
+  size_t n = 0;
+  for (; n < max_n && !q.empty(); ++n) {
+    *out++ = std::move(q.front());
+    q.pop();
   }
+  if (n != 0)
+    popped(n);
+  return(n);
+}
+//####################################################################
+template <typename Queue_Of_T>
+size_t Queue<Queue_Of_T>::drain_into(std::vector<Queue_Of_T> &objs) {
+  std::queue<Queue_Of_T> stolen;
+  {
+    re_queue_helpers::lock l(q_mutex);
+    if (wait_not_empty() != QUEUE_OK)
+      return(0);
+    q.swap(stolen);
+    popped(stolen.size());
+  }
+  size_t n = stolen.size();
+  objs.reserve(objs.size() + n);
+  for (; !stolen.empty(); stolen.pop())
+    objs.push_back(std::move(stolen.front()));
+  return(n);
 }
 //####################################################################
 template <typename Queue_Of_T>
 void Queue<Queue_Of_T>::wait_empty(void) {
   re_queue_helpers::lock l(q_mutex);
+  if (q.empty())
+    return;
+  const unsigned long long start = re_queue_helpers::monotonic_ns();
   //loop to catch spurious wake ups
-  for (;;) { 
-    if (q.empty())
-      return;
+  while (!q.empty()) {
     //pthread_cond_wait is called, and returns, with mutex locked
     pthread_cond_wait(&q_pop_cond, &q_mutex);
   }
+  q_stats.wait_empty_ns += re_queue_helpers::monotonic_ns() - start;
+}
+//####################################################################
+template <typename Queue_Of_T>
+void Queue<Queue_Of_T>::close(void) {
+  re_queue_helpers::lock l(q_mutex);
+  q_closed = true;
+  pthread_cond_broadcast(&q_push_cond);
+  pthread_cond_broadcast(&q_space_cond);
+}
+//####################################################################
+template <typename Queue_Of_T>
+bool Queue<Queue_Of_T>::is_closed(void) {
+  re_queue_helpers::lock l(q_mutex);
+  return(q_closed);
+}
+//####################################################################
+template <typename Queue_Of_T>
+size_t Queue<Queue_Of_T>::depth(void) {
+  re_queue_helpers::lock l(q_mutex);
+  return(q.size());
+}
+//####################################################################
+template <typename Queue_Of_T>
+unsigned long Queue<Queue_Of_T>::dropped(void) {
+  re_queue_helpers::lock l(q_mutex);
+  return(q_dropped);
+}
+//####################################################################
+template <typename Queue_Of_T>
+Queue_Stats Queue<Queue_Of_T>::stats(void) {
+  re_queue_helpers::lock l(q_mutex);
+  Queue_Stats snapshot = q_stats;
+  snapshot.depth = q.size();
+  snapshot.dropped = q_dropped;
+  return(snapshot);
 }
 }//re_gen
 #endif //_QUEUE_H_
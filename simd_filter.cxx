@@ -0,0 +1,441 @@
+//* vectorized filter kernels
+/*
+ * @remarks the kernels behind copy_if and split_if with a compare predicate (see simd_filter.h). each instruction set gets its
+ * kernel as a function with the matching target attribute, so the file builds without -mavx2 or -mavx512f, and the cpu is
+ * asked which one to use the first time a kernel is called.
+ */
+#include <stdint.h>
+#include "gen/gendefs.h"
+#include "gen/simd_filter.h"
+#ifdef SIMD_FILTER_X86
+#include <immintrin.h>
+#define SIMD_FILTER_AVX2 __attribute__((target("avx2,popcnt")))
+#define SIMD_FILTER_AVX512 __attribute__((target("avx512f,popcnt")))
+#endif
+
+namespace {
+  re_gen::Simd_Level detect_level(void) {
+#ifdef SIMD_FILTER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+      return(re_gen::SIMD_AVX512);
+    if (__builtin_cpu_supports("avx2"))
+      return(re_gen::SIMD_AVX2);
+#endif
+    return(re_gen::SIMD_SCALAR);
+  }
+
+  template <typename T, int Op>
+  inline bool test(T x, T bound, T upper) {
+    switch (Op) {
+    case re_gen::CMP_LESS:
+      return(x < bound);
+    case re_gen::CMP_LESS_EQUAL:
+      return(x <= bound);
+    case re_gen::CMP_GREATER:
+      return(x > bound);
+    case re_gen::CMP_GREATER_EQUAL:
+      return(x >= bound);
+    case re_gen::CMP_EQUAL:
+      return(x == bound);
+    case re_gen::CMP_NOT_EQUAL:
+      return(x != bound);
+    default:
+      return((bound <= x) & (x < upper));
+    }
+  }
+
+  //* Scalar_Kernel struct
+  /*
+   * @brief one element at a time, but without a branch on the comparison: every element is stored, either where it belongs or
+   * (if copy_if doesn't want it) to a scratch variable - so nothing is written beyond the elements copied.
+   */
+  template <typename T, int Op, bool Split>
+  struct Scalar_Kernel {
+    static size_t run(const T *in, size_t n, T *out1, T *out2, T bound, T upper) {
+      T discard;
+      size_t n1 = 0, n2 = 0;
+      for (size_t i = 0; i < n; ++i) {
+	const T x = in[i];
+	const bool pass = test<T, Op>(x, bound, upper);
+	T *const dst = pass ? out1 + n1 : (Split ? out2 + n2 : &discard);
+	*dst = x;
+	n1 += pass;
+	n2 += !pass;
+      }
+      return(n1);
+    }
+  };
+
+#ifdef SIMD_FILTER_X86
+  /* =================================================================
+   * AVX2 has no compress instruction, so an element's passes are left-packed: the comparison's lane mask (one bit per 32 bit
+   * lane, so a 64 bit element has two) picks a row of the permutation table, which moves the lanes that passed to the bottom
+   * of the vector, in order; then as many lanes as passed are stored, with a masked store. so nothing is written beyond the
+   * elements copied. the last few elements are loaded with a masked load, rather than being done one at a time.
+   * =================================================================
+   */
+  struct Pack_Tables {
+    alignas(32) uint32_t perm[256][8];    //perm[mask] - the lanes to take, in order, for the lanes of mask to end up at the bottom
+    alignas(32) int32_t ramp[16];         //8 x -1 then 8 x 0: ramp + 8 - n is a mask of the bottom n lanes
+    Pack_Tables(void) {
+      for (unsigned mask = 0; mask < 256; ++mask) {
+	unsigned n = 0;
+	for (unsigned lane = 0; lane < 8; ++lane) {
+	  if (mask & (1u << lane))
+	    perm[mask][n++] = lane;
+	}
+	while (n < 8)
+	  perm[mask][n++] = 0;
+      }
+      for (unsigned i = 0; i < 16; ++i)
+	ramp[i] = i < 8 ? -1 : 0;
+    }
+  };
+
+  const Pack_Tables &pack_tables(void) {
+    static const Pack_Tables tables;
+    return(tables);
+  }
+
+  SIMD_FILTER_AVX2 inline __m256i bottom_lanes(const Pack_Tables &tables, unsigned n) {
+    return(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(tables.ramp + 8 - n)));
+  }
+
+  //store the lanes of mask, of bits, to dst
+  SIMD_FILTER_AVX2 inline unsigned left_pack(void *dst, __m256i bits, unsigned mask, const Pack_Tables &tables) {
+    const unsigned n = _mm_popcnt_u32(mask);
+    const __m256i packed = _mm256_permutevar8x32_epi32(bits, _mm256_load_si256(reinterpret_cast<const __m256i *>(tables.perm[mask])));
+    _mm256_maskstore_epi32(static_cast<int *>(dst), bottom_lanes(tables, n), packed);
+    return(n);
+  }
+
+  //one bit per 32 bit lane
+  SIMD_FILTER_AVX2 inline unsigned lane_mask(__m256i m) {
+    return(_mm256_movemask_ps(_mm256_castsi256_ps(m)));
+  }
+
+  //the AVX2 operations on each element type; a lane mask is 8 bits, whatever the element size
+  template <typename T> struct Avx2;
+
+  template <> struct Avx2<int32_t> {
+    typedef __m256i Vec;
+    enum { LANES = 8 };
+    static SIMD_FILTER_AVX2 Vec load(const int32_t *p) { return(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p))); }
+    static SIMD_FILTER_AVX2 Vec load(const int32_t *p, __m256i keep) { return(_mm256_maskload_epi32(reinterpret_cast<const int *>(p), keep)); }
+    static SIMD_FILTER_AVX2 Vec set1(int32_t v) { return(_mm256_set1_epi32(v)); }
+    static SIMD_FILTER_AVX2 __m256i bits(Vec x) { return(x); }
+    static SIMD_FILTER_AVX2 unsigned lt(Vec x, Vec a) { return(lane_mask(_mm256_cmpgt_epi32(a, x))); }
+    static SIMD_FILTER_AVX2 unsigned gt(Vec x, Vec a) { return(lane_mask(_mm256_cmpgt_epi32(x, a))); }
+    static SIMD_FILTER_AVX2 unsigned eq(Vec x, Vec a) { return(lane_mask(_mm256_cmpeq_epi32(x, a))); }
+    static SIMD_FILTER_AVX2 unsigned le(Vec x, Vec a) { return(~gt(x, a) & 0xff); }
+    static SIMD_FILTER_AVX2 unsigned ge(Vec x, Vec a) { return(~lt(x, a) & 0xff); }
+    static SIMD_FILTER_AVX2 unsigned ne(Vec x, Vec a) { return(~eq(x, a) & 0xff); }
+  };
+
+  template <> struct Avx2<int64_t> {
+    typedef __m256i Vec;
+    enum { LANES = 4 };
+    static SIMD_FILTER_AVX2 Vec load(const int64_t *p) { return(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p))); }
+    static SIMD_FILTER_AVX2 Vec load(const int64_t *p, __m256i keep) { return(_mm256_maskload_epi64(reinterpret_cast<const long long *>(p), keep)); }
+    static SIMD_FILTER_AVX2 Vec set1(int64_t v) { return(_mm256_set1_epi64x(v)); }
+    static SIMD_FILTER_AVX2 __m256i bits(Vec x) { return(x); }
+    static SIMD_FILTER_AVX2 unsigned lt(Vec x, Vec a) { return(lane_mask(_mm256_cmpgt_epi64(a, x))); }
+    static SIMD_FILTER_AVX2 unsigned gt(Vec x, Vec a) { return(lane_mask(_mm256_cmpgt_epi64(x, a))); }
+    static SIMD_FILTER_AVX2 unsigned eq(Vec x, Vec a) { return(lane_mask(_mm256_cmpeq_epi64(x, a))); }
+    static SIMD_FILTER_AVX2 unsigned le(Vec x, Vec a) { return(~gt(x, a) & 0xff); }
+    static SIMD_FILTER_AVX2 unsigned ge(Vec x, Vec a) { return(~lt(x, a) & 0xff); }
+    static SIMD_FILTER_AVX2 unsigned ne(Vec x, Vec a) { return(~eq(x, a) & 0xff); }
+  };
+
+  //the floating point comparisons are the ordered ones (false for a NaN) - as in C++ - except for !=, which is true for a NaN
+  template <> struct Avx2<float> {
+    typedef __m256 Vec;
+    enum { LANES = 8 };
+    static SIMD_FILTER_AVX2 Vec load(const float *p) { return(_mm256_loadu_ps(p)); }
+    static SIMD_FILTER_AVX2 Vec load(const float *p, __m256i keep) { return(_mm256_maskload_ps(p, keep)); }
+    static SIMD_FILTER_AVX2 Vec set1(float v) { return(_mm256_set1_ps(v)); }
+    static SIMD_FILTER_AVX2 __m256i bits(Vec x) { return(_mm256_castps_si256(x)); }
+    static SIMD_FILTER_AVX2 unsigned lt(Vec x, Vec a) { return(_mm256_movemask_ps(_mm256_cmp_ps(x, a, _CMP_LT_OQ))); }
+    static SIMD_FILTER_AVX2 unsigned gt(Vec x, Vec a) { return(_mm256_movemask_ps(_mm256_cmp_ps(x, a, _CMP_GT_OQ))); }
+    static SIMD_FILTER_AVX2 unsigned eq(Vec x, Vec a) { return(_mm256_movemask_ps(_mm256_cmp_ps(x, a, _CMP_EQ_OQ))); }
+    static SIMD_FILTER_AVX2 unsigned le(Vec x, Vec a) { return(_mm256_movemask_ps(_mm256_cmp_ps(x, a, _CMP_LE_OQ))); }
+    static SIMD_FILTER_AVX2 unsigned ge(Vec x, Vec a) { return(_mm256_movemask_ps(_mm256_cmp_ps(x, a, _CMP_GE_OQ))); }
+    static SIMD_FILTER_AVX2 unsigned ne(Vec x, Vec a) { return(_mm256_movemask_ps(_mm256_cmp_ps(x, a, _CMP_NEQ_UQ))); }
+  };
+
+  template <> struct Avx2<double> {
+    typedef __m256d Vec;
+    enum { LANES = 4 };
+    static SIMD_FILTER_AVX2 Vec load(const double *p) { return(_mm256_loadu_pd(p)); }
+    static SIMD_FILTER_AVX2 Vec load(const double *p, __m256i keep) { return(_mm256_maskload_pd(p, keep)); }
+    static SIMD_FILTER_AVX2 Vec set1(double v) { return(_mm256_set1_pd(v)); }
+    static SIMD_FILTER_AVX2 __m256i bits(Vec x) { return(_mm256_castpd_si256(x)); }
+    static SIMD_FILTER_AVX2 unsigned lanes(__m256d m) { return(_mm256_movemask_ps(_mm256_castpd_ps(m))); }
+    static SIMD_FILTER_AVX2 unsigned lt(Vec x, Vec a) { return(lanes(_mm256_cmp_pd(x, a, _CMP_LT_OQ))); }
+    static SIMD_FILTER_AVX2 unsigned gt(Vec x, Vec a) { return(lanes(_mm256_cmp_pd(x, a, _CMP_GT_OQ))); }
+    static SIMD_FILTER_AVX2 unsigned eq(Vec x, Vec a) { return(lanes(_mm256_cmp_pd(x, a, _CMP_EQ_OQ))); }
+    static SIMD_FILTER_AVX2 unsigned le(Vec x, Vec a) { return(lanes(_mm256_cmp_pd(x, a, _CMP_LE_OQ))); }
+    static SIMD_FILTER_AVX2 unsigned ge(Vec x, Vec a) { return(lanes(_mm256_cmp_pd(x, a, _CMP_GE_OQ))); }
+    static SIMD_FILTER_AVX2 unsigned ne(Vec x, Vec a) { return(lanes(_mm256_cmp_pd(x, a, _CMP_NEQ_UQ))); }
+  };
+
+  template <typename T, int Op, bool Split>
+  struct Avx2_Kernel {
+    typedef Avx2<T> V;
+    typedef typename V::Vec Vec;
+    enum { SCALE = 8 / V::LANES };    //32 bit lanes per element
+
+    static SIMD_FILTER_AVX2 unsigned test(Vec x, Vec bound, Vec upper) {
+      switch (Op) {
+      case re_gen::CMP_LESS:
+	return(V::lt(x, bound));
+      case re_gen::CMP_LESS_EQUAL:
+	return(V::le(x, bound));
+      case re_gen::CMP_GREATER:
+	return(V::gt(x, bound));
+      case re_gen::CMP_GREATER_EQUAL:
+	return(V::ge(x, bound));
+      case re_gen::CMP_EQUAL:
+	return(V::eq(x, bound));
+      case re_gen::CMP_NOT_EQUAL:
+	return(V::ne(x, bound));
+      default:
+	return(V::ge(x, bound) & V::lt(x, upper));
+      }
+    }
+
+    //valid - the lanes of x that hold elements
+    static SIMD_FILTER_AVX2 void filter(Vec x, unsigned valid, Vec bound, Vec upper, const Pack_Tables &tables, T *out1, size_t *const n1,
+				       T *out2, size_t *const n2) {
+      const unsigned mask = test(x, bound, upper) & valid;
+      const __m256i bits = V::bits(x);
+      *n1 += left_pack(out1 + *n1, bits, mask, tables) / SCALE;
+      if (Split)
+	*n2 += left_pack(out2 + *n2, bits, ~mask & valid, tables) / SCALE;
+    }
+
+    static SIMD_FILTER_AVX2 size_t run(const T *in, size_t n, T *out1, T *out2, T bound, T upper) {
+      const Pack_Tables &tables = pack_tables();
+      const Vec vbound = V::set1(bound), vupper = V::set1(upper);
+      size_t i = 0, n1 = 0, n2 = 0;
+      for (; i + V::LANES <= n; i += V::LANES)
+	filter(V::load(in + i), 0xff, vbound, vupper, tables, out1, &n1, out2, &n2);
+      if (i < n) {
+	const unsigned n_lanes = (n - i) * SCALE;
+	filter(V::load(in + i, bottom_lanes(tables, n_lanes)), (1u << n_lanes) - 1, vbound, vupper, tables, out1, &n1, out2, &n2);
+      }
+      return(n1);
+    }
+  };
+
+  /* =================================================================
+   * AVX-512 compresses the lanes that passed to the bottom of a register, which is then stored with a mask of as many lanes as
+   * passed (a compressing store would do both at once, but it's much slower on some cpus). the comparison gives a mask of one bit
+   * per element. the last few elements are loaded with a masked load.
+   * =================================================================
+   */
+  template <typename T> struct Avx512;
+
+  template <> struct Avx512<int32_t> {
+    typedef __m512i Vec;
+    enum { LANES = 16 };
+    static SIMD_FILTER_AVX512 Vec load(const int32_t *p) { return(_mm512_loadu_si512(p)); }
+    static SIMD_FILTER_AVX512 Vec load(const int32_t *p, unsigned keep) { return(_mm512_maskz_loadu_epi32(keep, p)); }
+    static SIMD_FILTER_AVX512 Vec set1(int32_t v) { return(_mm512_set1_epi32(v)); }
+    static SIMD_FILTER_AVX512 unsigned lt(Vec x, Vec a) { return(_mm512_cmp_epi32_mask(x, a, _MM_CMPINT_LT)); }
+    static SIMD_FILTER_AVX512 unsigned le(Vec x, Vec a) { return(_mm512_cmp_epi32_mask(x, a, _MM_CMPINT_LE)); }
+    static SIMD_FILTER_AVX512 unsigned gt(Vec x, Vec a) { return(_mm512_cmp_epi32_mask(x, a, _MM_CMPINT_NLE)); }
+    static SIMD_FILTER_AVX512 unsigned ge(Vec x, Vec a) { return(_mm512_cmp_epi32_mask(x, a, _MM_CMPINT_NLT)); }
+    static SIMD_FILTER_AVX512 unsigned eq(Vec x, Vec a) { return(_mm512_cmp_epi32_mask(x, a, _MM_CMPINT_EQ)); }
+    static SIMD_FILTER_AVX512 unsigned ne(Vec x, Vec a) { return(_mm512_cmp_epi32_mask(x, a, _MM_CMPINT_NE)); }
+    static SIMD_FILTER_AVX512 unsigned store(int32_t *p, unsigned mask, Vec x) {
+      const unsigned n = _mm_popcnt_u32(mask);
+      _mm512_mask_storeu_epi32(p, (1u << n) - 1, _mm512_maskz_compress_epi32(mask, x));
+      return(n);
+    }
+  };
+
+  template <> struct Avx512<int64_t> {
+    typedef __m512i Vec;
+    enum { LANES = 8 };
+    static SIMD_FILTER_AVX512 Vec load(const int64_t *p) { return(_mm512_loadu_si512(p)); }
+    static SIMD_FILTER_AVX512 Vec load(const int64_t *p, unsigned keep) { return(_mm512_maskz_loadu_epi64(keep, p)); }
+    static SIMD_FILTER_AVX512 Vec set1(int64_t v) { return(_mm512_set1_epi64(v)); }
+    static SIMD_FILTER_AVX512 unsigned lt(Vec x, Vec a) { return(_mm512_cmp_epi64_mask(x, a, _MM_CMPINT_LT)); }
+    static SIMD_FILTER_AVX512 unsigned le(Vec x, Vec a) { return(_mm512_cmp_epi64_mask(x, a, _MM_CMPINT_LE)); }
+    static SIMD_FILTER_AVX512 unsigned gt(Vec x, Vec a) { return(_mm512_cmp_epi64_mask(x, a, _MM_CMPINT_NLE)); }
+    static SIMD_FILTER_AVX512 unsigned ge(Vec x, Vec a) { return(_mm512_cmp_epi64_mask(x, a, _MM_CMPINT_NLT)); }
+    static SIMD_FILTER_AVX512 unsigned eq(Vec x, Vec a) { return(_mm512_cmp_epi64_mask(x, a, _MM_CMPINT_EQ)); }
+    static SIMD_FILTER_AVX512 unsigned ne(Vec x, Vec a) { return(_mm512_cmp_epi64_mask(x, a, _MM_CMPINT_NE)); }
+    static SIMD_FILTER_AVX512 unsigned store(int64_t *p, unsigned mask, Vec x) {
+      const unsigned n = _mm_popcnt_u32(mask);
+      _mm512_mask_storeu_epi64(p, (1u << n) - 1, _mm512_maskz_compress_epi64(mask, x));
+      return(n);
+    }
+  };
+
+  template <> struct Avx512<float> {
+    typedef __m512 Vec;
+    enum { LANES = 16 };
+    static SIMD_FILTER_AVX512 Vec load(const float *p) { return(_mm512_loadu_ps(p)); }
+    static SIMD_FILTER_AVX512 Vec load(const float *p, unsigned keep) { return(_mm512_maskz_loadu_ps(keep, p)); }
+    static SIMD_FILTER_AVX512 Vec set1(float v) { return(_mm512_set1_ps(v)); }
+    static SIMD_FILTER_AVX512 unsigned lt(Vec x, Vec a) { return(_mm512_cmp_ps_mask(x, a, _CMP_LT_OQ)); }
+    static SIMD_FILTER_AVX512 unsigned le(Vec x, Vec a) { return(_mm512_cmp_ps_mask(x, a, _CMP_LE_OQ)); }
+    static SIMD_FILTER_AVX512 unsigned gt(Vec x, Vec a) { return(_mm512_cmp_ps_mask(x, a, _CMP_GT_OQ)); }
+    static SIMD_FILTER_AVX512 unsigned ge(Vec x, Vec a) { return(_mm512_cmp_ps_mask(x, a, _CMP_GE_OQ)); }
+    static SIMD_FILTER_AVX512 unsigned eq(Vec x, Vec a) { return(_mm512_cmp_ps_mask(x, a, _CMP_EQ_OQ)); }
+    static SIMD_FILTER_AVX512 unsigned ne(Vec x, Vec a) { return(_mm512_cmp_ps_mask(x, a, _CMP_NEQ_UQ)); }
+    static SIMD_FILTER_AVX512 unsigned store(float *p, unsigned mask, Vec x) {
+      const unsigned n = _mm_popcnt_u32(mask);
+      _mm512_mask_storeu_ps(p, (1u << n) - 1, _mm512_maskz_compress_ps(mask, x));
+      return(n);
+    }
+  };
+
+  template <> struct Avx512<double> {
+    typedef __m512d Vec;
+    enum { LANES = 8 };
+    static SIMD_FILTER_AVX512 Vec load(const double *p) { return(_mm512_loadu_pd(p)); }
+    static SIMD_FILTER_AVX512 Vec load(const double *p, unsigned keep) { return(_mm512_maskz_loadu_pd(keep, p)); }
+    static SIMD_FILTER_AVX512 Vec set1(double v) { return(_mm512_set1_pd(v)); }
+    static SIMD_FILTER_AVX512 unsigned lt(Vec x, Vec a) { return(_mm512_cmp_pd_mask(x, a, _CMP_LT_OQ)); }
+    static SIMD_FILTER_AVX512 unsigned le(Vec x, Vec a) { return(_mm512_cmp_pd_mask(x, a, _CMP_LE_OQ)); }
+    static SIMD_FILTER_AVX512 unsigned gt(Vec x, Vec a) { return(_mm512_cmp_pd_mask(x, a, _CMP_GT_OQ)); }
+    static SIMD_FILTER_AVX512 unsigned ge(Vec x, Vec a) { return(_mm512_cmp_pd_mask(x, a, _CMP_GE_OQ)); }
+    static SIMD_FILTER_AVX512 unsigned eq(Vec x, Vec a) { return(_mm512_cmp_pd_mask(x, a, _CMP_EQ_OQ)); }
+    static SIMD_FILTER_AVX512 unsigned ne(Vec x, Vec a) { return(_mm512_cmp_pd_mask(x, a, _CMP_NEQ_UQ)); }
+    static SIMD_FILTER_AVX512 unsigned store(double *p, unsigned mask, Vec x) {
+      const unsigned n = _mm_popcnt_u32(mask);
+      _mm512_mask_storeu_pd(p, (1u << n) - 1, _mm512_maskz_compress_pd(mask, x));
+      return(n);
+    }
+  };
+
+  template <typename T, int Op, bool Split>
+  struct Avx512_Kernel {
+    typedef Avx512<T> V;
+    typedef typename V::Vec Vec;
+
+    static SIMD_FILTER_AVX512 unsigned test(Vec x, Vec bound, Vec upper) {
+      switch (Op) {
+      case re_gen::CMP_LESS:
+	return(V::lt(x, bound));
+      case re_gen::CMP_LESS_EQUAL:
+	return(V::le(x, bound));
+      case re_gen::CMP_GREATER:
+	return(V::gt(x, bound));
+      case re_gen::CMP_GREATER_EQUAL:
+	return(V::ge(x, bound));
+      case re_gen::CMP_EQUAL:
+	return(V::eq(x, bound));
+      case re_gen::CMP_NOT_EQUAL:
+	return(V::ne(x, bound));
+      default:
+	return(V::ge(x, bound) & V::lt(x, upper));
+      }
+    }
+
+    static SIMD_FILTER_AVX512 size_t run(const T *in, size_t n, T *out1, T *out2, T bound, T upper) {
+      const Vec vbound = V::set1(bound), vupper = V::set1(upper);
+      const unsigned all = (1u << V::LANES) - 1;
+      size_t i = 0, n1 = 0, n2 = 0;
+      for (; i + V::LANES <= n; i += V::LANES) {
+	const Vec x = V::load(in + i);
+	const unsigned mask = test(x, vbound, vupper);
+	n1 += V::store(out1 + n1, mask, x);
+	if (Split)
+	  n2 += V::store(out2 + n2, ~mask & all, x);
+      }
+      if (i < n) {
+	const unsigned valid = (1u << (n - i)) - 1;
+	const Vec x = V::load(in + i, valid);
+	const unsigned mask = test(x, vbound, vupper) & valid;
+	n1 += V::store(out1 + n1, mask, x);
+	if (Split)
+	  V::store(out2 + n2, ~mask & valid, x);
+      }
+      return(n1);
+    }
+  };
+#endif //SIMD_FILTER_X86
+
+  template <template <typename, int, bool> class Kernel, typename T, bool Split>
+  size_t by_op(re_gen::Compare_Op op, const T *in, size_t n, T *out1, T *out2, T bound, T upper) {
+    switch (op) {
+    case re_gen::CMP_LESS:
+      return(Kernel<T, re_gen::CMP_LESS, Split>::run(in, n, out1, out2, bound, upper));
+    case re_gen::CMP_LESS_EQUAL:
+      return(Kernel<T, re_gen::CMP_LESS_EQUAL, Split>::run(in, n, out1, out2, bound, upper));
+    case re_gen::CMP_GREATER:
+      return(Kernel<T, re_gen::CMP_GREATER, Split>::run(in, n, out1, out2, bound, upper));
+    case re_gen::CMP_GREATER_EQUAL:
+      return(Kernel<T, re_gen::CMP_GREATER_EQUAL, Split>::run(in, n, out1, out2, bound, upper));
+    case re_gen::CMP_EQUAL:
+      return(Kernel<T, re_gen::CMP_EQUAL, Split>::run(in, n, out1, out2, bound, upper));
+    case re_gen::CMP_NOT_EQUAL:
+      return(Kernel<T, re_gen::CMP_NOT_EQUAL, Split>::run(in, n, out1, out2, bound, upper));
+    case re_gen::CMP_IN_RANGE:
+      return(Kernel<T, re_gen::CMP_IN_RANGE, Split>::run(in, n, out1, out2, bound, upper));
+    }
+    throw re_gen::Gen_Err("simd_filter - unknown comparison");
+  }
+
+  template <typename T, bool Split>
+  size_t filter(const void *in, size_t n, void *out1, void *out2, re_gen::Compare_Op op, const void *bound, const void *upper) {
+    const T *const src = static_cast<const T *>(in);
+    T *const dst1 = static_cast<T *>(out1);
+    T *const dst2 = static_cast<T *>(out2);
+    const T a = *static_cast<const T *>(bound), b = upper != 0 ? *static_cast<const T *>(upper) : T();
+    switch (re_gen::simd_level()) {
+#ifdef SIMD_FILTER_X86
+    case re_gen::SIMD_AVX512:
+      return(by_op<Avx512_Kernel, T, Split>(op, src, n, dst1, dst2, a, b));
+    case re_gen::SIMD_AVX2:
+      return(by_op<Avx2_Kernel, T, Split>(op, src, n, dst1, dst2, a, b));
+#endif
+    default:
+      return(by_op<Scalar_Kernel, T, Split>(op, src, n, dst1, dst2, a, b));
+    }
+  }
+
+  template <bool Split>
+  size_t filter(re_gen::Simd_Elem elem, const void *in, size_t n, void *out1, void *out2, re_gen::Compare_Op op, const void *bound,
+		const void *upper) {
+    switch (elem) {
+    case re_gen::SIMD_ELEM_I32:
+      return(filter<int32_t, Split>(in, n, out1, out2, op, bound, upper));
+    case re_gen::SIMD_ELEM_I64:
+      return(filter<int64_t, Split>(in, n, out1, out2, op, bound, upper));
+    case re_gen::SIMD_ELEM_F32:
+      return(filter<float, Split>(in, n, out1, out2, op, bound, upper));
+    case re_gen::SIMD_ELEM_F64:
+      return(filter<double, Split>(in, n, out1, out2, op, bound, upper));
+    default:
+      throw re_gen::Gen_Err("simd_filter - no kernel for the element type");
+    }
+  }
+};//anonymous namespace
+
+
+//* re_gen namespace
+/**
+ * @brief this namespace is for items that are of general interest.
+ */
+namespace re_gen {
+
+Simd_Level simd_level(void) {
+  static const Simd_Level level = detect_level();
+  return(level);
+}
+
+size_t simd_copy_if(Simd_Elem elem, const void *in, size_t n, void *out, Compare_Op op, const void *bound, const void *upper) {
+  return(filter<false>(elem, in, n, out, 0, op, bound, upper));
+}
+
+size_t simd_split_if(Simd_Elem elem, const void *in, size_t n, void *out1, void *out2, Compare_Op op, const void *bound,
+		     const void *upper) {
+  return(filter<true>(elem, in, n, out1, out2, op, bound, upper));
+}
+};//namespace re_gen
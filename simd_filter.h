@@ -0,0 +1,69 @@
+//* simd_filter.h - header file for the vectorized filter kernels
+/*
+ * @brief this header file declares the kernels behind copy_if and split_if with a compare predicate (see functional_simd.h):
+ * contiguous arrays of 32 and 64 bit ints and floats, filtered with AVX-512 or AVX2, whichever the cpu has.
+ */
+#ifndef __IF_SIMD_FILTER__
+#define __IF_SIMD_FILTER__
+#include <cstddef>
+#include <type_traits>
+#include <gen/gendefs.h>
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(SIMD_FILTER_NO_SIMD)
+#define SIMD_FILTER_X86 1
+#endif
+
+//* re_gen namespace
+/**
+ * @brief this namespace is for items that are of general interest.
+ */
+namespace re_gen {
+
+//the comparisons that a compare predicate can make (see functional_simd.h); CMP_IN_RANGE is bound <= x && x < upper
+enum Compare_Op { CMP_LESS, CMP_LESS_EQUAL, CMP_GREATER, CMP_GREATER_EQUAL, CMP_EQUAL, CMP_NOT_EQUAL, CMP_IN_RANGE };
+
+//the element types that have kernels
+enum Simd_Elem { SIMD_ELEM_NONE, SIMD_ELEM_I32, SIMD_ELEM_I64, SIMD_ELEM_F32, SIMD_ELEM_F64 };
+
+//the instruction set that the kernels use on this cpu
+enum Simd_Level { SIMD_SCALAR, SIMD_AVX2, SIMD_AVX512 };
+
+//* simd_elem template
+/*
+ * @brief the kernel element type for T, or SIMD_ELEM_NONE: signed ints of 4 or 8 bytes, float and double
+ */
+template <typename T>
+struct simd_elem {
+  static const Simd_Elem value =
+    std::is_same<T, float>::value ? SIMD_ELEM_F32 :
+    std::is_same<T, double>::value ? SIMD_ELEM_F64 :
+    !std::is_integral<T>::value || !std::is_signed<T>::value ? SIMD_ELEM_NONE :
+    sizeof(T) == 4 ? SIMD_ELEM_I32 :
+    sizeof(T) == 8 ? SIMD_ELEM_I64 : SIMD_ELEM_NONE;
+};
+
+//* simd_level function
+/*
+ * @brief the instruction set chosen for this cpu (once, on the first call)
+ * @remarks AVX-512 needs avx512f; AVX2 needs avx2. if built with -DSIMD_FILTER_NO_SIMD (or for something other than x86-64
+ * with gcc or clang), it's always SIMD_SCALAR.
+ */
+Simd_Level simd_level(void);
+
+//* simd_copy_if function
+/*
+ * @brief copy the n elements of in for which x op bound (x op [bound, upper) for CMP_IN_RANGE) to out, keeping their order
+ * @param elem - the type of in's and out's elements, and of bound and upper; not SIMD_ELEM_NONE.
+ * @returns the number of elements copied.
+ * @remarks nothing is written to out beyond the elements copied - out needs room for only those.
+ */
+size_t simd_copy_if(Simd_Elem elem, const void *in, size_t n, void *out, Compare_Op op, const void *bound, const void *upper);
+
+//* simd_split_if function
+/*
+ * @brief as simd_copy_if, but the elements that fail the comparison are copied to out2
+ * @returns the number of elements copied to out1 (so n less that number were copied to out2).
+ */
+size_t simd_split_if(Simd_Elem elem, const void *in, size_t n, void *out1, void *out2, Compare_Op op, const void *bound,
+		     const void *upper);
+};//namespace re_gen
+#endif //__IF_SIMD_FILTER__
@@ -0,0 +1,123 @@
+#ifndef _SPSC_RING_H_
+#define _SPSC_RING_H_
+
+// system includes
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace re_gen {
+
+/*
+ * the re_gen::Spsc_Ring class is a fixed-capacity ring buffer for exactly one producer thread and exactly one consumer thread.
+ * each side owns one index and only reads the other's, and each keeps a cached copy of the other's index so that it touches
+ * the shared cache line only when the ring looks full (producer) or empty (consumer). there are no locks, no read-modify-write
+ * instructions, and no allocation after construction.
+ *
+ * @param Ring_Of_T - the type of object in the ring.
+ * @param Capacity - the number of slots in the ring. it must be a power of two.
+ *
+ * @note nothing ever blocks: try_emplace returns false when the ring is full, and try_pop / try_pop_batch return false / 0 when
+ * it is empty. waiting (and waking) is up to the owner of the ring.
+ * @note try_emplace only consumes (moves from) its arguments when it returns true.
+ * @note empty() and depth() may be called from either side, but are only exact when called from the consumer.
+ */
+template <typename Ring_Of_T, size_t Capacity>
+class Spsc_Ring {
+ public:
+    Spsc_Ring(void);
+    ~Spsc_Ring(void);
+    template <typename... Args> bool try_emplace(Args&&... args);
+    bool try_pop(Ring_Of_T &obj);
+    template <typename Output_It> size_t try_pop_batch(Output_It out, size_t max_n);
+    bool empty(void) const { return(depth() == 0); }
+    size_t depth(void) const;
+
+ private:
+    enum { CACHE_LINE = 64 };
+    typedef typename std::aligned_storage<sizeof(Ring_Of_T), std::alignment_of<Ring_Of_T>::value>::type Slot;
+    Ring_Of_T *slot(size_t pos) { return(reinterpret_cast<Ring_Of_T *>(&slots[pos & (Capacity - 1)])); }
+
+    char pad0[CACHE_LINE];
+    //written by the producer
+    std::atomic<size_t> tail;
+    size_t cached_head;
+    char pad1[CACHE_LINE - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+    //written by the consumer
+    std::atomic<size_t> head;
+    size_t cached_tail;
+    char pad2[CACHE_LINE - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+    Slot slots[Capacity];
+    // don't allow copy or assignement
+    Spsc_Ring(const Spsc_Ring&);
+    const Spsc_Ring& operator=(const Spsc_Ring&);
+};
+
+
+/* =================================================================
+ * Nothing to see beyond this point :-)
+ * =================================================================
+ */
+//####################################################################
+template <typename Ring_Of_T, size_t Capacity>
+Spsc_Ring<Ring_Of_T, Capacity>::Spsc_Ring(void) : tail(0), cached_head(0), head(0), cached_tail(0) {
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Spsc_Ring capacity must be a power of two");
+}
+//####################################################################
+template <typename Ring_Of_T, size_t Capacity>
+Spsc_Ring<Ring_Of_T, Capacity>::~Spsc_Ring(void) {
+  //destroy whatever is still in the ring
+  size_t end = tail.load(std::memory_order_relaxed);
+  for (size_t pos = head.load(std::memory_order_relaxed); pos != end; ++pos)
+    slot(pos)->~Ring_Of_T();
+}
+//####################################################################
+template <typename Ring_Of_T, size_t Capacity>
+template <typename... Args>
+bool Spsc_Ring<Ring_Of_T, Capacity>::try_emplace(Args&&... args) {
+  size_t pos = tail.load(std::memory_order_relaxed);
+  if (pos - cached_head >= Capacity) {
+    cached_head = head.load(std::memory_order_acquire);
+    if (pos - cached_head >= Capacity)
+      return(false);
+  }
+  new (slot(pos)) Ring_Of_T(std::forward<Args>(args)...);
+  tail.store(pos + 1, std::memory_order_release);
+  return(true);
+}
+//####################################################################
+template <typename Ring_Of_T, size_t Capacity>
+bool Spsc_Ring<Ring_Of_T, Capacity>::try_pop(Ring_Of_T &obj) {
+  return(try_pop_batch(&obj, 1) == 1);
+}
+//####################################################################
+template <typename Ring_Of_T, size_t Capacity>
+template <typename Output_It>
+size_t Spsc_Ring<Ring_Of_T, Capacity>::try_pop_batch(Output_It out, size_t max_n) {
+  size_t pos = head.load(std::memory_order_relaxed);
+  if (pos == cached_tail) {
+    cached_tail = tail.load(std::memory_order_acquire);
+    if (pos == cached_tail)
+      return(0);
+  }
+  size_t n = 0;
+  for (; n < max_n && pos != cached_tail; ++n, ++pos) {
+    Ring_Of_T *obj = slot(pos);
+    *out++ = std::move(*obj);
+    obj->~Ring_Of_T();
+  }
+  //one release store hands all of the slots back to the producer
+  head.store(pos, std::memory_order_release);
+  return(n);
+}
+//####################################################################
+template <typename Ring_Of_T, size_t Capacity>
+size_t Spsc_Ring<Ring_Of_T, Capacity>::depth(void) const {
+  size_t h = head.load(std::memory_order_acquire);
+  size_t t = tail.load(std::memory_order_acquire);
+  return(t > h ? t - h : 0);
+}
+}//re_gen
+#endif //_SPSC_RING_H_
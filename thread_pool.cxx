@@ -0,0 +1,339 @@
+//* thread pool
+/*
+ * @remarks worker threads with per-worker deques and work stealing (see thread_pool.h)
+ */
+#include <map>
+#include <sstream>
+#include <unistd.h>
+#include "gen/gendefs.h"
+#include "gen/queue.h"
+#include "gen/message_processor.h"
+#include "gen/thread_pool.h"
+
+namespace {
+  //the pool, and the worker, that the calling thread belongs to (if any)
+  thread_local re_gen::Thread_Pool *current_pool = 0;
+  thread_local size_t current_worker = 0;
+  //so that pools of the same name, set up at once, find one another's source rather than each registering one
+  pthread_mutex_t src_mutex = PTHREAD_MUTEX_INITIALIZER;
+  //guards the shared pools
+  pthread_mutex_t shared_mutex = PTHREAD_MUTEX_INITIALIZER;
+};//anonymous namespace
+
+
+//* re_gen namespace
+/**
+ * @brief this namespace is for items that are of general interest.
+ */
+namespace re_gen {
+
+//* Thread_Pool::Worker struct
+/*
+ * @brief a worker thread and its deque of tasks
+ * @remarks the owner pushes and pops at the back; thieves take from the front. the deque has a mutex of its own, which is only
+ * contended when somebody steals.
+ */
+struct Thread_Pool::Worker {
+  Thread_Pool *pool;
+  size_t index;
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  std::deque<Task> tasks;
+  Worker(Thread_Pool *_pool, size_t _index) : pool(_pool), index(_index), thread(), tasks() {
+    pthread_mutex_init(&mutex, 0);
+  }
+  ~Worker(void) {
+    pthread_mutex_destroy(&mutex);
+  }
+};
+
+Thread_Pool::Latch::Latch(size_t n) : remaining(n), error() {
+  pthread_mutex_init(&mutex, 0);
+  pthread_cond_init(&done_cond, 0);
+}
+
+Thread_Pool::Latch::~Latch(void) {
+  pthread_cond_destroy(&done_cond);
+  pthread_mutex_destroy(&mutex);
+}
+
+//the count is decremented with the mutex held, so that the waiter can't destroy the latch until we've let go of it
+void Thread_Pool::Latch::count_down(void) {
+  re_queue_helpers::lock l(mutex);
+  if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    pthread_cond_broadcast(&done_cond);
+}
+
+//* Thread_Pool::Thread_Pool
+/*
+ * @param n_workers - the number of worker threads; 0 => one per online cpu.
+ * @param name - the name of the pool's message source.
+ */
+Thread_Pool::Thread_Pool(size_t n_workers, const std::string &name) :
+  workers(), injection(), queued(0), unfinished(0), sleepers(0), next_victim(0), stopping(false), mp(0), src_id(-1) {
+  if (n_workers == 0) {
+    long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    n_workers = n_cpus > 0 ? static_cast<size_t>(n_cpus) : 1;
+  }
+  try {
+    Message_Processor::Hold hold;
+    if (hold.get() != 0) {
+      re_queue_helpers::lock l(src_mutex);
+      src_id = hold.get()->find_msg_src(name);
+      if (src_id < 0)
+	src_id = hold.get()->register_msg_src(VERBOSITY_MINOR_STEPS, name);
+      mp = hold.get();
+    }
+  } catch (const Gen_Err &) {
+    //no room for another source - the pool keeps quiet
+    mp = 0;
+    src_id = -1;
+  }
+  pthread_mutex_init(&mutex, 0);
+  pthread_cond_init(&work_cond, 0);
+  pthread_cond_init(&idle_cond, 0);
+  //the workers all exist before any of them starts, since they look at each other's deques
+  for (size_t i = 0; i < n_workers; ++i)
+    workers.push_back(new Worker(this, i));
+  for (size_t i = 0; i < n_workers; ++i) {
+    if (pthread_create(&workers[i]->thread, 0, run, workers[i]) != 0) {
+      stop(i);
+      pthread_cond_destroy(&idle_cond);
+      pthread_cond_destroy(&work_cond);
+      pthread_mutex_destroy(&mutex);
+      throw Gen_Err("Thread_Pool::Thread_Pool - can't start the worker threads");
+    }
+  }
+  std::ostringstream oss;
+  oss << "::Thread_Pool - started " << n_workers << " workers";
+  report(VERBOSITY_EVERYTHING, oss.str());
+}
+
+//* Thread_Pool::~Thread_Pool
+/*
+ * @brief finish every task that has been submitted, and stop the workers
+ */
+Thread_Pool::~Thread_Pool(void) {
+  drain();
+  stop(workers.size());
+  pthread_cond_destroy(&idle_cond);
+  pthread_cond_destroy(&work_cond);
+  pthread_mutex_destroy(&mutex);
+  report(VERBOSITY_EVERYTHING, "::~Thread_Pool - stopped");
+}
+
+//* Thread_Pool::shared
+/*
+ * @brief the process-wide pool of n_workers workers, made on the first call for n_workers
+ * @remarks the pools are never destroyed (nor is the map of them), so they can be used from static destructors and from threads
+ * that outlive main; their workers are parked at exit.
+ */
+Thread_Pool &Thread_Pool::shared(size_t n_workers) {
+  static std::map<size_t, Thread_Pool *> *const pools = new std::map<size_t, Thread_Pool *>;
+  re_queue_helpers::lock l(shared_mutex);
+  Thread_Pool *&pool = (*pools)[n_workers];
+  if (pool == 0)
+    pool = new Thread_Pool(n_workers);
+  return(*pool);
+}
+
+//* Thread_Pool::stop
+/*
+ * @brief stop the first n_started workers, and delete all of them
+ * @remarks a worker may be looking at any other's deque until it's stopped, so none is deleted until they've all been joined.
+ */
+void Thread_Pool::stop(size_t n_started) {
+  {
+    re_queue_helpers::lock l(mutex);
+    stopping = true;
+    pthread_cond_broadcast(&work_cond);
+  }
+  for (size_t i = 0; i < n_started; ++i)
+    pthread_join(workers[i]->thread, 0);
+  for (size_t i = 0; i < workers.size(); ++i)
+    delete workers[i];
+  workers.clear();
+}
+
+//* Thread_Pool::execute
+/*
+ * @brief queue a task, without a future for it
+ */
+void Thread_Pool::execute(Task task) {
+  push_task(std::move(task));
+}
+
+//* Thread_Pool::drain
+/*
+ * @brief wait until every task submitted so far, and every task that they have submitted, has finished
+ * @throw Gen_Err if called by one of the pool's own workers
+ */
+void Thread_Pool::drain(void) {
+  if (current_pool == this)
+    throw Gen_Err("Thread_Pool::drain - a task can't wait for the pool to drain");
+  re_queue_helpers::lock l(mutex);
+  while (unfinished.load(std::memory_order_acquire) != 0)
+    pthread_cond_wait(&idle_cond, &mutex);
+}
+
+//* Thread_Pool::worker_index
+/*
+ * @return the calling thread's index in the pool, or -1 if it isn't one of the pool's workers
+ */
+int Thread_Pool::worker_index(void) const {
+  return(current_pool == this ? static_cast<int>(current_worker) : -1);
+}
+
+//* Thread_Pool::push_task
+/*
+ * @brief put a task on the calling worker's deque or, from outside the pool, on the injection queue; and wake a parked worker
+ * @remarks queued is incremented before the task is visible and sleepers is read after, both sequentially consistent; a worker
+ * increments sleepers before it reads queued for the last time. so either we see the worker parking, or it sees the task.
+ */
+void Thread_Pool::push_task(Task &&task) {
+  unfinished.fetch_add(1, std::memory_order_relaxed);
+  queued.fetch_add(1, std::memory_order_seq_cst);
+  if (current_pool == this) {
+    Worker *worker = workers[current_worker];
+    re_queue_helpers::lock l(worker->mutex);
+    worker->tasks.push_back(std::move(task));
+  } else {
+    injection.push(std::move(task));
+  }
+  if (sleepers.load(std::memory_order_seq_cst) > 0) {
+    re_queue_helpers::lock l(mutex);
+    pthread_cond_signal(&work_cond);
+  }
+}
+
+//* Thread_Pool::take_task
+/*
+ * @brief the next task for worker (0 => a thread from outside the pool): from the back of its own deque, from the injection queue,
+ * or from the front of another worker's deque
+ * @return false if there is nothing to take
+ */
+bool Thread_Pool::take_task(Worker *worker, Task *const task) {
+  bool taken = false;
+  if (worker != 0) {
+    re_queue_helpers::lock l(worker->mutex);
+    if (!worker->tasks.empty()) {
+      task->swap(worker->tasks.back());
+      worker->tasks.pop_back();
+      taken = true;
+    }
+  }
+  if (!taken)
+    taken = injection.try_pop(*task) == QUEUE_OK;
+  //start the hunt at a different victim each time, so thieves spread out
+  const size_t first = taken ? 0 : next_victim.fetch_add(1, std::memory_order_relaxed);
+  for (size_t i = 0, n = workers.size(); !taken && i < n; ++i) {
+    Worker *victim = workers[(first + i) % n];
+    if (victim == worker)
+      continue;
+    re_queue_helpers::lock l(victim->mutex);
+    if (!victim->tasks.empty()) {
+      task->swap(victim->tasks.front());
+      victim->tasks.pop_front();
+      taken = true;
+    }
+  }
+  if (taken)
+    queued.fetch_sub(1, std::memory_order_relaxed);
+  return(taken);
+}
+
+//* Thread_Pool::run_task
+/*
+ * @brief run a task, and count it as finished
+ * @remarks the task is destroyed (and whatever it captured released) before it's counted, so drain returns only once nothing
+ * of it is left.
+ */
+void Thread_Pool::run_task(Task *const task) {
+  try {
+    (*task)();
+  } catch (const std::exception &err) {
+    report(VERBOSITY_ERRORS, std::string("::run_task - task threw an exception: ") + err.what());
+  } catch (...) {
+    report(VERBOSITY_ERRORS, "::run_task - task threw an unknown exception");
+  }
+  *task = Task();
+  finished();
+}
+
+void Thread_Pool::finished(void) {
+  if (unfinished.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    re_queue_helpers::lock l(mutex);
+    pthread_cond_broadcast(&idle_cond);
+  }
+}
+
+//* Thread_Pool::run_one
+/*
+ * @brief run one task, on the calling thread (a worker, or a thread waiting in parallel_for)
+ * @return false if there was nothing to run
+ */
+bool Thread_Pool::run_one(void) {
+  Task task;
+  if (!take_task(current_pool == this ? workers[current_worker] : 0, &task))
+    return(false);
+  run_task(&task);
+  return(true);
+}
+
+//* Thread_Pool::wait_for
+/*
+ * @brief wait for a parallel_for's chunks, running tasks while there are any to run
+ * @remarks once there's nothing left to take, every one of the latch's chunks has been taken by somebody, so it's safe to
+ * just wait for them.
+ */
+void Thread_Pool::wait_for(Latch *const latch) {
+  while (latch->remaining.load(std::memory_order_acquire) != 0) {
+    if (run_one())
+      continue;
+    re_queue_helpers::lock l(latch->mutex);
+    while (latch->remaining.load(std::memory_order_acquire) != 0)
+      pthread_cond_wait(&latch->done_cond, &latch->mutex);
+  }
+  //the last count_down may still hold the mutex
+  re_queue_helpers::lock l(latch->mutex);
+}
+
+void *Thread_Pool::run(void *instance) {
+  Worker *worker = static_cast<Worker *>(instance);
+  worker->pool->loop(worker);
+  return(0);
+}
+
+//* Thread_Pool::loop
+/*
+ * @brief run tasks until the pool is stopped; park when there are none
+ */
+void Thread_Pool::loop(Worker *worker) {
+  current_pool = this;
+  current_worker = worker->index;
+  Task task;
+  for (;;) {
+    if (take_task(worker, &task)) {
+      run_task(&task);
+      continue;
+    }
+    re_queue_helpers::lock l(mutex);
+    sleepers.fetch_add(1, std::memory_order_seq_cst);
+    while (queued.load(std::memory_order_seq_cst) == 0 && !stopping)
+      pthread_cond_wait(&work_cond, &mutex);
+    sleepers.fetch_sub(1, std::memory_order_relaxed);
+    if (stopping && queued.load(std::memory_order_relaxed) == 0)
+      break;
+  }
+  current_pool = 0;
+}
+
+void Thread_Pool::report(Verbosity_Level severity, const std::string &msg) {
+  if (mp == 0)
+    return;
+  //the Message_Processor may have gone since the pool was built; the hold keeps it from going while we issue the message
+  Message_Processor::Hold hold;
+  if (hold.get() == mp)
+    mp->process_msg(src_id, severity, msg);
+}
+};//namespace re_gen
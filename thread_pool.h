@@ -0,0 +1,161 @@
+//* thread_pool.h - header file for the Thread_Pool class
+/*
+ * @brief this header file defines the Thread_Pool class, a fixed group of worker threads that run tasks, with work stealing.
+ */
+#ifndef __IF_THREAD_POOL__
+#define __IF_THREAD_POOL__
+#include <string>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <algorithm>
+#include <memory>
+#include <future>
+#include <exception>
+#include <functional>
+#include <type_traits>
+#include <pthread.h>
+#include <gen/gendefs.h>
+#include <gen/queue.h>
+#include <gen/message_processor.h>
+
+//* re_gen namespace
+/**
+ * @brief this namespace is for items that are of general interest.
+ */
+namespace re_gen {
+
+//* Thread_Pool class
+/*
+ * @brief a fixed number of worker threads, which run the tasks that are submitted to the pool
+ *
+ * @remarks each worker has a deque of its own. a task submitted by a worker (eg. by a task that splits its work up) goes on the
+ * back of that worker's deque, and the worker takes its next task from the back - so it works on what's hot in its cache. a task
+ * submitted from outside the pool goes on the shared injection queue (a re_gen::Queue). a worker whose deque is empty takes from
+ * the injection queue, and failing that steals from the front of another worker's deque - the oldest, and so (for a task that
+ * splits its work) the biggest, piece of work. a worker that finds nothing anywhere parks until something is submitted.
+ *
+ * @note submit returns a std::future for the task's result (or exception). execute is submit without the future; an exception
+ * that escapes an executed task is reported via the Message_Processor, if there is one, and otherwise ignored.
+ *
+ * @note parallel_for(begin, end, fn) calls fn(i) for every i in [begin, end), in chunks of grain indexes, on the workers - and on
+ * the calling thread, which runs chunks too while it waits for them. so it can be called from within a task (ie. nested) without
+ * tying up a worker. the first exception thrown by fn is rethrown once every chunk has finished.
+ *
+ * @note shared(n) is a pool of n workers (0 => one per online cpu) that is made on the first call for n, and then kept, for the
+ * life of the process, for every caller that asks for n - eg. Parallel(n) (see functional_parallel.h). don't delete it.
+ *
+ * @note drain waits, like Queue::wait_empty, until every task submitted so far (and every task they submitted) has finished. don't
+ * call it from a task: it would wait for itself (it throws Gen_Err instead). the destructor drains, and then stops the workers.
+ *
+ * @note if a Message_Processor has been constructed, the pool reports starting and stopping (at VERBOSITY_EVERYTHING), and escaped
+ * exceptions, through it, as the message source named name - which is registered by the first pool of that name, and shared by
+ * the rest, so pools that come and go don't use up the source table. the workers' messages are told apart by their thread ids.
+ * if the Message_Processor is destroyed before the pool, the pool goes quiet.
+ *
+ * @throw Gen_Err from the constructor if the worker threads can't be started.
+ */
+class Thread_Pool {
+ public:
+  typedef std::function<void(void)> Task;
+  Thread_Pool(size_t n_workers = 0, const std::string &name = "Thread_Pool");
+  ~Thread_Pool(void);
+  static Thread_Pool &shared(size_t n_workers = 0);
+  template <typename Fn>
+  std::future<typename std::result_of<Fn()>::type> submit(Fn fn);
+  void execute(Task task);
+  template <typename Fn>
+  void parallel_for(size_t begin, size_t end, Fn fn, size_t grain = 0);
+  void drain(void);
+  size_t size(void) const { return(workers.size()); }
+  int worker_index(void) const;
+  int msg_src_id(void) const { return(src_id); }
+
+ private:
+  struct Worker;
+  //one parallel_for: the chunks that are still to finish, and the first exception
+  struct Latch {
+    std::atomic<size_t> remaining;
+    std::exception_ptr error;
+    pthread_mutex_t mutex;
+    pthread_cond_t done_cond;
+    Latch(size_t n);
+    ~Latch(void);
+    void count_down(void);
+  };
+  static void *run(void *instance);
+  void loop(Worker *worker);
+  void run_task(Task *const task);
+  void push_task(Task &&task);
+  bool take_task(Worker *worker, Task *const task);
+  bool run_one(void);
+  void finished(void);
+  void wait_for(Latch *const latch);
+  void stop(size_t n_started);
+  void report(Verbosity_Level severity, const std::string &msg);
+  std::vector<Worker *> workers;
+  Queue<Task> injection;
+  std::atomic<size_t> queued;       //tasks waiting in the injection queue or a deque
+  std::atomic<size_t> unfinished;   //tasks submitted and not yet finished
+  std::atomic<int> sleepers;
+  std::atomic<size_t> next_victim;
+  bool stopping;
+  pthread_mutex_t mutex;
+  pthread_cond_t work_cond;         //parked workers wait on this for tasks
+  pthread_cond_t idle_cond;         //drain waits on this for unfinished to reach 0
+  Message_Processor *mp;
+  int src_id;
+  Thread_Pool(const Thread_Pool &);
+  Thread_Pool& operator=(const Thread_Pool &);
+};//class Thread_Pool
+
+//* Thread_Pool::submit
+/*
+ * @brief queue fn() to be run by a worker
+ * @return a future for fn's result (or for the exception it throws)
+ */
+template <typename Fn>
+std::future<typename std::result_of<Fn()>::type> Thread_Pool::submit(Fn fn) {
+  typedef typename std::result_of<Fn()>::type Result;
+  //a Task must be copyable, and a packaged_task isn't
+  std::shared_ptr<std::packaged_task<Result()> > task = std::make_shared<std::packaged_task<Result()> >(std::move(fn));
+  std::future<Result> result = task->get_future();
+  push_task(Task([task]() { (*task)(); }));
+  return(result);
+}
+
+//* Thread_Pool::parallel_for
+/*
+ * @brief call fn(i) for each i in [begin, end), spread over the workers; returns when every call has returned
+ * @param grain - the number of indexes in a chunk; 0 => enough chunks for each worker (and the caller) to have about four.
+ */
+template <typename Fn>
+void Thread_Pool::parallel_for(size_t begin, size_t end, Fn fn, size_t grain) {
+  if (begin >= end)
+    return;
+  const size_t n = end - begin;
+  if (grain == 0)
+    grain = std::max(n / ((workers.size() + 1) * 4), static_cast<size_t>(1));
+  Latch latch((n + grain - 1) / grain);
+  Latch *const latch_ptr = &latch;
+  Fn *const fn_ptr = &fn;
+  for (size_t first = begin; first < end; first += grain) {
+    const size_t last = first + std::min(grain, end - first);
+    push_task(Task([latch_ptr, fn_ptr, first, last]() {
+	  try {
+	    for (size_t i = first; i < last; ++i)
+	      (*fn_ptr)(i);
+	  } catch (...) {
+	    re_queue_helpers::lock l(latch_ptr->mutex);
+	    if (!latch_ptr->error)
+	      latch_ptr->error = std::current_exception();
+	  }
+	  latch_ptr->count_down();
+	}));
+  }
+  wait_for(&latch);
+  if (latch.error)
+    std::rethrow_exception(latch.error);
+}
+};//namespace re_gen
+#endif //__IF_THREAD_POOL__
@@ -0,0 +1,138 @@
+//* type_tag.h - header file for type tags
+/*
+ * @brief this header file defines type tags, with which a class hierarchy can say whether an object is a T without RTTI; and
+ * tag_cast, which uses them in place of dynamic_cast (as do re_gen::cast and cast_if - see functional.h).
+ */
+#ifndef __IF_TYPE_TAG__
+#define __IF_TYPE_TAG__
+#include <type_traits>
+#include <utility>
+#include <gen/gendefs.h>
+
+//* re_gen namespace
+/**
+ * @brief this namespace is for items that are of general interest.
+ */
+namespace re_gen {
+
+//a class's type id: the address of a variable of its own, so every class has a different one, with no registry to keep
+typedef const void *Type_Id;
+
+template <typename T>
+struct type_id_holder {
+  static const char id;
+};
+
+template <typename T>
+const char type_id_holder<T>::id = 0;
+
+template <typename T>
+constexpr Type_Id type_id_of(void) {
+  return(&type_id_holder<T>::id);
+}
+
+//* TYPE_TAG_ROOT, TYPE_TAG macros
+/*
+ * @brief give a class a type tag: TYPE_TAG_ROOT(class) at the top of a hierarchy, TYPE_TAG(class, base) below it
+ * @remarks a tagged class has a class_type_id, and a virtual is_a(id), which is true for the class's own id and (via its base's
+ * is_a) for its bases'. a class that doesn't tag itself is a plain instance of its nearest tagged base, as far as is_a goes - it
+ * can be tag_cast to that base, but not to itself (tag_cast uses dynamic_cast for it). with multiple inheritance, write is_a by
+ * hand, asking each of the bases. the macros leave the class's access at public.
+ * @example:
+ *  class a {
+ *    TYPE_TAG_ROOT(a)
+ *  public:
+ *    virtual ~a(void);
+ *  };
+ *  class b : public a {
+ *    TYPE_TAG(b, a)
+ *  };
+ */
+#define TYPE_TAG_ROOT(Class)						\
+ public:								\
+  typedef Class type_tag_class;						\
+  static constexpr re_gen::Type_Id class_type_id(void) { return(re_gen::type_id_of<Class>()); } \
+  virtual bool is_a(re_gen::Type_Id id) const { return(id == class_type_id()); }
+
+#define TYPE_TAG(Class, Base)						\
+ public:								\
+  typedef Class type_tag_class;						\
+  static constexpr re_gen::Type_Id class_type_id(void) { return(re_gen::type_id_of<Class>()); } \
+  virtual bool is_a(re_gen::Type_Id id) const { return(id == class_type_id() || Base::is_a(id)); }
+
+namespace re_type_tag_helpers {
+  //true if T tags itself (not just inherits a tag)
+  template <typename T, typename = void>
+  struct has_own_tag : std::false_type {
+  };
+
+  template <typename T>
+  struct has_own_tag<T, typename std::enable_if<std::is_same<typename T::type_tag_class, T>::value>::type> : std::true_type {
+  };
+
+  //true if T has an is_a, of its own or inherited
+  template <typename T, typename = void>
+  struct has_is_a : std::false_type {
+  };
+
+  template <typename T>
+  struct has_is_a<T, decltype(void(std::declval<const T &>().is_a(Type_Id())))> : std::true_type {
+  };
+
+  template <typename To, typename From, typename = void>
+  struct static_castable : std::false_type {
+  };
+
+  template <typename To, typename From>
+  struct static_castable<To, From, decltype(void(static_cast<To>(std::declval<From>())))> : std::true_type {
+  };
+
+  enum Cast_Kind { CAST_DYNAMIC, CAST_UP, CAST_TAGGED };
+
+  //how tag_cast does a cast from From to Cast_T
+  template <typename Cast_T, typename From>
+  struct cast_kind {
+    typedef typename std::remove_cv<typename std::remove_pointer<Cast_T>::type>::type To_Class;
+    typedef typename std::remove_cv<typename std::remove_pointer<From>::type>::type From_Class;
+    static const bool pointers = std::is_pointer<Cast_T>::value && std::is_pointer<From>::value && std::is_class<To_Class>::value;
+    static const Cast_Kind value =
+      pointers && std::is_base_of<To_Class, From_Class>::value && static_castable<Cast_T, From>::value ? CAST_UP :
+      pointers && has_own_tag<To_Class>::value && has_is_a<From_Class>::value && static_castable<Cast_T, From>::value ? CAST_TAGGED :
+      CAST_DYNAMIC;
+  };
+
+  template <typename Cast_T, typename From>
+  inline Cast_T cast(const From &from, std::integral_constant<Cast_Kind, CAST_DYNAMIC>) {
+    return(dynamic_cast<Cast_T>(from));
+  }
+
+  template <typename Cast_T, typename From>
+  inline Cast_T cast(const From &from, std::integral_constant<Cast_Kind, CAST_UP>) {
+    return(static_cast<Cast_T>(from));
+  }
+
+  template <typename Cast_T, typename From>
+  inline Cast_T cast(const From &from, std::integral_constant<Cast_Kind, CAST_TAGGED>) {
+    typedef typename cast_kind<Cast_T, From>::To_Class To_Class;
+    return(from != 0 && from->is_a(To_Class::class_type_id()) ? static_cast<Cast_T>(from) : 0);
+  }
+}
+
+//* tag_cast function
+/*
+ * @brief dynamic_cast<Cast_T>(from), done more cheaply where the types allow
+ * @remarks which way is chosen at compile time: an upcast (to a base, or the same class) is a static_cast; a pointer downcast
+ * to a class with its own type tag, from a class that has is_a, is one virtual call to is_a and a static_cast - rather than a
+ * search of the RTTI; anything else (references, sideways casts, virtual bases, untagged classes) is a dynamic_cast. like
+ * dynamic_cast, it gives 0 for a pointer to an object that isn't a Cast_T, and for 0.
+ * @example:
+ *  a *pa = new b;
+ *  b *pb = tag_cast<b *>(pa);
+ */
+template <typename Cast_T, typename From>
+  inline Cast_T tag_cast(const From &from) {
+  return(re_type_tag_helpers::cast<Cast_T>(from, std::integral_constant<re_type_tag_helpers::Cast_Kind,
+					   re_type_tag_helpers::cast_kind<Cast_T, From>::value>()));
+}
+};//namespace re_gen
+#endif //__IF_TYPE_TAG__